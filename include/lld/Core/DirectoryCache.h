@@ -0,0 +1,59 @@
+//===- lld/Core/DirectoryCache.h - Cached directory listings --------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Answers "does this file exist" from directory listings, so that
+/// searching for libraries in many directories does not stat every candidate.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLD_CORE_DIRECTORY_CACHE_H
+#define LLD_CORE_DIRECTORY_CACHE_H
+
+#include "lld/Core/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lld {
+
+/// \brief Remembers the entries of the directories it has listed.
+///
+/// Each directory is listed once, on the first lookup of a file in it.
+/// Listings only rule out files: names are compared ignoring case, so that
+/// this works on case-insensitive file systems too, and a file found in a
+/// listing is checked with a stat before it is reported to exist. A file in
+/// a directory that cannot be listed is looked up with a stat.
+class DirectoryCache {
+public:
+  /// \brief Returns true if the file \p path exists.
+  bool exists(StringRef path);
+
+  /// \brief Lists the directories not listed yet in parallel, so that later
+  /// lookups in them do not list them one by one.
+  void listDirectories(const std::vector<std::string> &dirs);
+
+private:
+  struct Directory {
+    bool listed = false;
+    llvm::StringSet<> names;
+  };
+
+  static void list(StringRef dir, Directory &result);
+
+  llvm::StringMap<std::unique_ptr<Directory>> _dirs;
+  std::mutex _mutex;
+};
+
+} // end namespace lld
+
+#endif
@@ -0,0 +1,93 @@
+//===- lld/Core/FilePrefetcher.h - Read input files ahead -----------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Reads input files on a few background threads, so that the reads
+/// overlap with each other and with the driver processing the command line.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLD_CORE_FILE_PREFETCHER_H
+#define LLD_CORE_FILE_PREFETCHER_H
+
+#include "lld/Core/LLVM.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lld {
+
+/// \brief Opens, maps and identifies files in the background.
+///
+/// Files are read in the order they were given, so that the driver, which
+/// consumes them in the same order, rarely waits. Each prefetched buffer can
+/// be taken once; later requests for the same path read the file again.
+class FilePrefetcher {
+public:
+  /// \brief Starts reading \p paths on at most \p maxThreads threads.
+  explicit FilePrefetcher(const std::vector<std::string> &paths,
+                          unsigned maxThreads = 8);
+
+  /// \brief Stops reading and waits for the reads in flight.
+  ~FilePrefetcher();
+
+  /// \brief Returns the contents of \p path, waiting for it to be read if it
+  /// was prefetched, and reading it in the calling thread otherwise.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> take(StringRef path);
+
+  /// \brief Sets \p magic to the type of \p path, like identify_magic(), but
+  /// without reading the file again if it was prefetched.
+  std::error_code identify(StringRef path, llvm::sys::fs::file_magic &magic);
+
+  /// \brief Returns the number of files read in the background.
+  unsigned numFiles() const { return _entries.size(); }
+
+  /// \brief Returns the total time the background threads spent reading.
+  double readSeconds() const;
+
+  /// \brief Returns the time take() and identify() waited for reads.
+  double waitSeconds() const;
+
+private:
+  struct Entry {
+    explicit Entry(StringRef path) : path(path) {}
+
+    std::string path;
+    std::unique_ptr<MemoryBuffer> mb;
+    std::error_code ec;
+    llvm::sys::fs::file_magic magic = llvm::sys::fs::file_magic::unknown;
+    bool done = false;
+    bool taken = false;
+  };
+
+  void work();
+  Entry *wait(StringRef path, std::unique_lock<std::mutex> &lock);
+
+  std::vector<Entry> _entries;
+  llvm::StringMap<size_t> _index;
+  std::atomic<size_t> _next;
+  std::atomic<bool> _stop;
+  std::vector<std::thread> _threads;
+  mutable std::mutex _mutex;
+  std::condition_variable _cond;
+  double _readSeconds;
+  double _waitSeconds;
+};
+
+} // end namespace lld
+
+#endif
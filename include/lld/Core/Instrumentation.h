@@ -10,12 +10,19 @@
 /// \file
 /// \brief Provide an Instrumentation API that optionally uses VTune interfaces.
 ///
+/// Tasks and markers are also recorded by a built-in tracer when it is
+/// enabled with TimeTrace::enable(). The tracer writes Chrome trace events,
+/// which can be viewed in chrome://tracing.
+///
 //===----------------------------------------------------------------------===//
 
 #ifndef LLD_CORE_INSTRUMENTATION_H
 #define LLD_CORE_INSTRUMENTATION_H
 
+#include "lld/Core/LLVM.h"
 #include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <system_error>
 #include <utility>
 
 #ifdef LLD_HAS_VTUNE
@@ -23,6 +30,41 @@
 #endif
 
 namespace lld {
+/// \brief Records the begin and end times of tasks on each thread.
+///
+/// Each thread appends events to its own buffer, so recording does not take
+/// locks. A thread takes a lock only once, to register its buffer. The trace
+/// must be written or cleared while no other thread is recording.
+class TimeTrace {
+public:
+  /// \brief Starts recording. Timestamps are relative to the first call.
+  static void enable();
+
+  static bool isEnabled() {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  /// \brief Begins a task on the current thread. \p name must outlive the
+  /// trace.
+  static void begin(const char *name);
+
+  /// \brief Ends the innermost task of the current thread.
+  static void end();
+
+  /// \brief Records an instant event on the current thread.
+  static void mark(const char *name);
+
+  /// \brief Writes the completed tasks as Chrome trace event JSON.
+  static void write(raw_ostream &os);
+  static std::error_code write(StringRef path);
+
+  /// \brief Discards all recorded events and stops recording.
+  static void clear();
+
+private:
+  static std::atomic<bool> _enabled;
+};
+
 #ifdef LLD_HAS_VTUNE
 /// \brief A unique global scope for instrumentation data.
 ///
@@ -47,11 +89,14 @@ public:
 /// string will be used often.
 class StringHandle {
   __itt_string_handle *_handle;
+  const char *_name;
 
 public:
-  StringHandle(const char *name) : _handle(__itt_string_handle_createA(name)) {}
+  StringHandle(const char *name)
+      : _handle(__itt_string_handle_createA(name)), _name(name) {}
 
   operator __itt_string_handle *() const { return _handle; }
+  const char *name() const { return _name; }
 };
 
 /// \brief A task on a single thread. Nests within other tasks.
@@ -63,14 +108,18 @@ public:
 /// a task is either the lifetime of this object, or until end is called.
 class ScopedTask {
   __itt_domain *_domain;
+  bool _traced;
 
   ScopedTask(const ScopedTask &) = delete;
   ScopedTask &operator=(const ScopedTask &) = delete;
 
 public:
   /// \brief Create a task in Domain \p d named \p s.
-  ScopedTask(const Domain &d, const StringHandle &s) : _domain(d) {
+  ScopedTask(const Domain &d, const StringHandle &s)
+      : _domain(d), _traced(TimeTrace::isEnabled()) {
     __itt_task_begin(d, __itt_null, __itt_null, s);
+    if (_traced)
+      TimeTrace::begin(s.name());
   }
 
   ScopedTask(ScopedTask &&other) {
@@ -79,7 +128,9 @@ public:
 
   ScopedTask &operator=(ScopedTask &&other) {
     _domain = other._domain;
+    _traced = other._traced;
     other._domain = nullptr;
+    other._traced = false;
     return *this;
   }
 
@@ -87,7 +138,10 @@ public:
   void end() {
     if (_domain)
       __itt_task_end(_domain);
+    if (_traced)
+      TimeTrace::end();
     _domain = nullptr;
+    _traced = false;
   }
 
   ~ScopedTask() { end(); }
@@ -98,6 +152,8 @@ class Marker {
 public:
   Marker(const Domain &d, const StringHandle &s) {
     __itt_marker(d, __itt_null, s, __itt_scope_global);
+    if (TimeTrace::isEnabled())
+      TimeTrace::mark(s.name());
   }
 };
 #else
@@ -107,19 +163,47 @@ public:
 };
 
 class StringHandle {
+  const char *_name;
+
 public:
-  StringHandle(const char *name) {}
+  StringHandle(const char *name) : _name(name) {}
+
+  const char *name() const { return _name; }
 };
 
+/// \brief A task on a single thread, recorded by TimeTrace if it is enabled.
 class ScopedTask {
+  bool _traced;
+
+  ScopedTask(const ScopedTask &) = delete;
+  ScopedTask &operator=(const ScopedTask &) = delete;
+
 public:
-  ScopedTask(const Domain &d, const StringHandle &s) {}
-  void end() {}
+  ScopedTask(const Domain &d, const StringHandle &s)
+      : _traced(TimeTrace::isEnabled()) {
+    if (_traced)
+      TimeTrace::begin(s.name());
+  }
+
+  ScopedTask(ScopedTask &&other) : _traced(other._traced) {
+    other._traced = false;
+  }
+
+  void end() {
+    if (_traced)
+      TimeTrace::end();
+    _traced = false;
+  }
+
+  ~ScopedTask() { end(); }
 };
 
 class Marker {
 public:
-  Marker(const Domain &d, const StringHandle &s) {}
+  Marker(const Domain &d, const StringHandle &s) {
+    if (TimeTrace::isEnabled())
+      TimeTrace::mark(s.name());
+  }
 };
 #endif
 
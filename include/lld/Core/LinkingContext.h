@@ -10,6 +10,7 @@
 #ifndef LLD_CORE_LINKING_CONTEXT_H
 #define LLD_CORE_LINKING_CONTEXT_H
 
+#include "lld/Core/DirectoryCache.h"
 #include "lld/Core/Error.h"
 #include "lld/Core/LLVM.h"
 #include "lld/Core/Node.h"
@@ -23,6 +24,7 @@
 #include <vector>
 
 namespace lld {
+class FilePrefetcher;
 class PassManager;
 class File;
 class Writer;
@@ -157,6 +159,18 @@ public:
   /// format the line as needed.
   bool logInputFiles() const { return _logInputFiles; }
 
+  /// If true, Driver::link() writes a Chrome trace of the link to
+  /// timeTraceFile(). This is used to implement the --time-trace option.
+  bool timeTrace() const { return _timeTrace; }
+
+  /// Returns the path of the trace file, which is "<output>.time-trace" if
+  /// no path was given.
+  std::string timeTraceFile() const;
+
+  /// If true, the driver prints time and memory usage, including the time
+  /// each pass took. This is used to implement the --stats option.
+  bool collectStats() const { return _collectStats; }
+
   /// Parts of LLVM use global variables which are bound to command line
   /// options (see llvm::cl::Options). This method returns "command line"
   /// options which are used to configure LLVM's command line settings.
@@ -199,6 +213,12 @@ public:
   void setAllowShlibUndefines(bool allow) { _allowShlibUndefines = allow; }
   void setLogInputFiles(bool log) { _logInputFiles = log; }
 
+  /// Starts recording the tasks of the link for --time-trace. The trace is
+  /// written to \p path, or next to the output file if \p path is empty.
+  void setTimeTrace(StringRef path);
+
+  void setCollectStats(bool s) { _collectStats = s; }
+
   // Returns true if multiple definitions should not be treated as a
   // fatal error.
   bool getAllowDuplicates() const { return _allowDuplicates; }
@@ -309,6 +329,28 @@ public:
 
   TaskGroup &getTaskGroup() { return _taskGroup; }
 
+  /// Starts reading the given input files in the background. Later calls to
+  /// getInputFileBuffer() and identifyInputFile() for these paths wait for
+  /// the background reads instead of reading the files again.
+  void prefetchInputFiles(const std::vector<std::string> &paths);
+
+  /// Returns the contents of the input file \p path.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> getInputFileBuffer(StringRef path);
+
+  /// Sets \p magic to the type of the input file \p path.
+  std::error_code identifyInputFile(StringRef path,
+                                    llvm::sys::fs::file_magic &magic);
+
+  /// Returns the prefetcher started by prefetchInputFiles(), or nullptr.
+  const FilePrefetcher *getFilePrefetcher() const {
+    return _filePrefetcher.get();
+  }
+
+  /// Returns the listings of the directories searched for input files. The
+  /// search functions of the subclasses look up candidates in it instead of
+  /// calling stat for each of them.
+  DirectoryCache &getDirectoryCache() const { return _directoryCache; }
+
   /// @}
 protected:
   LinkingContext(); // Must be subclassed
@@ -339,6 +381,9 @@ protected:
   bool _printRemainingUndefines;
   bool _allowRemainingUndefines;
   bool _logInputFiles;
+  bool _timeTrace;
+  StringRef _timeTraceFile;
+  bool _collectStats;
   bool _allowShlibUndefines;
   OutputFileType _outputFileType;
   std::vector<StringRef> _deadStripRoots;
@@ -354,6 +399,8 @@ private:
   /// Validate the subclass bits. Only called by validate.
   virtual bool validateImpl(raw_ostream &diagnostics) = 0;
   TaskGroup _taskGroup;
+  std::unique_ptr<FilePrefetcher> _filePrefetcher;
+  mutable DirectoryCache _directoryCache;
 };
 
 } // end namespace lld
@@ -211,7 +211,10 @@ public:
   void spawn(std::function<void()> f) {
     _latch.inc();
     getDefaultExecutor()->add([&, f] {
-      f();
+      {
+        ScopedTask task(getDefaultDomain(), "TaskGroup task");
+        f();
+      }
       _latch.dec();
     });
   }
@@ -298,9 +301,13 @@ void parallel_for_each(Iterator begin, Iterator end, Func func) {
   TaskGroup tg;
   ptrdiff_t taskSize = 1024;
   while (taskSize <= std::distance(begin, end)) {
-    tg.spawn([=, &func] { std::for_each(begin, begin + taskSize, func); });
+    tg.spawn([=, &func] {
+      ScopedTask task(getDefaultDomain(), "parallel_for_each");
+      std::for_each(begin, begin + taskSize, func);
+    });
     begin += taskSize;
   }
+  ScopedTask task(getDefaultDomain(), "parallel_for_each");
   std::for_each(begin, end, func);
 }
 #endif
@@ -29,13 +29,42 @@ class SimpleFile;
 /// actual work in it perform() method.  It can iterator over Atoms in the
 /// graph using the *begin()/*end() atom iterator of the File.  It can add
 /// new Atoms to the graph using the File's addAtom() method.
+///
+/// A pass may declare the parts of the link state it reads and writes. The
+/// PassManager runs adjacent passes whose accesses do not conflict
+/// concurrently. A pass that declares nothing accesses everything, and so it
+/// runs by itself.
 class Pass {
 public:
+  /// \brief The parts of the link state a pass accesses. Options of the
+  /// linking context do not change while passes run and need not be declared.
+  enum Resource : unsigned {
+    /// The atoms of the merged file, their order and their references.
+    AtomGraph = 1U << 0,
+    /// Atoms appended to the merged file with SimpleFile::addAtom(). Passes
+    /// that write only these run on a snapshot of the merged file when they
+    /// run concurrently, and their atoms are appended in pass order.
+    NewAtoms = 1U << 1,
+    /// State of the linking context computed by passes, such as the PE/COFF
+    /// subsystem.
+    ContextState = 1U << 2,
+    AllResources = ~0U
+  };
+
   virtual ~Pass() { }
 
   /// Do the actual work of the Pass.
   virtual void perform(std::unique_ptr<SimpleFile> &mergedFile) = 0;
 
+  /// Returns the name of the pass, used for timing and tracing.
+  virtual const char *name() const { return "Pass"; }
+
+  /// Returns the set of Resources the pass reads.
+  virtual unsigned reads() const { return AllResources; }
+
+  /// Returns the set of Resources the pass writes.
+  virtual unsigned writes() const { return AllResources; }
+
 protected:
   // Only subclassess can be instantiated.
   Pass() { }
@@ -21,25 +21,40 @@ class Pass;
 
 /// \brief Owns and runs a collection of passes.
 ///
-/// This class is currently just a container for passes and a way to run them.
-///
-/// In the future this should handle timing pass runs, running parallel passes,
-/// and validate/satisfy pass dependencies.
+/// Passes run in the order they were added. Adjacent passes that declare
+/// non-conflicting reads and writes (see Pass::Resource) run concurrently;
+/// passes that declare nothing run by themselves. The wall-clock time of each
+/// pass is recorded.
 class PassManager {
 public:
+  /// \brief The time a pass took to run.
+  struct PassTiming {
+    const char *name;
+    double seconds;
+  };
+
   void add(std::unique_ptr<Pass> pass) {
     _passes.push_back(std::move(pass));
   }
 
-  std::error_code runOnFile(std::unique_ptr<SimpleFile> &file) {
-    for (std::unique_ptr<Pass> &pass : _passes)
-      pass->perform(file);
-    return std::error_code();
-  }
+  std::error_code runOnFile(std::unique_ptr<SimpleFile> &file);
+
+  /// \brief Returns the timings of the last runOnFile, in pass order.
+  ArrayRef<PassTiming> timings() const { return _timings; }
+
+  /// \brief Prints the timings in the format of --stats.
+  void printTimings(raw_ostream &os) const;
+
+  /// \brief Returns true if \p a and \p b may run at the same time.
+  static bool canRunConcurrently(const Pass &a, const Pass &b);
 
 private:
+  void runConcurrently(unsigned begin, unsigned end,
+                       std::unique_ptr<SimpleFile> &file);
+
   /// \brief Passes in the order they should run.
   std::vector<std::unique_ptr<Pass>> _passes;
+  std::vector<PassTiming> _timings;
 };
 } // end namespace lld
 
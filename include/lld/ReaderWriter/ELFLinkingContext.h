@@ -328,10 +328,6 @@ public:
   bool stripSymbols() const { return _stripSymbols; }
   void setStripSymbols(bool strip) { _stripSymbols = strip; }
 
-  /// \brief Collect statistics.
-  bool collectStats() const { return _collectStats; }
-  void setCollectStats(bool s) { _collectStats = s; }
-
   // --wrap option.
   void addWrapForSymbol(StringRef sym) { _wrapCalls.insert(sym); }
 
@@ -389,7 +385,6 @@ protected:
   bool _stripSymbols = false;
   bool _alignSegments = true;
   bool _enableNewDtags = false;
-  bool _collectStats = false;
   bool _armTarget1Rel = false;
   bool _mipsPcRelEhRel = false;
   uint64_t _maxPageSize = 0x1000;
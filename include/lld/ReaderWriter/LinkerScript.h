@@ -18,6 +18,7 @@
 #include "lld/Core/Error.h"
 #include "lld/Core/LLVM.h"
 #include "lld/Core/range.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
@@ -27,7 +28,9 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
+#include <bitset>
 #include <memory>
+#include <mutex>
 #include <system_error>
 #include <unordered_map>
 #include <vector>
@@ -122,7 +125,13 @@ public:
     _sourceManager.AddNewSourceBuffer(std::move(mb), llvm::SMLoc());
   }
 
-  void lex(Token &tok);
+  /// Returns the next token. Tokens are lexed ahead in batches, because the
+  /// lexer does not depend on the parser state.
+  void lex(Token &tok) {
+    if (_nextToken == _tokens.size())
+      fillTokenBuffer();
+    tok = _tokens[_nextToken++];
+  }
 
   const llvm::SourceMgr &getSourceMgr() const { return _sourceManager; }
 
@@ -132,10 +141,15 @@ private:
   bool canStartName(char c) const;
   bool canContinueName(char c) const;
   void skipWhitespace();
+  void lexToken(Token &tok);
+  void fillTokenBuffer();
 
   Token _current;
   /// \brief The current buffer state.
   StringRef _buffer;
+  /// Tokens lexed ahead, and the index of the next one to return.
+  std::vector<Token> _tokens;
+  size_t _nextToken = 0;
   // Lexer owns the input files.
   llvm::SourceMgr _sourceManager;
 };
@@ -407,6 +421,7 @@ public:
   }
 
   ErrorOr<int64_t> evalExpr(SymbolTableTy &symbolTable) const override;
+  uint64_t num() const { return _num; }
 
 private:
   uint64_t _num;
@@ -423,6 +438,7 @@ public:
   }
 
   ErrorOr<int64_t> evalExpr(SymbolTableTy &symbolTable) const override;
+  StringRef name() const { return _name; }
 
 private:
   StringRef _name;
@@ -469,6 +485,8 @@ public:
   }
 
   ErrorOr<int64_t> evalExpr(SymbolTableTy &symbolTable) const override;
+  Operation op() const { return _op; }
+  const Expression *child() const { return _child; }
 
 private:
   Operation _op;
@@ -504,6 +522,9 @@ public:
   }
 
   ErrorOr<int64_t> evalExpr(SymbolTableTy &symbolTable) const override;
+  Operation op() const { return _op; }
+  const Expression *lhs() const { return _lhs; }
+  const Expression *rhs() const { return _rhs; }
 
 private:
   Operation _op;
@@ -539,6 +560,9 @@ public:
   }
 
   ErrorOr<int64_t> evalExpr(SymbolTableTy &symbolTable) const override;
+  const Expression *conditional() const { return _conditional; }
+  const Expression *trueExpr() const { return _trueExpr; }
+  const Expression *falseExpr() const { return _falseExpr; }
 
 private:
   const Expression *_conditional;
@@ -546,6 +570,57 @@ private:
   const Expression *_falseExpr;
 };
 
+/// An expression compiled to a flat program for a stack machine. Evaluating
+/// the program gives the same result as Expression::evalExpr, but symbols are
+/// referred to by slot indices into a value table instead of by name, so no
+/// string lookups are done. Subexpressions that do not refer to symbols are
+/// folded into constants when the expression is compiled.
+class CompiledExpr {
+public:
+  /// Maps symbol names to slot indices. New symbols get the next free slot.
+  typedef llvm::StringMap<unsigned> SlotMapTy;
+
+  /// The values of the symbols, indexed by slot. A slot without a value
+  /// refers to a symbol that has not been assigned yet.
+  struct SlotTable {
+    std::vector<int64_t> values;
+    std::vector<bool> defined;
+  };
+
+  CompiledExpr() {}
+  CompiledExpr(const Expression *expr, SlotMapTy &slots);
+
+  ErrorOr<int64_t> eval(const SlotTable &table) const;
+
+  /// Returns true if the expression was folded into a constant.
+  bool isConstant() const {
+    return _code.size() == 1 && _code[0].opcode == PushConstant;
+  }
+
+private:
+  enum Opcode : uint8_t {
+    PushConstant, // Push operand.
+    PushSymbol,   // Push the value of slot operand, or fail if undefined.
+    ApplyUnary,   // Replace the top of the stack with unaryOp applied to it.
+    ApplyBinary,  // Pop rhs and lhs, and push the result of binaryOp.
+    JumpIfZero,   // Pop a value, and jump to operand if it is zero.
+    Jump,         // Jump to operand.
+    Fail          // Fail with the LinkerScriptReaderError in operand.
+  };
+
+  struct Instruction {
+    Opcode opcode;
+    Unary::Operation unaryOp;
+    BinOp::Operation binaryOp;
+    int64_t operand;
+  };
+
+  void compile(const Expression *expr, SlotMapTy &slots);
+  void emit(Opcode opcode, int64_t operand = 0);
+
+  std::vector<Instruction> _code;
+};
+
 /// Symbol assignments of the form "symbolname = <expression>" may occur either
 /// as sections-commands or as output-section-commands.
 /// Example:
@@ -743,12 +818,13 @@ public:
       const Expression *align, const Expression *subAlign, const Expression *at,
       const Expression *fillExpr, StringRef fillStream, bool alignWithInput,
       bool discard, Constraint constraint,
-      const SmallVectorImpl<const Command *> &outputSectionCommands)
+      const SmallVectorImpl<const Command *> &outputSectionCommands,
+      StringRef region = StringRef(), StringRef lmaRegion = StringRef())
       : Command(ctx, Kind::OutputSectionDescription), _sectionName(sectionName),
         _address(address), _align(align), _subAlign(subAlign), _at(at),
         _fillExpr(fillExpr), _fillStream(fillStream),
         _alignWithInput(alignWithInput), _discard(discard),
-        _constraint(constraint) {
+        _constraint(constraint), _region(region), _lmaRegion(lmaRegion) {
     size_t numCommands = outputSectionCommands.size();
     const Command **commandsStart =
         getAllocator().Allocate<const Command *>(numCommands);
@@ -767,6 +843,12 @@ public:
   const_iterator end() const { return _outputSectionCommands.end(); }
   StringRef name() const { return _sectionName; }
 
+  /// The memory region given by ">region", or empty if none.
+  StringRef region() const { return _region; }
+
+  /// The memory region given by "AT>region", or empty if none.
+  StringRef lmaRegion() const { return _lmaRegion; }
+
 private:
   StringRef _sectionName;
   const Expression *_address;
@@ -778,6 +860,8 @@ private:
   bool _alignWithInput;
   bool _discard;
   Constraint _constraint;
+  StringRef _region;
+  StringRef _lmaRegion;
   llvm::ArrayRef<const Command *> _outputSectionCommands;
 };
 
@@ -831,6 +915,11 @@ public:
 
   void dump(raw_ostream &os) const;
 
+  StringRef name() const { return _name; }
+  StringRef attr() const { return _attr; }
+  const Expression *origin() const { return _origin; }
+  const Expression *length() const { return _length; }
+
 private:
   StringRef _name;
   StringRef _attr;
@@ -841,6 +930,8 @@ private:
 /// Represents all the contents of the MEMORY {} command.
 class Memory : public Command {
 public:
+  typedef llvm::ArrayRef<const MemoryBlock *>::const_iterator const_iterator;
+
   Memory(Parser &ctx,
          const SmallVectorImpl<const MemoryBlock *> &blocks)
       : Command(ctx, Kind::Memory) {
@@ -857,6 +948,9 @@ public:
 
   void dump(raw_ostream &os) const override;
 
+  const_iterator begin() const { return _blocks.begin(); }
+  const_iterator end() const { return _blocks.end(); }
+
 private:
   llvm::ArrayRef<const MemoryBlock *> _blocks;
 };
@@ -1192,6 +1286,42 @@ private:
   Token _bufferedToken;
 };
 
+/// A glob pattern in a linker script, compiled once so that it can be matched
+/// against many names. '*' matches any sequence of characters, '?' matches
+/// any character, "[...]" matches a set of characters and '\' escapes the
+/// next character.
+///
+/// Most patterns are a plain name, "prefix*" or "*suffix", and they are
+/// matched with a single string comparison. Other patterns are matched by
+/// simulating an NFA, which does not backtrack.
+class WildcardPattern {
+public:
+  enum class Kind { Literal, Prefix, Suffix, Any, General };
+
+  WildcardPattern() : _kind(Kind::Literal) {}
+  explicit WildcardPattern(StringRef pattern);
+
+  bool match(StringRef name) const;
+
+  Kind kind() const { return _kind; }
+
+  /// Returns the literal part of a Literal, Prefix or Suffix pattern.
+  StringRef text() const { return _text; }
+
+private:
+
+  /// An element of a general pattern. It is either a star or a set of
+  /// characters that matches a single character.
+  struct Element {
+    bool star;
+    std::bitset<256> chars;
+  };
+
+  Kind _kind;
+  StringRef _text;
+  std::vector<Element> _elements;
+};
+
 /// script::Sema traverses all parsed linker script structures and populate
 /// internal data structures to be able to answer the following questions:
 ///
@@ -1214,6 +1344,9 @@ public:
     StringRef archivePath;
     StringRef memberPath;
     StringRef sectionName;
+    /// The alignment of the input section. It is used only to sort sections
+    /// by alignment and does not take part in rule matching.
+    uint64_t alignment;
   };
 
   Sema();
@@ -1230,8 +1363,57 @@ public:
 
   /// Prepare our data structures according to the linker scripts currently in
   /// our control (control given via addLinkerScript()). Called once all linker
-  /// scripts have been parsed.
-  void perform();
+  /// scripts have been parsed. Returns an error if a MEMORY region is invalid
+  /// or an output section refers to an undeclared region.
+  std::error_code perform();
+
+  /// A region of the MEMORY command. The cursor is the next free address in
+  /// the region and is advanced as output sections are placed in it.
+  struct MemoryRegion {
+    StringRef name;
+    uint64_t origin;
+    uint64_t length;
+    uint64_t cursor;
+    /// The first output section that did not fit in the region.
+    StringRef overflowSection;
+
+    /// Records that an output section occupies the region up to \p end.
+    void allocate(uint64_t end, StringRef section) {
+      if (end > cursor)
+        cursor = end;
+      if (overflowSection.empty() && overflow() > 0)
+        overflowSection = section;
+    }
+
+    /// Returns the number of bytes by which the region overflows.
+    uint64_t overflow() const {
+      return cursor - origin > length ? cursor - origin - length : 0;
+    }
+  };
+
+  /// Returns the region an output section is placed in with ">region", or
+  /// null if it has none.
+  MemoryRegion *getMemoryRegion(StringRef outputSection);
+
+  /// Returns the region given with "AT>region" for an output section, or
+  /// null if it has none.
+  MemoryRegion *getLMAMemoryRegion(StringRef outputSection);
+
+  bool hasMemoryRegions() const { return !_memoryRegions.empty(); }
+
+  /// Rewinds the cursors of all memory regions to their origins. This is
+  /// called each time the output file layout assigns addresses.
+  void resetMemoryRegions();
+
+  /// Returns an error that names each memory region that overflowed and the
+  /// output section that did not fit in it, or success if none did.
+  std::error_code checkMemoryRegions() const;
+
+  /// Returns the name of the output section description a symbol assignment
+  /// is written in, or an empty string if it is at the SECTIONS level.
+  StringRef getEnclosingOutputSection(const SymbolAssignment *assgn) const {
+    return _assignmentOutputSections.lookup(assgn);
+  }
 
   /// Answer if we have layout commands (section mapping rules). If we don't,
   /// the output file writer can assume there is no linker script special rule
@@ -1243,10 +1425,42 @@ public:
     return getLayoutOrder(key, true) >= 0;
   }
 
-  /// Order function - used to sort input sections in the output file according
-  /// to linker script custom mappings. Return true if lhs should appear before
-  /// rhs.
-  bool less(const SectionKey &lhs, const SectionKey &rhs) const;
+  /// A key to sort input sections by, so that they appear in the output file
+  /// in the order of the linker script mapping rules. The wildcard matching
+  /// is done only once per section.
+  struct SectionOrderKey {
+    /// The layout order of the matching InputSectionsCmd, or INT_MAX if the
+    /// section has no mapping rule.
+    int order;
+    /// Sections from different files are ordered by archive and member path
+    /// if the rule sorts them by name, and by the position where their
+    /// archive or file first appears in the input otherwise. Fields that do
+    /// not apply are zero or empty.
+    unsigned archiveOrdinal;
+    StringRef archivePath;
+    unsigned fileOrdinal;
+    StringRef memberPath;
+    /// The index of the first input section name or sorted group in the rule
+    /// that matches the section.
+    int rank;
+    /// The keys within the sorted group that matched the section, in the
+    /// order they are compared: the init priority or the inverted alignment,
+    /// the section name, and the inverted alignment again for
+    /// SORT_BY_NAME(SORT_BY_ALIGNMENT). Keys the group does not sort by
+    /// are zero or empty.
+    uint64_t groupKey;
+    StringRef sectionName;
+    uint64_t groupSubkey;
+
+    bool operator<(const SectionOrderKey &other) const;
+  };
+
+  /// Returns the sort key of an input section. \p archiveOrdinal and
+  /// \p fileOrdinal number the archive and the file of the section in the
+  /// order they first appear in the input. This does not update the caches,
+  /// so it can be called from multiple threads.
+  SectionOrderKey getOrderKey(const SectionKey &key, unsigned archiveOrdinal,
+                              unsigned fileOrdinal) const;
 
   /// Retrieve the name of the output section that this input section is mapped
   /// to, according to custom linker script mappings.
@@ -1257,16 +1471,20 @@ public:
   /// first section to retrieve a given set of expression is the only one to
   /// receive it. This set is marked as "delivered" and no other sections can
   /// retrieve this set again. If we don't do this, multiple sections may map
-  /// to the same set of expressions because of wildcards rules.
-  std::vector<const SymbolAssignment *> getExprs(const SectionKey &key);
+  /// to the same set of expressions because of wildcards rules. The returned
+  /// array is owned by Sema.
+  ArrayRef<const SymbolAssignment *> getExprs(const SectionKey &key);
 
   /// Evaluate a single linker script expression according to our current
   /// context (symbol table). This function is *not* constant because it can
   /// update our symbol table with new symbols calculated in this expression.
   std::error_code evalExpr(const SymbolAssignment *assgn, uint64_t &curPos);
 
-  /// Retrieve the set of symbols defined in linker script expressions.
-  const llvm::StringSet<> &getScriptDefinedSymbols() const;
+  /// Retrieve the set of symbols defined in linker script expressions. The set
+  /// is populated by perform().
+  const llvm::StringSet<> &getScriptDefinedSymbols() const {
+    return _definedSymbols;
+  }
 
   /// Queries the linker script symbol table for the value of a given symbol.
   /// This function must be called after linker script expressions evaluation
@@ -1295,11 +1513,64 @@ private:
     }
   };
 
+  /// A cache of layout orders that can be used from multiple threads. Keys are
+  /// spread over shards that are locked independently, so that threads
+  /// looking up different sections rarely wait for each other.
+  class LayoutOrderCache {
+  public:
+    bool lookup(const SectionKey &key, int &order) const;
+    void insert(const SectionKey &key, int order);
+
+  private:
+    static const unsigned numShards = 16;
+
+    struct Shard {
+      std::mutex mutex;
+      std::unordered_map<SectionKey, int, SectionKeyHash, SectionKeyEq> map;
+    };
+
+    Shard &getShard(const SectionKey &key) const {
+      return _shards[SectionKeyHash()(key) % numShards];
+    }
+
+    mutable Shard _shards[numShards];
+  };
+
+  /// An index from section names to the rules that have a section name
+  /// pattern that may match them. Rules are numbered by the caller. Literal,
+  /// prefix and suffix patterns are looked up by hashing the name and its
+  /// prefixes and suffixes, so the cost of a lookup does not depend on the
+  /// number of rules. Other patterns are always candidates.
+  class SectionNameIndex {
+  public:
+    void add(const WildcardPattern &pattern, unsigned rule);
+
+    /// Returns the candidate rules for a section name in ascending order.
+    void lookup(StringRef name, SmallVectorImpl<unsigned> &rules) const;
+
+  private:
+    static void add(llvm::StringMap<std::vector<unsigned>> &map,
+                    StringRef key, unsigned rule);
+
+    llvm::StringMap<std::vector<unsigned>> _literals;
+    llvm::StringMap<std::vector<unsigned>> _prefixes;
+    llvm::StringMap<std::vector<unsigned>> _suffixes;
+    std::vector<unsigned> _others;
+    size_t _maxPrefixSize = 0;
+    size_t _maxSuffixSize = 0;
+  };
+
   /// Given an order id, check if it matches the tuple
   /// <archivePath, memberPath, sectionName> and returns the
   /// internal id that matched, or -1 if no matches.
   int matchSectionName(int id, const SectionKey &key) const;
 
+  /// Returns true if any input section name in the sorted group matches the
+  /// section name. \p id is the layout id of the first name in the group. It
+  /// is advanced past the names of the group.
+  bool sortedGroupContains(const InputSectionSortedGroup *cmd,
+                           const SectionKey &key, int &id) const;
+
   /// Returns a number that will determine the order of this input section
   /// in the final layout. If coarse is true, we simply return the layour order
   /// of the higher-level node InputSectionsCmd, used to order input sections.
@@ -1308,11 +1579,8 @@ private:
   ///expressions.
   int getLayoutOrder(const SectionKey &key, bool coarse) const;
 
-  /// Compare two sections that have the same mapping rule (i.e., are matched
-  /// by the same InputSectionsCmd).
-  /// Determine if lhs < rhs by analyzing the InputSectionsCmd structure.
-  bool localCompare(int order, const SectionKey &lhs,
-                    const SectionKey &rhs) const;
+  /// Same as getLayoutOrder, but does not use the caches.
+  int findLayoutOrder(const SectionKey &key, bool coarse) const;
 
 
   /// Our goal with all linearizeAST overloaded functions is to
@@ -1370,18 +1638,62 @@ private:
   void linearizeAST(const InputSectionsCmd *inputSections);
   void linearizeAST(const InputSection *inputSection);
 
+  /// Appends a layout command. \p pattern is the archive name pattern of an
+  /// InputSectionsCmd or the section name pattern of an InputSectionName.
+  void addLayoutCommand(const Command *cmd, StringRef pattern = StringRef());
+
   void perform(const LinkerScript *ls);
 
+  /// Evaluates the regions of the MEMORY commands and maps output sections to
+  /// them.
+  std::error_code buildMemoryRegions();
+
   std::vector<std::unique_ptr<Parser>> _scripts;
   std::vector<const Command *> _layoutCommands;
-  std::unordered_multimap<std::string, int> _memberToLayoutOrder;
-  std::vector<std::pair<StringRef, int>> _memberNameWildcards;
-  mutable std::unordered_map<SectionKey, int, SectionKeyHash, SectionKeyEq>
-      _cacheSectionOrder, _cacheExpressionOrder;
-  llvm::DenseSet<int> _deliveredExprs;
-  mutable llvm::StringSet<> _definedSymbols;
-
-  Expression::SymbolTableTy _symbolTable;
+  /// The compiled patterns of the layout commands, indexed by layout id.
+  std::vector<WildcardPattern> _layoutPatterns;
+  /// Layout orders of the InputSectionsCmds with a plain member name.
+  llvm::StringMap<std::vector<int>> _memberToLayoutOrder;
+  /// InputSectionsCmds with a wildcard member name, in layout order. They
+  /// are indexed by their section name patterns in _memberNameWildcardIndex.
+  std::vector<std::pair<WildcardPattern, int>> _memberNameWildcards;
+  SectionNameIndex _memberNameWildcardIndex;
+  mutable LayoutOrderCache _cacheSectionOrder, _cacheExpressionOrder;
+  /// The symbol assignments of the layout commands, in layout order.
+  std::vector<const SymbolAssignment *> _layoutAssignments;
+  /// For each layout id, the range of _layoutAssignments between the
+  /// preceding input section and the layout command. These are the
+  /// expressions getExprs() returns for an input section.
+  std::vector<std::pair<unsigned, unsigned>> _exprRanges;
+  /// The layout ids whose expressions have been returned by getExprs().
+  llvm::BitVector _deliveredExprs;
+  llvm::StringSet<> _definedSymbols;
+  /// Output section names of the assignments inside output section
+  /// descriptions.
+  llvm::DenseMap<const SymbolAssignment *, StringRef> _assignmentOutputSections;
+
+  /// The regions of the MEMORY commands. The vector is not resized after
+  /// perform(), so pointers to regions stay valid.
+  std::vector<MemoryRegion> _memoryRegions;
+  /// Indices into _memoryRegions of the ">region" and "AT>region" of each
+  /// output section that has one. -1 means none.
+  llvm::StringMap<std::pair<int, int>> _outputSectionRegions;
+
+  /// A symbol assignment compiled by compileAssignment().
+  struct CompiledAssignment {
+    CompiledExpr expr;
+    /// The slot of the assigned symbol.
+    unsigned slot;
+  };
+
+  /// Compiles the given assignment, or returns the cached result.
+  const CompiledAssignment &compileAssignment(const SymbolAssignment *assgn);
+
+  /// Slots of the symbols of linker script expressions. The location
+  /// counter "." has slot 0.
+  CompiledExpr::SlotMapTy _symbolSlots;
+  CompiledExpr::SlotTable _symbolValues;
+  llvm::DenseMap<const SymbolAssignment *, CompiledAssignment> _compiledExprs;
 };
 
 llvm::BumpPtrAllocator &Command::getAllocator() const {
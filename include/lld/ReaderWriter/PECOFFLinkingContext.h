@@ -65,6 +65,33 @@ public:
     bool isPrivate;
   };
 
+  /// A relocation in a .debug$S section. The target is the atom of the
+  /// symbol the relocation refers to, or null if the symbol has no atom.
+  struct DebugRelocation {
+    uint32_t offset;
+    uint16_t type;
+    const Atom *target;
+  };
+
+  /// A CodeView symbol section (.debug$S) and its relocations. Symbol records
+  /// and line tables refer to code and data by section-relative addresses,
+  /// which are resolved by the writer after layout.
+  struct DebugSymbols {
+    ArrayRef<uint8_t> data;
+    std::vector<DebugRelocation> relocations;
+  };
+
+  /// The CodeView debug sections of an input object file. They are used to
+  /// create a PDB file if /DEBUG is given. Every linked object file has one,
+  /// even if it has no debug sections, because it is a module in the PDB.
+  struct DebugSections {
+    DebugSections() : file(nullptr) {}
+    const File *file;
+    std::string fileName;
+    std::vector<ArrayRef<uint8_t>> types;
+    std::vector<DebugSymbols> symbols;
+  };
+
   typedef bool (*ParseDirectives)(int, const char **, PECOFFLinkingContext &,
                                   raw_ostream &);
 
@@ -175,6 +202,12 @@ public:
   void setDynamicBaseEnabled(bool val) { _dynamicBaseEnabled = val; }
   bool getDynamicBaseEnabled() const { return _dynamicBaseEnabled; }
 
+  void setReproducible(bool val) { _reproducible = val; }
+  bool isReproducible() const { return _reproducible; }
+
+  void setChecksumEnabled(bool val) { _checksumEnabled = val; }
+  bool getChecksumEnabled() const { return _checksumEnabled; }
+
   void setCreateManifest(bool val) { _createManifest = val; }
   bool getCreateManifest() const { return _createManifest; }
 
@@ -222,11 +255,18 @@ public:
   std::string getOutputImportLibraryPath() const;
 
   void setDebug(bool val) { _debug = val; }
-  bool getDebug() { return _debug; }
+  bool getDebug() const { return _debug; }
 
   void setPDBFilePath(StringRef str) { _pdbFilePath = str; }
   std::string getPDBFilePath() const;
 
+  void addDebugSections(DebugSections sections) {
+    _debugSections.push_back(std::move(sections));
+  }
+  const std::vector<DebugSections> &getDebugSections() const {
+    return _debugSections;
+  }
+
   void addDelayLoadDLL(StringRef dll) {
     _delayLoadDLLs.insert(dll.lower());
   }
@@ -365,6 +405,8 @@ private:
   bool _baseRelocationEnabled = true;
   bool _terminalServerAware = true;
   bool _dynamicBaseEnabled = true;
+  bool _reproducible = false;
+  bool _checksumEnabled = false;
   bool _createManifest = true;
   std::string _manifestOutputPath;
   bool _embedManifest = false;
@@ -392,9 +434,12 @@ private:
   // True if /DEBUG is given.
   bool _debug = false;
 
-  // PDB file output path. NB: this is dummy -- LLD just creates the empty file.
+  // PDB file output path.
   std::string _pdbFilePath = "";
 
+  // CodeView debug sections of the linked object files, in link order.
+  std::vector<DebugSections> _debugSections;
+
   // /DELAYLOAD option.
   std::set<std::string> _delayLoadDLLs;
 
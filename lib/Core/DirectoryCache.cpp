@@ -0,0 +1,75 @@
+//===- lib/Core/DirectoryCache.cpp - Cached directory listings ------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "lld/Core/DirectoryCache.h"
+#include "lld/Core/Parallel.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+using namespace lld;
+
+void DirectoryCache::list(StringRef dir, Directory &result) {
+  std::error_code ec;
+  llvm::sys::fs::directory_iterator it(dir, ec), end;
+  // Nothing exists in a directory that does not exist.
+  if (ec == llvm::errc::no_such_file_or_directory) {
+    result.listed = true;
+    return;
+  }
+  for (; !ec && it != end; it.increment(ec))
+    result.names.insert(llvm::sys::path::filename(it->path()).lower());
+  // A partial listing cannot rule anything out.
+  result.listed = !ec;
+  if (ec)
+    result.names.clear();
+}
+
+bool DirectoryCache::exists(StringRef path) {
+  StringRef name = llvm::sys::path::filename(path);
+  if (name.empty() || name == "." || name == "..")
+    return llvm::sys::fs::exists(path);
+  StringRef dir = llvm::sys::path::parent_path(path);
+  if (dir.empty())
+    dir = ".";
+
+  bool found;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_ptr<Directory> &entry = _dirs[dir];
+    if (!entry) {
+      entry = llvm::make_unique<Directory>();
+      list(dir, *entry);
+    }
+    found = !entry->listed || entry->names.count(name.lower());
+  }
+  return found && llvm::sys::fs::exists(path);
+}
+
+void DirectoryCache::listDirectories(const std::vector<std::string> &dirs) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<std::pair<StringRef, Directory *>> work;
+  for (StringRef dir : dirs) {
+    // Use the key exists() would use for files in the directory.
+    while (dir.size() > 1 && llvm::sys::path::is_separator(dir.back()))
+      dir = dir.drop_back();
+    std::unique_ptr<Directory> &entry = _dirs[dir];
+    if (entry)
+      continue;
+    entry = llvm::make_unique<Directory>();
+    work.push_back(std::make_pair(dir, entry.get()));
+  }
+  // Each task fills in its own Directory, which no lookup can see until the
+  // lock is released.
+  TaskGroup tg;
+  for (const std::pair<StringRef, Directory *> &w : work)
+    tg.spawn([w] { list(w.first, *w.second); });
+  tg.sync();
+}
@@ -0,0 +1,136 @@
+//===- lib/Core/FilePrefetcher.cpp - Read input files ahead ---------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "lld/Core/FilePrefetcher.h"
+#include "lld/Core/Instrumentation.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace lld;
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// Touches every page of \p mb, so that a mapped file is read from disk now
+/// rather than when the reader faults on it.
+static void touchPages(const MemoryBuffer &mb) {
+  const volatile char *p = mb.getBufferStart();
+  for (size_t i = 0, e = mb.getBufferSize(); i < e; i += 4096)
+    (void)p[i];
+}
+
+FilePrefetcher::FilePrefetcher(const std::vector<std::string> &paths,
+                               unsigned maxThreads)
+    : _next(0), _stop(false), _readSeconds(0), _waitSeconds(0) {
+  for (const std::string &path : paths) {
+    // Standard input cannot be read twice, and is left to the reader.
+    if (path == "-" || _index.count(path))
+      continue;
+    _index[path] = _entries.size();
+    _entries.push_back(Entry(path));
+  }
+  // Reading is bound by I/O rather than by the CPU, so the number of threads
+  // does not depend on the number of cores.
+  size_t numThreads = std::min<size_t>(maxThreads, _entries.size());
+  for (size_t i = 0; i < numThreads; ++i)
+    _threads.push_back(std::thread([this] { work(); }));
+}
+
+FilePrefetcher::~FilePrefetcher() {
+  _stop = true;
+  for (std::thread &t : _threads)
+    t.join();
+}
+
+void FilePrefetcher::work() {
+  while (!_stop) {
+    size_t i = _next++;
+    if (i >= _entries.size())
+      return;
+    Entry &entry = _entries[i];
+    ScopedTask task(getDefaultDomain(), "Prefetch input file");
+    Clock::time_point start = Clock::now();
+    ErrorOr<std::unique_ptr<MemoryBuffer>> mbOrErr =
+        MemoryBuffer::getFile(entry.path);
+    llvm::sys::fs::file_magic magic = llvm::sys::fs::file_magic::unknown;
+    if (mbOrErr) {
+      touchPages(*mbOrErr.get());
+      magic = llvm::sys::fs::identify_magic(mbOrErr.get()->getBuffer());
+    }
+    double seconds = secondsSince(start);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (std::error_code ec = mbOrErr.getError())
+      entry.ec = ec;
+    else
+      entry.mb = std::move(mbOrErr.get());
+    entry.magic = magic;
+    entry.done = true;
+    _readSeconds += seconds;
+    _cond.notify_all();
+  }
+}
+
+/// Returns the entry for \p path after its read has finished, or nullptr if
+/// the path was not prefetched or its buffer was already taken.
+FilePrefetcher::Entry *
+FilePrefetcher::wait(StringRef path, std::unique_lock<std::mutex> &lock) {
+  auto it = _index.find(path);
+  if (it == _index.end())
+    return nullptr;
+  Entry &entry = _entries[it->second];
+  if (entry.taken)
+    return nullptr;
+  if (!entry.done) {
+    Clock::time_point start = Clock::now();
+    _cond.wait(lock, [&] { return entry.done; });
+    _waitSeconds += secondsSince(start);
+  }
+  return &entry;
+}
+
+ErrorOr<std::unique_ptr<MemoryBuffer>> FilePrefetcher::take(StringRef path) {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (Entry *entry = wait(path, lock)) {
+      entry->taken = true;
+      if (entry->ec)
+        return entry->ec;
+      return std::move(entry->mb);
+    }
+  }
+  return MemoryBuffer::getFileOrSTDIN(path);
+}
+
+std::error_code FilePrefetcher::identify(StringRef path,
+                                         llvm::sys::fs::file_magic &magic) {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (Entry *entry = wait(path, lock)) {
+      if (entry->ec)
+        return entry->ec;
+      magic = entry->magic;
+      return std::error_code();
+    }
+  }
+  return llvm::sys::fs::identify_magic(path, magic);
+}
+
+double FilePrefetcher::readSeconds() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _readSeconds;
+}
+
+double FilePrefetcher::waitSeconds() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _waitSeconds;
+}
@@ -0,0 +1,178 @@
+//===- lib/Core/Instrumentation.cpp - Instrumentation API -----------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "lld/Core/Instrumentation.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace lld;
+
+namespace {
+
+struct TraceEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  bool instant;
+};
+
+/// The events of one thread. Only the owning thread appends to it.
+struct ThreadTrace {
+  explicit ThreadTrace(unsigned tid) : tid(tid) {}
+
+  unsigned tid;
+  std::vector<TraceEvent> events;
+  /// Indices of the events that have begun but not ended, innermost last.
+  std::vector<size_t> open;
+};
+
+struct TraceState {
+  /// Guards the registration of threads.
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadTrace>> threads;
+  std::chrono::steady_clock::time_point start;
+  bool started = false;
+};
+
+} // end anonymous namespace
+
+std::atomic<bool> TimeTrace::_enabled(false);
+
+static TraceState &getTraceState() {
+  static TraceState state;
+  return state;
+}
+
+static LLVM_THREAD_LOCAL ThreadTrace *currentThreadTrace;
+
+/// Returns the buffer of the current thread. Buffers are never freed, so that
+/// the pointers cached by threads stay valid.
+static ThreadTrace &getThreadTrace() {
+  if (!currentThreadTrace) {
+    TraceState &state = getTraceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.threads.push_back(
+        llvm::make_unique<ThreadTrace>(state.threads.size() + 1));
+    currentThreadTrace = state.threads.back().get();
+  }
+  return *currentThreadTrace;
+}
+
+/// Returns the time since tracing was enabled in nanoseconds.
+static uint64_t now() {
+  auto elapsed = std::chrono::steady_clock::now() - getTraceState().start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void TimeTrace::enable() {
+  TraceState &state = getTraceState();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.started) {
+      state.start = std::chrono::steady_clock::now();
+      state.started = true;
+    }
+  }
+  _enabled.store(true, std::memory_order_release);
+}
+
+void TimeTrace::begin(const char *name) {
+  ThreadTrace &trace = getThreadTrace();
+  trace.open.push_back(trace.events.size());
+  trace.events.push_back({name, now(), 0, false});
+}
+
+void TimeTrace::end() {
+  ThreadTrace &trace = getThreadTrace();
+  // The thread may have begun the task before the trace was cleared.
+  if (trace.open.empty())
+    return;
+  trace.events[trace.open.back()].end = now();
+  trace.open.pop_back();
+}
+
+void TimeTrace::mark(const char *name) {
+  uint64_t time = now();
+  getThreadTrace().events.push_back({name, time, time, true});
+}
+
+static void writeEscaped(raw_ostream &os, StringRef str) {
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      os << llvm::format("\\u%04x", c);
+    else
+      os << c;
+  }
+}
+
+static void writeMicroseconds(raw_ostream &os, uint64_t ns) {
+  os << ns / 1000 << '.' << llvm::format("%03u", unsigned(ns % 1000));
+}
+
+void TimeTrace::write(raw_ostream &os) {
+  TraceState &state = getTraceState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (const std::unique_ptr<ThreadTrace> &trace : state.threads) {
+    for (size_t i = 0, e = trace->events.size(); i != e; ++i) {
+      const TraceEvent &event = trace->events[i];
+      // Skip tasks that are still running.
+      if (!event.instant &&
+          std::find(trace->open.begin(), trace->open.end(), i) !=
+              trace->open.end())
+        continue;
+      os << (first ? "\n" : ",\n");
+      first = false;
+      os << "{\"pid\":1,\"tid\":" << trace->tid << ",\"ph\":\""
+         << (event.instant ? "i" : "X") << "\",\"name\":\"";
+      writeEscaped(os, event.name);
+      os << "\",\"ts\":";
+      writeMicroseconds(os, event.begin);
+      if (event.instant) {
+        os << ",\"s\":\"t\"}";
+        continue;
+      }
+      os << ",\"dur\":";
+      writeMicroseconds(os, event.end - event.begin);
+      os << "}";
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::error_code TimeTrace::write(StringRef path) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::F_Text);
+  if (ec)
+    return ec;
+  write(os);
+  return std::error_code();
+}
+
+void TimeTrace::clear() {
+  _enabled.store(false, std::memory_order_release);
+  TraceState &state = getTraceState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (std::unique_ptr<ThreadTrace> &trace : state.threads) {
+    trace->events.clear();
+    trace->open.clear();
+  }
+  state.started = false;
+}
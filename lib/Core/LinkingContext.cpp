@@ -8,6 +8,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "lld/Core/Alias.h"
+#include "lld/Core/FilePrefetcher.h"
+#include "lld/Core/Instrumentation.h"
 #include "lld/Core/LinkingContext.h"
 #include "lld/Core/Resolver.h"
 #include "lld/Core/Simple.h"
@@ -24,7 +26,8 @@ LinkingContext::LinkingContext()
       _warnIfCoalesableAtomsHaveDifferentCanBeNull(false),
       _warnIfCoalesableAtomsHaveDifferentLoadName(false),
       _printRemainingUndefines(true), _allowRemainingUndefines(false),
-      _logInputFiles(false), _allowShlibUndefines(true),
+      _logInputFiles(false), _timeTrace(false), _collectStats(false),
+      _allowShlibUndefines(true),
       _outputFileType(OutputFileType::Default), _nextOrdinal(0) {}
 
 LinkingContext::~LinkingContext() {}
@@ -33,6 +36,18 @@ bool LinkingContext::validate(raw_ostream &diagnostics) {
   return validateImpl(diagnostics);
 }
 
+void LinkingContext::setTimeTrace(StringRef path) {
+  _timeTrace = true;
+  _timeTraceFile = path;
+  TimeTrace::enable();
+}
+
+std::string LinkingContext::timeTraceFile() const {
+  if (!_timeTraceFile.empty())
+    return _timeTraceFile;
+  return (_outputPath + ".time-trace").str();
+}
+
 std::error_code LinkingContext::writeFile(const File &linkedFile) const {
   return this->writer().writeFile(linkedFile, _outputPath);
 }
@@ -101,4 +116,23 @@ void LinkingContext::createInternalFiles(
 
 void LinkingContext::addPasses(PassManager &pm) {}
 
+void LinkingContext::prefetchInputFiles(const std::vector<std::string> &paths) {
+  _filePrefetcher.reset(new FilePrefetcher(paths));
+}
+
+ErrorOr<std::unique_ptr<MemoryBuffer>>
+LinkingContext::getInputFileBuffer(StringRef path) {
+  if (_filePrefetcher)
+    return _filePrefetcher->take(path);
+  return MemoryBuffer::getFileOrSTDIN(path);
+}
+
+std::error_code
+LinkingContext::identifyInputFile(StringRef path,
+                                  llvm::sys::fs::file_magic &magic) {
+  if (_filePrefetcher)
+    return _filePrefetcher->identify(path, magic);
+  return llvm::sys::fs::identify_magic(path, magic);
+}
+
 } // end namespace lld
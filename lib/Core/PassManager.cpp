@@ -0,0 +1,169 @@
+//===- lib/Core/PassManager.cpp - Manage linker passes --------------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "lld/Core/PassManager.h"
+#include "lld/Core/Instrumentation.h"
+#include "lld/Core/Parallel.h"
+#include "lld/Core/Simple.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+using namespace lld;
+
+namespace {
+
+/// A copy of the atom lists of the merged file, so that a pass can append
+/// atoms while other passes read the merged file.
+class Snapshot {
+public:
+  explicit Snapshot(const SimpleFile &merged)
+      : _file(new SimpleFile(merged.path())),
+        _numDefined(merged.defined().size()),
+        _numUndefined(merged.undefined().size()),
+        _numShared(merged.sharedLibrary().size()),
+        _numAbsolute(merged.absolute().size()) {
+    copyAtoms(merged.defined());
+    copyAtoms(merged.undefined());
+    copyAtoms(merged.sharedLibrary());
+    copyAtoms(merged.absolute());
+  }
+
+  std::unique_ptr<SimpleFile> &file() { return _file; }
+
+  /// Appends the atoms the pass added to the snapshot to \p merged.
+  void appendNewAtoms(SimpleFile &merged) const {
+    appendAtoms(merged, _file->defined(), _numDefined);
+    appendAtoms(merged, _file->undefined(), _numUndefined);
+    appendAtoms(merged, _file->sharedLibrary(), _numShared);
+    appendAtoms(merged, _file->absolute(), _numAbsolute);
+  }
+
+private:
+  template <typename T> void copyAtoms(const File::AtomVector<T> &atoms) {
+    for (const T *atom : atoms)
+      _file->addAtom(*atom);
+  }
+
+  template <typename T>
+  static void appendAtoms(SimpleFile &merged, const File::AtomVector<T> &atoms,
+                          size_t from) {
+    assert(atoms.size() >= from && "pass removed atoms from a snapshot");
+    for (size_t i = from, e = atoms.size(); i < e; ++i)
+      merged.addAtom(*atoms[i]);
+  }
+
+  std::unique_ptr<SimpleFile> _file;
+  size_t _numDefined;
+  size_t _numUndefined;
+  size_t _numShared;
+  size_t _numAbsolute;
+};
+
+} // end anonymous namespace
+
+/// Returns the resources \p pass touches. A pass that appends atoms relies on
+/// the existing atoms staying as they are.
+static unsigned getAccessed(const Pass &pass) {
+  unsigned accessed = pass.reads() | pass.writes();
+  if (pass.writes() & Pass::NewAtoms)
+    accessed |= Pass::AtomGraph;
+  return accessed;
+}
+
+/// Returns the writes of \p pass that no other pass may access at the same
+/// time. Appended atoms go to a snapshot, so they do not conflict.
+static unsigned getExclusive(const Pass &pass) {
+  return pass.writes() & ~Pass::NewAtoms;
+}
+
+/// Returns true if \p pass needs a snapshot to run concurrently. Only passes
+/// that append atoms do; the merged file does not change while a group runs,
+/// so passes that only read atoms use it directly.
+static bool needsSnapshot(const Pass &pass) {
+  return (pass.writes() & Pass::NewAtoms) &&
+         !(pass.writes() & Pass::AtomGraph);
+}
+
+static void runPass(Pass &pass, std::unique_ptr<SimpleFile> &file,
+                    PassManager::PassTiming &timing) {
+  ScopedTask task(getDefaultDomain(), pass.name());
+  auto start = std::chrono::steady_clock::now();
+  pass.perform(file);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  timing.name = pass.name();
+  timing.seconds = elapsed.count();
+}
+
+bool PassManager::canRunConcurrently(const Pass &a, const Pass &b) {
+  return !(getExclusive(a) & getAccessed(b)) &&
+         !(getExclusive(b) & getAccessed(a));
+}
+
+std::error_code PassManager::runOnFile(std::unique_ptr<SimpleFile> &file) {
+  _timings.clear();
+  _timings.resize(_passes.size());
+  for (unsigned begin = 0, e = _passes.size(); begin != e;) {
+    // Group the following passes as long as they can run concurrently with
+    // every pass already in the group.
+    unsigned end = begin + 1;
+    for (; end != e; ++end) {
+      auto conflicts = [&](const std::unique_ptr<Pass> &pass) {
+        return !canRunConcurrently(*pass, *_passes[end]);
+      };
+      if (std::any_of(_passes.begin() + begin, _passes.begin() + end,
+                      conflicts))
+        break;
+    }
+    if (end - begin == 1)
+      runPass(*_passes[begin], file, _timings[begin]);
+    else
+      runConcurrently(begin, end, file);
+    begin = end;
+  }
+  return std::error_code();
+}
+
+/// Runs the passes in [begin, end). The passes that only append atoms run on
+/// snapshots taken before any of them starts, and their atoms are appended to
+/// the merged file in pass order, as if the passes ran one by one. The other
+/// passes run on the merged file itself: a pass that rewrites the atom graph
+/// conflicts with every other pass touching atoms, and passes that only read
+/// atoms do not see any change until the group is done.
+void PassManager::runConcurrently(unsigned begin, unsigned end,
+                                  std::unique_ptr<SimpleFile> &file) {
+  std::vector<std::unique_ptr<Snapshot>> snapshots(end - begin);
+  for (unsigned i = begin; i != end; ++i)
+    if (needsSnapshot(*_passes[i]))
+      snapshots[i - begin] = llvm::make_unique<Snapshot>(*file);
+
+  auto run = [&](unsigned i) {
+    Snapshot *snapshot = snapshots[i - begin].get();
+    runPass(*_passes[i], snapshot ? snapshot->file() : file, _timings[i]);
+  };
+
+  // Run the last pass on this thread, like parallel_for_each does.
+  TaskGroup tg;
+  for (unsigned i = begin; i != end - 1; ++i)
+    tg.spawn([&run, i] { run(i); });
+  run(end - 1);
+  tg.sync();
+
+  for (const std::unique_ptr<Snapshot> &snapshot : snapshots)
+    if (snapshot)
+      snapshot->appendNewAtoms(*file);
+}
+
+void PassManager::printTimings(raw_ostream &os) const {
+  for (const PassTiming &timing : _timings)
+    os << "time in pass " << timing.name << " " << timing.seconds << "\n";
+}
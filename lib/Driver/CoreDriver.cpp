@@ -146,6 +146,14 @@ bool CoreDriver::parse(int argc, const char *argv[], CoreLinkingContext &ctx,
       ctx.addPassNamed(inputArg->getValue());
       break;
 
+    case OPT_time_trace:
+      ctx.setTimeTrace("");
+      break;
+
+    case OPT_time_trace_eq:
+      ctx.setTimeTrace(inputArg->getValue());
+      break;
+
     case OPT_INPUT: {
       std::vector<std::unique_ptr<File>> files
         = loadFile(ctx, inputArg->getValue(), false);
@@ -423,6 +423,12 @@ bool DarwinLdDriver::parse(int argc, const char *argv[],
   if (parsedArgs->getLastArg(OPT_dead_strip))
     ctx.setDeadStripping(true);
 
+  // Handle --time-trace and --time-trace=<file>
+  if (auto *arg = parsedArgs->getLastArg(OPT_time_trace, OPT_time_trace_eq))
+    ctx.setTimeTrace(arg->getOption().getID() == OPT_time_trace_eq
+                         ? arg->getValue()
+                         : "");
+
   // Handle -all_load
   if (parsedArgs->getLastArg(OPT_all_load))
     globalWholeArchive = true;
@@ -781,6 +787,15 @@ bool DarwinLdDriver::parse(int argc, const char *argv[],
     }
   }
 
+  // Start reading the input files given by path in the background. Libraries
+  // and frameworks are searched for in the loop below, which has side effects
+  // on the dependency info, so they are read when they are found.
+  std::vector<std::string> prefetchPaths;
+  for (auto arg : parsedArgs->filtered(OPT_INPUT, OPT_upward_library,
+                                       OPT_force_load))
+    prefetchPaths.push_back(arg->getValue());
+  ctx.prefetchInputFiles(prefetchPaths);
+
   // Handle input files
   for (auto &arg : *parsedArgs) {
     bool upward;
@@ -48,8 +48,7 @@ FileVector parseMemberFiles(std::unique_ptr<File> file) {
 }
 
 FileVector loadFile(LinkingContext &ctx, StringRef path, bool wholeArchive) {
-  ErrorOr<std::unique_ptr<MemoryBuffer>> mb
-      = MemoryBuffer::getFileOrSTDIN(path);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> mb = ctx.getInputFileBuffer(path);
   if (std::error_code ec = mb.getError())
     return makeErrorFile(path, ec);
   ErrorOr<std::unique_ptr<File>> fileOrErr =
@@ -64,6 +63,18 @@ FileVector loadFile(LinkingContext &ctx, StringRef path, bool wholeArchive) {
   return files;
 }
 
+/// Writes the trace recorded for --time-trace. Tasks that are still running
+/// are not included, so this is called after the tasks of the link end.
+static void writeTimeTrace(const LinkingContext &ctx,
+                           raw_ostream &diagnostics) {
+  if (!ctx.timeTrace())
+    return;
+  std::string path = ctx.timeTraceFile();
+  if (std::error_code ec = TimeTrace::write(path))
+    diagnostics << "Failed to write time trace '" << path
+                << "': " << ec.message() << "\n";
+}
+
 /// This is where the link is actually performed.
 bool Driver::link(LinkingContext &ctx, raw_ostream &diagnostics) {
   // Honor -mllvm
@@ -108,6 +119,8 @@ bool Driver::link(LinkingContext &ctx, raw_ostream &diagnostics) {
   Resolver resolver(ctx);
   if (!resolver.resolve()) {
     ctx.getTaskGroup().sync();
+    resolveTask.end();
+    writeTimeTrace(ctx, diagnostics);
     return false;
   }
   std::unique_ptr<SimpleFile> merged = resolver.resultFile();
@@ -119,15 +132,21 @@ bool Driver::link(LinkingContext &ctx, raw_ostream &diagnostics) {
   ctx.addPasses(pm);
   pm.runOnFile(merged);
   passTask.end();
+  if (ctx.collectStats())
+    pm.printTimings(diagnostics);
 
   // Give linked atoms to Writer to generate output file.
   ScopedTask writeTask(getDefaultDomain(), "Write");
   if (std::error_code ec = ctx.writeFile(*merged)) {
     diagnostics << "Failed to write file '" << ctx.outputPath()
                 << "': " << ec.message() << "\n";
+    writeTask.end();
+    writeTimeTrace(ctx, diagnostics);
     return false;
   }
+  writeTask.end();
 
+  writeTimeTrace(ctx, diagnostics);
   return true;
 }
 
@@ -13,6 +13,7 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include "lld/Core/FilePrefetcher.h"
 #include "lld/Driver/Driver.h"
 #include "lld/ReaderWriter/ELFLinkingContext.h"
 #include "lld/ReaderWriter/LinkerScript.h"
@@ -162,6 +163,12 @@ bool GnuLdDriver::linkELF(int argc, const char *argv[], raw_ostream &diag) {
     llvm::TimeRecord t = llvm::TimeRecord::getCurrentTime(true);
     diag << "total time in link " << t.getProcessTime() << "\n";
     diag << "data size " << t.getMemUsed() << "\n";
+    if (const FilePrefetcher *prefetcher = options->getFilePrefetcher()) {
+      diag << "input files prefetched " << prefetcher->numFiles() << "\n";
+      diag << "time reading input files " << prefetcher->readSeconds() << "\n";
+      diag << "time waiting for input files " << prefetcher->waitSeconds()
+           << "\n";
+    }
   }
   return linked;
 }
@@ -196,9 +203,10 @@ getArchType(const llvm::Triple &triple, StringRef value) {
   }
 }
 
-static bool isLinkerScript(StringRef path, raw_ostream &diag) {
+static bool isLinkerScript(ELFLinkingContext &ctx, StringRef path,
+                           raw_ostream &diag) {
   llvm::sys::fs::file_magic magic = llvm::sys::fs::file_magic::unknown;
-  if (std::error_code ec = llvm::sys::fs::identify_magic(path, magic)) {
+  if (std::error_code ec = ctx.identifyInputFile(path, magic)) {
     diag << "unknown input file format: " << path << ": "
          << ec.message() << "\n";
     return false;
@@ -440,6 +448,12 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
     ctx->setCollectStats(true);
   }
 
+  // Handle --time-trace and --time-trace=<file>.
+  if (auto *arg = parsedArgs->getLastArg(OPT_time_trace, OPT_time_trace_eq))
+    ctx->setTimeTrace(arg->getOption().getID() == OPT_time_trace_eq
+                          ? arg->getValue()
+                          : "");
+
   // Figure out if the output type is nmagic/omagic
   if (auto *arg = parsedArgs->getLastArg(
         OPT_nmagic, OPT_omagic, OPT_no_omagic)) {
@@ -641,10 +655,26 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
   if (ctx->allowLinkWithDynamicLibraries())
     ctx->registry().addSupportELFDynamicSharedObjects(*ctx);
 
+  // Find the input files and start reading them in the background, so that
+  // the reads overlap with each other and with the loop below. A linker
+  // script in the loop may add search paths, so -l options that follow it
+  // are searched for again.
+  std::vector<ErrorOr<StringRef>> inputPaths;
+  std::vector<std::string> prefetchPaths;
+  for (auto arg : parsedArgs->filtered(OPT_INPUT, OPT_l, OPT_T)) {
+    bool dashL = (arg->getOption().getID() == OPT_l);
+    inputPaths.push_back(findFile(*ctx, arg->getValue(), dashL));
+    if (inputPaths.back())
+      prefetchPaths.push_back(inputPaths.back().get());
+  }
+  ctx->prefetchInputFiles(prefetchPaths);
+  auto nextInputPath = inputPaths.begin();
+
   std::stack<int> groupStack;
   int numfiles = 0;
   bool asNeeded = false;
   bool wholeArchive = false;
+  bool scriptEvaluated = false;
 
   // Process files
   for (auto arg : *parsedArgs) {
@@ -684,10 +714,12 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
     case OPT_INPUT:
     case OPT_l:
     case OPT_T: {
-      bool dashL = (arg->getOption().getID() == OPT_l);
       StringRef path = arg->getValue();
 
-      ErrorOr<StringRef> pathOrErr = findFile(*ctx, path, dashL);
+      ErrorOr<StringRef> pathOrErr = *nextInputPath++;
+      bool dashL = (arg->getOption().getID() == OPT_l);
+      if (dashL && scriptEvaluated)
+        pathOrErr = findFile(*ctx, path, dashL);
       if (std::error_code ec = pathOrErr.getError()) {
         auto file = llvm::make_unique<ErrorFile>(path, ec);
         auto node = llvm::make_unique<FileNode>(std::move(file));
@@ -698,12 +730,12 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
       StringRef realpath = pathOrErr.get();
 
       bool isScript =
-          (!path.endswith(".objtxt") && isLinkerScript(realpath, diag));
+          (!path.endswith(".objtxt") && isLinkerScript(*ctx, realpath, diag));
       if (isScript) {
         if (ctx->logInputFiles())
           diag << path << "\n";
         ErrorOr<std::unique_ptr<MemoryBuffer>> mb =
-          MemoryBuffer::getFileOrSTDIN(realpath);
+          ctx->getInputFileBuffer(realpath);
         if (std::error_code ec = mb.getError()) {
           diag << "Cannot open " << path << ": " << ec.message() << "\n";
           return false;
@@ -711,6 +743,7 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
         bool nostdlib = parsedArgs->hasArg(OPT_nostdlib);
         std::error_code ec =
             evalLinkerScript(*ctx, std::move(mb.get()), diag, nostdlib);
+        scriptEvaluated = true;
         if (ec) {
           diag << path << ": Error parsing linker script: "
                << ec.message() << "\n";
@@ -755,7 +788,10 @@ bool GnuLdDriver::parse(int argc, const char *argv[],
     return false;
 
   // Perform linker script semantic actions
-  ctx->linkerScriptSema().perform();
+  if (std::error_code ec = ctx->linkerScriptSema().perform()) {
+    diag << "error: " << ec.message() << "\n";
+    return false;
+  }
 
   context.swap(ctx);
   return true;
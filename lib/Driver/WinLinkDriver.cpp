@@ -1211,6 +1211,16 @@ bool WinLinkDriver::parse(int argc, const char *argv[],
     ctx.setDynamicBaseEnabled(true);
   }
 
+  // /brepro makes the output a function of the inputs. Timestamps in the
+  // image are replaced with a hash of the image contents.
+  if (parsedArgs->hasArg(OPT_brepro))
+    ctx.setReproducible(true);
+
+  // /release sets the checksum in the PE header. Checksums are verified by
+  // the loader only for drivers and some system DLLs.
+  if (parsedArgs->hasArg(OPT_release))
+    ctx.setChecksumEnabled(true);
+
   for (auto *arg : parsedArgs->filtered(OPT_implib))
     ctx.setOutputImportLibraryPath(arg->getValue());
 
@@ -1246,6 +1256,11 @@ bool WinLinkDriver::parse(int argc, const char *argv[],
   if (auto *arg = parsedArgs->getLastArg(OPT_lldmoduledeffile))
     ctx.setModuleDefinitionFile(arg->getValue());
 
+  if (auto *arg = parsedArgs->getLastArg(OPT_timetrace, OPT_timetrace_file))
+    ctx.setTimeTrace(arg->getOption().matches(OPT_timetrace_file)
+                         ? ctx.allocate(arg->getValue())
+                         : StringRef());
+
   std::vector<StringRef> inputFiles;
   for (auto *arg : parsedArgs->filtered(OPT_INPUT))
     inputFiles.push_back(ctx.allocate(arg->getValue()));
@@ -21,6 +21,8 @@ namespace {
 
 class OrderPass : public Pass {
 public:
+  const char *name() const override { return "OrderPass"; }
+
   /// Sorts atoms by position
   void perform(std::unique_ptr<SimpleFile> &file) override {
     SimpleFile::DefinedAtomRange defined = file->definedAtoms();
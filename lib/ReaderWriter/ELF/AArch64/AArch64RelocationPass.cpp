@@ -233,6 +233,8 @@ protected:
   }
 
 public:
+  const char *name() const override { return "AArch64RelocationPass"; }
+
   AArch64RelocationPass(const ELFLinkingContext &ctx) : _file(ctx), _ctx(ctx) {}
 
   /// \brief Do the pass.
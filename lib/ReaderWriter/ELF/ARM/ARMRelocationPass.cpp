@@ -663,6 +663,8 @@ protected:
   }
 
 public:
+  const char *name() const override { return "ARMRelocationPass"; }
+
   ARMRelocationPass(const ELFLinkingContext &ctx) : _file(ctx), _ctx(ctx) {}
 
   /// \brief Do the pass.
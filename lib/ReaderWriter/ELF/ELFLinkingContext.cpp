@@ -114,8 +114,22 @@ static void buildSearchPath(SmallString<128> &path, StringRef dir,
   }
 }
 
+/// Lists the search directories in parallel before the first lookup in them.
+static void listSearchDirs(DirectoryCache &cache, ArrayRef<StringRef> dirs,
+                           StringRef sysRoot) {
+  std::vector<std::string> paths;
+  SmallString<128> path;
+  for (StringRef dir : dirs) {
+    buildSearchPath(path, dir, sysRoot);
+    paths.push_back(path.str());
+  }
+  cache.listDirectories(paths);
+}
+
 ErrorOr<StringRef> ELFLinkingContext::searchLibrary(StringRef libName) const {
   bool hasColonPrefix = libName[0] == ':';
+  DirectoryCache &cache = getDirectoryCache();
+  listSearchDirs(cache, _inputSearchPaths, _sysrootPath);
   SmallString<128> path;
   for (StringRef dir : _inputSearchPaths) {
     // Search for dynamic library
@@ -124,7 +138,7 @@ ErrorOr<StringRef> ELFLinkingContext::searchLibrary(StringRef libName) const {
       llvm::sys::path::append(path, hasColonPrefix
                                         ? libName.drop_front()
                                         : Twine("lib", libName) + ".so");
-      if (exists(path.str()))
+      if (cache.exists(path.str()))
         return path.str().copy(_allocator);
     }
     // Search for static libraries too
@@ -132,7 +146,7 @@ ErrorOr<StringRef> ELFLinkingContext::searchLibrary(StringRef libName) const {
     llvm::sys::path::append(path, hasColonPrefix
                                       ? libName.drop_front()
                                       : Twine("lib", libName) + ".a");
-    if (exists(path.str()))
+    if (cache.exists(path.str()))
       return path.str().copy(_allocator);
   }
   if (hasColonPrefix && exists(libName.drop_front()))
@@ -156,10 +170,12 @@ ErrorOr<StringRef> ELFLinkingContext::searchFile(StringRef fileName,
   if (is_absolute(fileName))
     return make_error_code(llvm::errc::no_such_file_or_directory);
 
+  DirectoryCache &cache = getDirectoryCache();
+  listSearchDirs(cache, _inputSearchPaths, _sysrootPath);
   for (StringRef dir : _inputSearchPaths) {
     buildSearchPath(path, dir, _sysrootPath);
     llvm::sys::path::append(path, fileName);
-    if (exists(path.str()))
+    if (cache.exists(path.str()))
       return path.str().copy(_allocator);
   }
   return make_error_code(llvm::errc::no_such_file_or_directory);
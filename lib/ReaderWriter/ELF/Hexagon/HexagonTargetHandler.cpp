@@ -159,6 +159,8 @@ protected:
   }
 
 public:
+  const char *name() const override { return "HexagonGOTPLTPass"; }
+
   GOTPLTPass(const ELFLinkingContext &ctx) : _file(ctx) {}
 
   /// \brief Do the pass.
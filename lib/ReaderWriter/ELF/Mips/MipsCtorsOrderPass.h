@@ -17,6 +17,8 @@ namespace elf {
 /// \brief This pass sorts atoms in .{ctors,dtors}.<priority> sections.
 class MipsCtorsOrderPass : public Pass {
 public:
+  const char *name() const override { return "MipsCtorsOrderPass"; }
+
   void perform(std::unique_ptr<SimpleFile> &mergedFile) override;
 };
 }
@@ -299,6 +299,8 @@ public:
 
 template <typename ELFT> class RelocationPass : public Pass {
 public:
+  const char *name() const override { return "MipsRelocationPass"; }
+
   RelocationPass(MipsLinkingContext &ctx);
 
   void perform(std::unique_ptr<SimpleFile> &mf) override;
@@ -19,6 +19,8 @@ namespace elf {
 /// \brief This pass sorts atoms by file and atom ordinals.
 class OrderPass : public Pass {
 public:
+  const char *name() const override { return "OrderPass"; }
+
   void perform(std::unique_ptr<SimpleFile> &file) override {
     parallel_sort(file->definedAtoms().begin(), file->definedAtoms().end(),
                   DefinedAtom::compareByPosition);
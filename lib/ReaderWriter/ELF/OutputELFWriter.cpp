@@ -359,6 +359,10 @@ std::error_code OutputELFWriter<ELFT>::buildOutput(const File &file) {
 
   _layout.assignVirtualAddress();
 
+  // Report output sections that do not fit in their memory regions
+  if (std::error_code ec = _ctx.linkerScriptSema().checkMemoryRegions())
+    return ec;
+
   // Finalize the default value of symbols that the linker adds
   finalizeDefaultAtomValues();
 
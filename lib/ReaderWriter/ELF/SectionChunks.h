@@ -90,6 +90,8 @@ public:
     _isFirstSectionInOutputSection = isFirst;
   }
 
+  OutputSection<ELFT> *getOutputSection() const { return _outputSection; }
+
   static bool classof(const Chunk<ELFT> *c) {
     return c->kind() == Chunk<ELFT>::Kind::ELFSection ||
            c->kind() == Chunk<ELFT>::Kind::AtomSection;
@@ -246,6 +248,13 @@ public:
   void setType(int64_t type) { _type = type; }
   range<SectionIter> sections() { return _sections; }
 
+  /// Sets the MEMORY regions given by ">region" and "AT>region".
+  void setMemoryRegions(script::Sema::MemoryRegion *region,
+                        script::Sema::MemoryRegion *lmaRegion) {
+    _memoryRegion = region;
+    _lmaMemoryRegion = lmaRegion;
+  }
+
   // The below functions returns the properties of the OutputSection.
   bool hasSegment() const { return _hasSegment; }
   StringRef name() const { return _name; }
@@ -261,6 +270,10 @@ public:
   uint64_t fileOffset() const { return _fileOffset; }
   uint64_t flags() const { return _flags; }
   uint64_t memSize() { return _memSize; }
+  script::Sema::MemoryRegion *memoryRegion() const { return _memoryRegion; }
+  script::Sema::MemoryRegion *lmaMemoryRegion() const {
+    return _lmaMemoryRegion;
+  }
 
 private:
   StringRef _name;
@@ -278,6 +291,8 @@ private:
   int64_t _kind = 0;
   int64_t _type = 0;
   bool _isLoadableSection = false;
+  script::Sema::MemoryRegion *_memoryRegion = nullptr;
+  script::Sema::MemoryRegion *_lmaMemoryRegion = nullptr;
   std::vector<Section<ELFT> *> _sections;
 };
 
@@ -9,6 +9,7 @@
 
 #include "SegmentChunks.h"
 #include "TargetLayout.h"
+#include <limits>
 
 namespace lld {
 namespace elf {
@@ -166,6 +167,26 @@ void Segment<ELFT>::assignFileOffsets(uint64_t startOffset) {
   this->setFileSize(fileOffset - startOffset);
 }
 
+/// Accounts for a section that has been assigned an address in the MEMORY
+/// regions of its output section. The section occupies its memory size in the
+/// region it runs from, and its file size in the region it is loaded from.
+template <class ELFT> static void allocateInMemoryRegions(Chunk<ELFT> *c) {
+  auto *section = dyn_cast<Section<ELFT>>(c);
+  if (!section || !section->getOutputSection() ||
+      section->order() == TargetLayout<ELFT>::ORDER_TBSS)
+    return;
+  OutputSection<ELFT> *os = section->getOutputSection();
+  script::Sema::MemoryRegion *region = os->memoryRegion();
+  script::Sema::MemoryRegion *lmaRegion = os->lmaMemoryRegion();
+  if (region)
+    region->allocate(section->virtualAddr() + section->memSize(), os->name());
+  if (lmaRegion && lmaRegion != region)
+    lmaRegion->allocate(llvm::RoundUpToAlignment(lmaRegion->cursor,
+                                                 section->alignment()) +
+                            section->fileSize(),
+                        os->name());
+}
+
 /// \brief Assign virtual addresses to the slices
 template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
   int startSection = 0;
@@ -188,6 +209,9 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
   uint64_t tlsStartAddr = 0;
   bool alignSegments = this->_ctx.alignSegments();
   StringRef prevOutputSectionName = StringRef();
+  // The lowest and highest addresses of the slices created so far.
+  uint64_t segStart = std::numeric_limits<uint64_t>::max();
+  uint64_t segEnd = 0;
 
   // If this is first section in the segment, page align the section start
   // address. The linker needs to align the data section to a page boundary
@@ -233,6 +257,7 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
     // end up using file size
     if ((*si)->order() != TargetLayout<ELFT>::ORDER_TBSS)
       curSliceSize = (*si)->memSize();
+    allocateInMemoryRegions(*si);
     ++currSection;
     ++si;
   }
@@ -257,8 +282,10 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
       curOutputSectionName = sec->outputSectionName();
     } else {
       // If this is a linker script expression, propagate the name of the
-      // previous section instead
-      if (isa<ExpressionChunk<ELFT>>(*si))
+      // previous section instead. A chunk that enters a memory region is
+      // named after the output section that follows it, so that the output
+      // section can start a new slice.
+      if (isa<ExpressionChunk<ELFT>>(*si) && (*si)->name().empty())
         curOutputSectionName = prevOutputSectionName;
       else
         curOutputSectionName = (*si)->name();
@@ -266,13 +293,18 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
     bool autoCreateSlice = true;
     if (curOutputSectionName == prevOutputSectionName)
       autoCreateSlice = false;
+    // A MEMORY region may move the address below the current slice. The
+    // chunks that follow need a slice of their own, whose base is the new
+    // address.
+    bool movesBack = newAddr < curAddr;
     // If the newAddress computed is more than a page away, let's create
     // a separate segment, so that memory is not used up while running.
     // Dont create a slice, if the new section falls in the same output
     // section as the previous section.
-    if (autoCreateSlice && ((newAddr - curAddr) > this->_ctx.getPageSize()) &&
-        (_outputMagic != ELFLinkingContext::OutputMagic::NMAGIC &&
-         _outputMagic != ELFLinkingContext::OutputMagic::OMAGIC)) {
+    if (movesBack ||
+        (autoCreateSlice && ((newAddr - curAddr) > this->_ctx.getPageSize()) &&
+         (_outputMagic != ELFLinkingContext::OutputMagic::NMAGIC &&
+          _outputMagic != ELFLinkingContext::OutputMagic::OMAGIC))) {
       auto sliceIter =
           std::find_if(_segmentSlices.begin(), _segmentSlices.end(),
                        [startSection](SegmentSlice<ELFT> *s) -> bool {
@@ -290,6 +322,8 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
       slice->setMemSize(curSliceSize);
       slice->setAlign(sliceAlign);
       slice->setVirtualAddr(curSliceAddress);
+      segStart = std::min(segStart, curSliceAddress);
+      segEnd = std::max(segEnd, curSliceAddress + curSliceSize);
       // Start new slice
       curSliceAddress = newAddr;
       (*si)->setVirtualAddr(curSliceAddress);
@@ -323,6 +357,7 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
       else
         curSliceSize = newAddr - curSliceAddress;
     }
+    allocateInMemoryRegions(*si);
     prevOutputSectionName = curOutputSectionName;
     ++currSection;
   }
@@ -345,9 +380,13 @@ template <class ELFT> void Segment<ELFT>::assignVirtualAddress(uint64_t addr) {
   slice->setSections(make_range(startSectionIter, _sections.end()));
   slice->setAlign(sliceAlign);
 
-  // Set the segment memory size and the virtual address.
-  this->setMemSize(curSliceAddress - startAddr + curSliceSize);
-  this->setVirtualAddr(curSliceAddress);
+  // Set the segment memory size and the virtual address. The segment spans
+  // all of its slices, which need not be in address order if a MEMORY
+  // region moved the address backwards.
+  segStart = std::min(segStart, curSliceAddress);
+  segEnd = std::max(segEnd, curSliceAddress + curSliceSize);
+  this->setMemSize(segEnd - segStart);
+  this->setVirtualAddr(segStart);
   std::stable_sort(_segmentSlices.begin(), _segmentSlices.end(),
                    SegmentSlice<ELFT>::compare_slices);
 }
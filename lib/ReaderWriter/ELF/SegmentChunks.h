@@ -201,6 +201,16 @@ public:
     this->_alignment = 1;
   }
 
+  /// Creates a chunk that moves the location counter to the next free address
+  /// of a MEMORY region, just before the contents of an output section that
+  /// is placed in the region.
+  ExpressionChunk(ELFLinkingContext &ctx, script::Sema::MemoryRegion *region,
+                  StringRef outputSectionName)
+      : Chunk<ELFT>(outputSectionName, Chunk<ELFT>::Kind::Expression, ctx),
+        _region(region), _linkerScriptSema(ctx.linkerScriptSema()) {
+    this->_alignment = 1;
+  }
+
   static bool classof(const Chunk<ELFT> *c) {
     return c->kind() == Chunk<ELFT>::Kind::Expression;
   }
@@ -213,11 +223,16 @@ public:
              llvm::FileOutputBuffer &) override {}
 
   std::error_code evalExpr(uint64_t &curPos) {
+    if (_region) {
+      curPos = _region->cursor;
+      return std::error_code();
+    }
     return _linkerScriptSema.evalExpr(_expr, curPos);
   }
 
 private:
-  const script::SymbolAssignment *_expr;
+  const script::SymbolAssignment *_expr = nullptr;
+  script::Sema::MemoryRegion *_region = nullptr;
   script::Sema &_linkerScriptSema;
 };
 
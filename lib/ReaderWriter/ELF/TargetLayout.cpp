@@ -8,9 +8,12 @@
 //===----------------------------------------------------------------------===//
 
 #include "TargetLayout.h"
+#include "lld/Core/Parallel.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/Errc.h"
+#include <climits>
 
 namespace lld {
 namespace elf {
@@ -364,6 +367,13 @@ template <class ELFT> void TargetLayout<ELFT>::assignSectionsToSegments() {
     ++ordinal;
   }
   for (auto osi : _outputSections) {
+    // Output sections placed in a MEMORY region start at the next free
+    // address of the region.
+    script::Sema::MemoryRegion *region =
+        _linkerScriptSema.getMemoryRegion(osi->name());
+    osi->setMemoryRegions(region,
+                          _linkerScriptSema.getLMAMemoryRegion(osi->name()));
+    bool enterRegion = region != nullptr;
     for (auto section : osi->sections()) {
       if (!hasOutputSegment(section))
         continue;
@@ -427,7 +437,9 @@ template <class ELFT> void TargetLayout<ELFT>::assignSectionsToSegments() {
       // point, just before appending a new input section
       addExtraChunksToSegment(segment, section->archivePath(),
                               section->memberPath(),
-                              section->inputSectionName());
+                              section->inputSectionName(),
+                              enterRegion ? osi : nullptr);
+      enterRegion = false;
       segment->append(section);
     }
   }
@@ -466,6 +478,9 @@ template <class ELFT> void TargetLayout<ELFT>::assignVirtualAddress() {
   bool newSegmentHeaderAdded = true;
   bool virtualAddressAssigned = false;
   bool fileOffsetAssigned = false;
+  // Memory region cursors are rebuilt on each pass, so every segment has to
+  // be visited again when there are regions.
+  bool hasMemoryRegions = _linkerScriptSema.hasMemoryRegions();
   while (true) {
     for (auto si : _segments) {
       si->finalize();
@@ -475,6 +490,7 @@ template <class ELFT> void TargetLayout<ELFT>::assignVirtualAddress() {
     }
     if (!newSegmentHeaderAdded && virtualAddressAssigned)
       break;
+    _linkerScriptSema.resetMemoryRegions();
     uint64_t address = baseAddress;
     // start assigning virtual addresses
     for (auto &si : _segments) {
@@ -485,8 +501,8 @@ template <class ELFT> void TargetLayout<ELFT>::assignVirtualAddress() {
       if (si->segmentType() == llvm::ELF::PT_NULL) {
         si->assignVirtualAddress(0 /*non loadable*/);
       } else {
-        if (virtualAddressAssigned && (address != baseAddress) &&
-            (address == si->virtualAddr()))
+        if (virtualAddressAssigned && !hasMemoryRegions &&
+            (address != baseAddress) && (address == si->virtualAddr()))
           break;
         si->assignVirtualAddress(address);
       }
@@ -587,55 +603,83 @@ template <class ELFT> void TargetLayout<ELFT>::sortInputSections() {
   if (!_linkerScriptSema.hasLayoutCommands())
     return;
 
-  // Sort the sections by their order as defined by the linker script
-  std::stable_sort(
-      this->_sections.begin(), this->_sections.end(),
-      [this](Chunk<ELFT> *A, Chunk<ELFT> *B) {
-        auto *a = dyn_cast<Section<ELFT>>(A);
-        auto *b = dyn_cast<Section<ELFT>>(B);
-
-        if (a == nullptr)
-          return false;
-        if (b == nullptr)
-          return true;
-
-        return _linkerScriptSema.less(
-            {a->archivePath(), a->memberPath(), a->inputSectionName()},
-            {b->archivePath(), b->memberPath(), b->inputSectionName()});
-      });
+  // Sort the sections by their order as defined by the linker script. The
+  // sort key of each section is computed once, in parallel. Chunks that are
+  // not sections go last. Ties are broken by the current position, so the
+  // sort is stable.
+  struct SortEntry {
+    bool isSection;
+    script::Sema::SectionOrderKey key;
+    size_t index;
+    unsigned archiveOrdinal;
+    unsigned fileOrdinal;
+  };
+  std::vector<SortEntry> entries(_sections.size());
+
+  // Number the archives and files in the order they first appear, so that
+  // rules that do not sort files keep them in input order.
+  llvm::StringMap<unsigned> archiveOrdinals;
+  llvm::StringMap<unsigned> fileOrdinals;
+  SmallString<128> fileName;
+  for (size_t i = 0, e = _sections.size(); i < e; ++i) {
+    auto *sec = dyn_cast<Section<ELFT>>(_sections[i]);
+    if (!sec)
+      continue;
+    entries[i].archiveOrdinal =
+        archiveOrdinals.insert(std::make_pair(sec->archivePath(),
+                                              archiveOrdinals.size()))
+            .first->second;
+    fileName = sec->archivePath();
+    fileName.push_back('(');
+    fileName.append(sec->memberPath());
+    fileName.push_back(')');
+    entries[i].fileOrdinal =
+        fileOrdinals.insert(std::make_pair(fileName.str(),
+                                           fileOrdinals.size()))
+            .first->second;
+  }
+
+  parallel_for_each(entries.begin(), entries.end(), [&](SortEntry &e) {
+    e.index = &e - &entries[0];
+    auto *sec = dyn_cast<Section<ELFT>>(_sections[e.index]);
+    e.isSection = sec != nullptr;
+    if (sec)
+      e.key = _linkerScriptSema.getOrderKey(
+          {sec->archivePath(), sec->memberPath(), sec->inputSectionName(),
+           sec->alignment()},
+          e.archiveOrdinal, e.fileOrdinal);
+  });
+  parallel_sort(entries.begin(), entries.end(),
+                [](const SortEntry &a, const SortEntry &b) {
+    if (a.isSection != b.isSection)
+      return a.isSection;
+    if (a.isSection) {
+      if (a.key < b.key)
+        return true;
+      if (b.key < a.key)
+        return false;
+    }
+    return a.index < b.index;
+  });
+  std::vector<Chunk<ELFT> *> sorted(_sections.size());
+  for (size_t i = 0, e = entries.size(); i < e; ++i)
+    sorted[i] = _sections[entries[i].index];
+  _sections.swap(sorted);
+
   // Now try to arrange sections with no mapping rules to sections with
   // similar content
-  auto p = this->_sections.begin();
+  size_t first = 0;
   // Find first section that has no assigned rule id
-  while (p != this->_sections.end()) {
-    auto *sect = dyn_cast<AtomSection<ELFT>>(*p);
-    if (!sect)
-      break;
-
-    if (!_linkerScriptSema.hasMapping({sect->archivePath(), sect->memberPath(),
-                                       sect->inputSectionName()}))
+  for (const SortEntry &e : entries) {
+    if (!isa<AtomSection<ELFT>>(_sections[first]) || e.key.order == INT_MAX)
       break;
-
-    ++p;
+    ++first;
   }
   // For all sections that have no assigned rule id, try to move them near a
   // section with similar contents
-  if (p != this->_sections.begin()) {
-    for (; p != this->_sections.end(); ++p) {
-      auto q = p;
-      --q;
-      while (q != this->_sections.begin() &&
-             (*q)->getContentType() != (*p)->getContentType())
-        --q;
-      if ((*q)->getContentType() != (*p)->getContentType())
-        continue;
-      ++q;
-      for (auto i = p; i != q;) {
-        auto next = i--;
-        std::iter_swap(i, next);
-      }
-    }
-  }
+  groupByKey(_sections, first, [](const Chunk<ELFT> *c) {
+    return c->getContentType();
+  });
 }
 
 template <class ELFT>
@@ -649,19 +693,34 @@ TargetLayout<ELFT>::findAtomLayoutByName(StringRef name) const {
 }
 
 template <class ELFT>
-void TargetLayout<ELFT>::addExtraChunksToSegment(Segment<ELFT> *segment,
-                                                 StringRef archivePath,
-                                                 StringRef memberPath,
-                                                 StringRef sectionName) {
+void TargetLayout<ELFT>::addExtraChunksToSegment(
+    Segment<ELFT> *segment, StringRef archivePath, StringRef memberPath,
+    StringRef sectionName, OutputSection<ELFT> *regionSection) {
   if (!_linkerScriptSema.hasLayoutCommands())
     return;
-  std::vector<const script::SymbolAssignment *> exprs =
+  ArrayRef<const script::SymbolAssignment *> exprs =
       _linkerScriptSema.getExprs({archivePath, memberPath, sectionName});
+
+  // Assignments that precede the output section are evaluated before moving
+  // to its memory region, and the ones inside of it after, so that symbols
+  // such as "_sdata = .;" get addresses in the region.
+  auto enterRegion = [&]() {
+    if (!regionSection)
+      return;
+    segment->append(new (this->_allocator) ExpressionChunk<ELFT>(
+        this->_ctx, regionSection->memoryRegion(), regionSection->name()));
+    regionSection = nullptr;
+  };
   for (auto expr : exprs) {
+    if (regionSection &&
+        _linkerScriptSema.getEnclosingOutputSection(expr) ==
+            regionSection->name())
+      enterRegion();
     auto expChunk =
         new (this->_allocator) ExpressionChunk<ELFT>(this->_ctx, expr);
     segment->append(expChunk);
   }
+  enterRegion();
 }
 
 template <class ELFT>
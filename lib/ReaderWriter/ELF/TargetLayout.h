@@ -14,6 +14,7 @@
 #include "HeaderChunks.h"
 #include "SectionChunks.h"
 #include "SegmentChunks.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
@@ -22,6 +23,51 @@
 namespace lld {
 namespace elf {
 
+/// \brief Moves each element of \p v at or after index \p first right after
+/// the last element before it that has the same key, one element at a time
+/// in order. Elements whose key does not appear before them stay in place.
+///
+/// As a result, the elements from \p first with a key that appears before
+/// \p first follow the last such element, and the other ones are gathered
+/// at the first element with the same key. The relative order of elements
+/// with the same key is preserved. This takes linear time.
+template <class T, class KeyFn>
+void groupByKey(std::vector<T> &v, size_t first, KeyFn getKey) {
+  if (first == 0 || first >= v.size())
+    return;
+
+  // Bucket the elements by key, and find the last element of each key
+  // before the first one to move.
+  llvm::DenseMap<int, std::vector<T>> buckets;
+  for (size_t i = first, e = v.size(); i < e; ++i)
+    buckets[getKey(v[i])].push_back(v[i]);
+  llvm::DenseMap<int, size_t> last;
+  for (size_t i = 0; i < first; ++i)
+    last[getKey(v[i])] = i;
+
+  std::vector<T> result;
+  result.reserve(v.size());
+  for (size_t i = 0; i < first; ++i) {
+    result.push_back(v[i]);
+    int key = getKey(v[i]);
+    if (last[key] != i)
+      continue;
+    auto it = buckets.find(key);
+    if (it == buckets.end())
+      continue;
+    result.insert(result.end(), it->second.begin(), it->second.end());
+    buckets.erase(it);
+  }
+  for (size_t i = first, e = v.size(); i < e; ++i) {
+    auto it = buckets.find(getKey(v[i]));
+    if (it == buckets.end())
+      continue;
+    result.insert(result.end(), it->second.begin(), it->second.end());
+    buckets.erase(it);
+  }
+  v.swap(result);
+}
+
 /// \brief The TargetLayout class is used by the Writer to arrange
 ///        sections and segments in the order determined by the target ELF
 ///        format. The writer creates a single instance of the TargetLayout
@@ -215,11 +261,15 @@ public:
 
   /// \brief Add extra chunks to a segment just before including the input
   /// section given by <archivePath, memberPath, sectionName>. This
-  /// is used to add linker script expressions before each section.
+  /// is used to add linker script expressions before each section. If
+  /// \p regionSection is not null, the section is the first one of that
+  /// output section, and a chunk that moves to the output section's memory
+  /// region is added too.
   virtual void addExtraChunksToSegment(Segment<ELFT> *segment,
                                        StringRef archivePath,
                                        StringRef memberPath,
-                                       StringRef sectionName);
+                                       StringRef sectionName,
+                                       OutputSection<ELFT> *regionSection);
 
   /// \brief associates a section to a segment
   virtual void assignSectionsToSegments();
@@ -243,6 +243,8 @@ protected:
   }
 
 public:
+  const char *name() const override { return "X86_64RelocationPass"; }
+
   RelocationPass(const ELFLinkingContext &ctx) : _file(ctx), _ctx(ctx) {}
 
   /// \brief Do the pass.
@@ -69,6 +69,8 @@ public:
       }
     }
 
+    if (_logLoading)
+      logMember(ci);
     std::unique_ptr<File> result;
     if (instantiateMember(ci, result))
       return nullptr;
@@ -94,6 +96,8 @@ public:
       return;
 
     // Instantiate the member
+    if (_logLoading)
+      logMember(ci);
     auto *future = new Future<File *>();
     _preloaded[memberStart] = std::unique_ptr<Future<File *>>(future);
 
@@ -105,16 +109,33 @@ public:
   }
 
   /// \brief parse each member
+  ///
+  /// Members are instantiated in parallel. Each task fills its own slot, so
+  /// the members are returned in archive order, and if more than one member
+  /// is broken, the error of the first one is returned.
   std::error_code
   parseAllMembers(std::vector<std::unique_ptr<File>> &result) override {
     if (std::error_code ec = parse())
       return ec;
+    std::vector<Archive::child_iterator> members;
     for (auto mf = _archive->child_begin(), me = _archive->child_end();
-         mf != me; ++mf) {
-      std::unique_ptr<File> file;
-      if (std::error_code ec = instantiateMember(mf, file))
-        return ec;
-      result.push_back(std::move(file));
+         mf != me; ++mf)
+      members.push_back(mf);
+
+    std::vector<std::unique_ptr<File>> files(members.size());
+    std::vector<std::error_code> errors(members.size());
+    TaskGroup tg;
+    for (size_t i = 0, e = members.size(); i != e; ++i)
+      tg.spawn([&, i] { errors[i] = instantiateMember(members[i], files[i]); });
+    tg.sync();
+
+    // Log and return the members as if they were parsed one by one.
+    for (size_t i = 0, e = members.size(); i != e; ++i) {
+      if (_logLoading)
+        logMember(members[i]);
+      if (errors[i])
+        return errors[i];
+      result.push_back(std::move(files[i]));
     }
     return std::error_code();
   }
@@ -164,12 +185,6 @@ private:
     if (std::error_code ec = mbOrErr.getError())
       return ec;
     llvm::MemoryBufferRef mb = mbOrErr.get();
-    std::string memberPath = (_archive->getFileName() + "("
-                           + mb.getBufferIdentifier() + ")").str();
-
-    if (_logLoading)
-      llvm::errs() << memberPath << "\n";
-
     std::unique_ptr<MemoryBuffer> memberMB(MemoryBuffer::getMemBuffer(
         mb.getBuffer(), mb.getBufferIdentifier(), false));
 
@@ -188,6 +203,16 @@ private:
     return std::error_code();
   }
 
+  // Prints the path of a member for -t. Members whose buffer cannot be read
+  // are not printed; instantiateMember reports the error.
+  void logMember(Archive::child_iterator member) const {
+    ErrorOr<llvm::MemoryBufferRef> mbOrErr = member->getMemoryBufferRef();
+    if (mbOrErr.getError())
+      return;
+    llvm::errs() << _archive->getFileName() << "("
+                 << mbOrErr.get().getBufferIdentifier() << ")\n";
+  }
+
   // Parses the given memory buffer as an object file, and returns true
   // code if the given symbol is a data symbol. If the symbol is not a data
   // symbol or does not exist, returns false.
@@ -13,6 +13,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "lld/ReaderWriter/LinkerScript.h"
+#include <climits>
+#include <cstdint>
 
 namespace lld {
 namespace script {
@@ -241,23 +243,147 @@ static llvm::ErrorOr<uint64_t> parseNum(StringRef str) {
   return res;
 }
 
+namespace {
+/// Character classes of the lexer.
+enum CharClass : uint8_t {
+  // [A-Za-z_.$/\\*]
+  StartName = 1 << 0,
+  // [A-Za-z0-9_.$/\\~=+\[\]*?-:]
+  ContinueName = 1 << 1,
+  // [0-9]
+  StartNumber = 1 << 2,
+  // [0-9A-Fa-f], [xX] = hex marker, [hHoO] = type suffix, [MK] = scale
+  // suffix.
+  ContinueNumber = 1 << 3,
+  // [ \t\r\n]
+  Whitespace = 1 << 4
+};
+
+// Abbreviations for the table below.
+const uint8_t W = Whitespace;
+const uint8_t C = ContinueName;
+const uint8_t L = StartName | ContinueName;
+const uint8_t H = StartName | ContinueName | ContinueNumber;
+const uint8_t D = ContinueName | StartNumber | ContinueNumber;
+} // end anonymous namespace
+
+/// The character classes of each character. Characters outside the ASCII
+/// range are in no class.
+static const uint8_t charClasses[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, W, W, 0, 0, W, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    W, 0, 0, 0, L, 0, 0, 0, 0, 0, L, C, 0, C, L, L, //  !"#$%&'()*+,-./
+    D, D, D, D, D, D, D, D, D, D, C, 0, 0, C, 0, C, // 0123456789:;<=>?
+    0, H, H, H, H, H, H, L, H, L, L, H, L, H, L, H, // @ABCDEFGHIJKLMNO
+    L, L, L, L, L, L, L, L, H, L, L, C, L, C, 0, L, // PQRSTUVWXYZ[\]^_
+    0, H, H, H, H, H, H, L, H, L, L, L, L, L, L, H, // `abcdefghijklmno
+    L, L, L, L, L, L, L, L, H, L, L, 0, 0, 0, C, 0, // pqrstuvwxyz{|}~
+};
+
+static bool hasCharClass(char c, uint8_t charClass) {
+  return charClasses[static_cast<uint8_t>(c)] & charClass;
+}
+
 bool Lexer::canStartNumber(char c) const {
-  return '0' <= c && c <= '9';
+  return hasCharClass(c, StartNumber);
 }
 
 bool Lexer::canContinueNumber(char c) const {
-  // [xX] = hex marker, [hHoO] = type suffix, [MK] = scale suffix.
-  return strchr("0123456789ABCDEFabcdefxXhHoOMK", c);
+  return hasCharClass(c, ContinueNumber);
 }
 
 bool Lexer::canStartName(char c) const {
-  return strchr(
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_.$/\\*", c);
+  return hasCharClass(c, StartName);
 }
 
 bool Lexer::canContinueName(char c) const {
-  return strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
-                "0123456789_.$/\\~=+[]*?-:", c);
+  return hasCharClass(c, ContinueName);
+}
+
+namespace {
+struct Keyword {
+  const char *name;
+  Token::Kind kind;
+};
+} // end anonymous namespace
+
+static const Keyword keywords[] = {
+    {"ALIGN", Token::kw_align},
+    {"ALIGN_WITH_INPUT", Token::kw_align_with_input},
+    {"AS_NEEDED", Token::kw_as_needed},
+    {"AT", Token::kw_at},
+    {"ENTRY", Token::kw_entry},
+    {"EXCLUDE_FILE", Token::kw_exclude_file},
+    {"EXTERN", Token::kw_extern},
+    {"GROUP", Token::kw_group},
+    {"HIDDEN", Token::kw_hidden},
+    {"INPUT", Token::kw_input},
+    {"KEEP", Token::kw_keep},
+    {"LENGTH", Token::kw_length},
+    {"l", Token::kw_length},
+    {"len", Token::kw_length},
+    {"MEMORY", Token::kw_memory},
+    {"ONLY_IF_RO", Token::kw_only_if_ro},
+    {"ONLY_IF_RW", Token::kw_only_if_rw},
+    {"ORIGIN", Token::kw_origin},
+    {"o", Token::kw_origin},
+    {"org", Token::kw_origin},
+    {"OUTPUT", Token::kw_output},
+    {"OUTPUT_ARCH", Token::kw_output_arch},
+    {"OUTPUT_FORMAT", Token::kw_output_format},
+    {"OVERLAY", Token::kw_overlay},
+    {"PROVIDE", Token::kw_provide},
+    {"PROVIDE_HIDDEN", Token::kw_provide_hidden},
+    {"SEARCH_DIR", Token::kw_search_dir},
+    {"SECTIONS", Token::kw_sections},
+    {"SORT", Token::kw_sort_by_name},
+    {"SORT_BY_ALIGNMENT", Token::kw_sort_by_alignment},
+    {"SORT_BY_INIT_PRIORITY", Token::kw_sort_by_init_priority},
+    {"SORT_BY_NAME", Token::kw_sort_by_name},
+    {"SORT_NONE", Token::kw_sort_none},
+    {"SUBALIGN", Token::kw_subalign},
+    {"/DISCARD/", Token::kw_discard},
+};
+
+static const unsigned keywordTableSize = 128;
+
+/// A perfect hash function for the keywords: no two keywords hash to the
+/// same value. If a new keyword collides, the assertion in KeywordTable
+/// fires, and the coefficients need to be changed.
+static unsigned hashKeyword(StringRef word) {
+  unsigned last = static_cast<uint8_t>(word.back());
+  unsigned middle = static_cast<uint8_t>(word[word.size() / 2]);
+  return (word.size() + 6 * last + 3 * middle) % keywordTableSize;
+}
+
+namespace {
+/// The keywords indexed by their hash values.
+struct KeywordTable {
+  KeywordTable() : slots() {
+    for (const Keyword &kw : keywords) {
+      Slot &slot = slots[hashKeyword(kw.name)];
+      assert(slot.name.empty() && "Keyword hash collision");
+      slot.name = kw.name;
+      slot.kind = kw.kind;
+    }
+  }
+
+  struct Slot {
+    StringRef name;
+    Token::Kind kind;
+  };
+  Slot slots[keywordTableSize];
+};
+} // end anonymous namespace
+
+/// Returns the kind of a name token. Names that are not keywords are
+/// identifiers.
+static Token::Kind getNameKind(StringRef word) {
+  static const KeywordTable table;
+  const KeywordTable::Slot &slot = table.slots[hashKeyword(word)];
+  if (slot.name == word)
+    return slot.kind;
+  return Token::identifier;
 }
 
 /// Helper function to split a StringRef in two at the nth character.
@@ -269,7 +395,21 @@ static StringRef drop(StringRef &s, int n) {
   return res;
 }
 
-void Lexer::lex(Token &tok) {
+void Lexer::fillTokenBuffer() {
+  // The parser stops at the end of file or at the first unknown token, so
+  // the batch ends there too.
+  const size_t batchSize = 256;
+  _tokens.clear();
+  _nextToken = 0;
+  Token tok;
+  do {
+    lexToken(tok);
+    _tokens.push_back(tok);
+  } while (tok._kind != Token::eof && tok._kind != Token::unknown &&
+           _tokens.size() < batchSize);
+}
+
+void Lexer::lexToken(Token &tok) {
   skipWhitespace();
   if (_buffer.empty()) {
     tok = Token(_buffer, Token::eof);
@@ -460,44 +600,7 @@ void Lexer::lex(Token &tok) {
     if (end == StringRef::npos || end == 0)
       break;
     StringRef word = _buffer.substr(0, end);
-    Token::Kind kind =
-        llvm::StringSwitch<Token::Kind>(word)
-            .Case("ALIGN", Token::kw_align)
-            .Case("ALIGN_WITH_INPUT", Token::kw_align_with_input)
-            .Case("AS_NEEDED", Token::kw_as_needed)
-            .Case("AT", Token::kw_at)
-            .Case("ENTRY", Token::kw_entry)
-            .Case("EXCLUDE_FILE", Token::kw_exclude_file)
-            .Case("EXTERN", Token::kw_extern)
-            .Case("GROUP", Token::kw_group)
-            .Case("HIDDEN", Token::kw_hidden)
-            .Case("INPUT", Token::kw_input)
-            .Case("KEEP", Token::kw_keep)
-            .Case("LENGTH", Token::kw_length)
-            .Case("l", Token::kw_length)
-            .Case("len", Token::kw_length)
-            .Case("MEMORY", Token::kw_memory)
-            .Case("ONLY_IF_RO", Token::kw_only_if_ro)
-            .Case("ONLY_IF_RW", Token::kw_only_if_rw)
-            .Case("ORIGIN", Token::kw_origin)
-            .Case("o", Token::kw_origin)
-            .Case("org", Token::kw_origin)
-            .Case("OUTPUT", Token::kw_output)
-            .Case("OUTPUT_ARCH", Token::kw_output_arch)
-            .Case("OUTPUT_FORMAT", Token::kw_output_format)
-            .Case("OVERLAY", Token::kw_overlay)
-            .Case("PROVIDE", Token::kw_provide)
-            .Case("PROVIDE_HIDDEN", Token::kw_provide_hidden)
-            .Case("SEARCH_DIR", Token::kw_search_dir)
-            .Case("SECTIONS", Token::kw_sections)
-            .Case("SORT", Token::kw_sort_by_name)
-            .Case("SORT_BY_ALIGNMENT", Token::kw_sort_by_alignment)
-            .Case("SORT_BY_INIT_PRIORITY", Token::kw_sort_by_init_priority)
-            .Case("SORT_BY_NAME", Token::kw_sort_by_name)
-            .Case("SORT_NONE", Token::kw_sort_none)
-            .Case("SUBALIGN", Token::kw_subalign)
-            .Case("/DISCARD/", Token::kw_discard)
-            .Default(Token::identifier);
+    Token::Kind kind = getNameKind(word);
     tok = Token(word, kind);
     _buffer = _buffer.drop_front(end);
     return;
@@ -509,15 +612,16 @@ void Lexer::skipWhitespace() {
   while (true) {
     if (_buffer.empty())
       return;
+    if (hasCharClass(_buffer[0], Whitespace)) {
+      size_t end = 1;
+      while (end < _buffer.size() && hasCharClass(_buffer[end], Whitespace))
+        ++end;
+      _buffer = _buffer.drop_front(end);
+      continue;
+    }
     switch (_buffer[0]) {
-    case ' ':
-    case '\r':
-    case '\n':
-    case '\t':
-      _buffer = _buffer.drop_front();
-      break;
     // Potential comment.
-    case '/':
+    case '/': {
       if (_buffer.size() <= 1 || _buffer[1] != '*')
         return;
       // Skip starting /*
@@ -526,15 +630,15 @@ void Lexer::skipWhitespace() {
       if (!_buffer.empty() && _buffer[0] == '/')
         _buffer = _buffer.drop_front();
 
-      // Scan for /'s. We're done if it is preceded by a *.
-      while (true) {
-        if (_buffer.empty())
-          break;
-        _buffer = _buffer.drop_front();
-        if (_buffer.data()[-1] == '/' && _buffer.data()[-2] == '*')
-          break;
-      }
+      // Skip to the end of the comment, or to the end of the buffer if the
+      // comment is not terminated.
+      size_t end = _buffer.find("*/");
+      if (end == StringRef::npos)
+        _buffer = _buffer.drop_front(_buffer.size());
+      else
+        _buffer = _buffer.drop_front(end + 2);
       break;
+    }
     default:
       return;
     }
@@ -584,22 +688,27 @@ void Unary::dump(raw_ostream &os) const {
   os << ")";
 }
 
-ErrorOr<int64_t> Unary::evalExpr(SymbolTableTy &symbolTable) const {
-  auto child = _child->evalExpr(symbolTable);
-  if (child.getError())
-    return child.getError();
-
-  int64_t childRes = *child;
-  switch (_op) {
+// Negation, addition, subtraction, multiplication and left shifts are done
+// in uint64_t, so that they wrap around like address arithmetic in GNU ld
+// instead of overflowing.
+static int64_t applyUnary(Unary::Operation op, int64_t child) {
+  switch (op) {
   case Unary::Minus:
-    return -childRes;
+    return -uint64_t(child);
   case Unary::Not:
-    return ~childRes;
+    return ~child;
   }
 
   llvm_unreachable("");
 }
 
+ErrorOr<int64_t> Unary::evalExpr(SymbolTableTy &symbolTable) const {
+  auto child = _child->evalExpr(symbolTable);
+  if (child.getError())
+    return child.getError();
+  return applyUnary(_op, *child);
+}
+
 // BinOp functions
 void BinOp::dump(raw_ostream &os) const {
   os << "(";
@@ -654,6 +763,27 @@ void BinOp::dump(raw_ostream &os) const {
   os << ")";
 }
 
+static int64_t applyBinOp(BinOp::Operation op, int64_t lhs, int64_t rhs) {
+  switch(op) {
+  case BinOp::And:                 return lhs & rhs;
+  case BinOp::CompareDifferent:    return lhs != rhs;
+  case BinOp::CompareEqual:        return lhs == rhs;
+  case BinOp::CompareGreater:      return lhs > rhs;
+  case BinOp::CompareGreaterEqual: return lhs >= rhs;
+  case BinOp::CompareLess:         return lhs < rhs;
+  case BinOp::CompareLessEqual:    return lhs <= rhs;
+  case BinOp::Div:                 return lhs / rhs;
+  case BinOp::Mul:                 return uint64_t(lhs) * uint64_t(rhs);
+  case BinOp::Or:                  return lhs | rhs;
+  case BinOp::Shl:                 return uint64_t(lhs) << rhs;
+  case BinOp::Shr:                 return lhs >> rhs;
+  case BinOp::Sub:                 return uint64_t(lhs) - uint64_t(rhs);
+  case BinOp::Sum:                 return uint64_t(lhs) + uint64_t(rhs);
+  }
+
+  llvm_unreachable("");
+}
+
 ErrorOr<int64_t> BinOp::evalExpr(SymbolTableTy &symbolTable) const {
   auto lhs = _lhs->evalExpr(symbolTable);
   if (lhs.getError())
@@ -661,28 +791,7 @@ ErrorOr<int64_t> BinOp::evalExpr(SymbolTableTy &symbolTable) const {
   auto rhs = _rhs->evalExpr(symbolTable);
   if (rhs.getError())
     return rhs.getError();
-
-  int64_t lhsRes = *lhs;
-  int64_t rhsRes = *rhs;
-
-  switch(_op) {
-  case And:                 return lhsRes & rhsRes;
-  case CompareDifferent:    return lhsRes != rhsRes;
-  case CompareEqual:        return lhsRes == rhsRes;
-  case CompareGreater:      return lhsRes > rhsRes;
-  case CompareGreaterEqual: return lhsRes >= rhsRes;
-  case CompareLess:         return lhsRes < rhsRes;
-  case CompareLessEqual:    return lhsRes <= rhsRes;
-  case Div:                 return lhsRes / rhsRes;
-  case Mul:                 return lhsRes * rhsRes;
-  case Or:                  return lhsRes | rhsRes;
-  case Shl:                 return lhsRes << rhsRes;
-  case Shr:                 return lhsRes >> rhsRes;
-  case Sub:                 return lhsRes - rhsRes;
-  case Sum:                 return lhsRes + rhsRes;
-  }
-
-  llvm_unreachable("");
+  return applyBinOp(_op, *lhs, *rhs);
 }
 
 // TernaryConditional functions
@@ -704,6 +813,143 @@ TernaryConditional::evalExpr(SymbolTableTy &symbolTable) const {
   return _falseExpr->evalExpr(symbolTable);
 }
 
+// CompiledExpr functions
+CompiledExpr::CompiledExpr(const Expression *expr, SlotMapTy &slots) {
+  compile(expr, slots);
+}
+
+void CompiledExpr::emit(Opcode opcode, int64_t operand) {
+  Instruction inst;
+  inst.opcode = opcode;
+  inst.unaryOp = Unary::Minus;
+  inst.binaryOp = BinOp::Sum;
+  inst.operand = operand;
+  _code.push_back(inst);
+}
+
+/// Returns true if folding the operation does not invoke undefined behavior.
+/// Overflowing arithmetic wraps around in applyBinOp, so only division and
+/// shifts can. Operations that do are left to run time, where they behave
+/// the same as in Expression::evalExpr.
+static bool canFold(BinOp::Operation op, int64_t lhs, int64_t rhs) {
+  switch (op) {
+  case BinOp::Div:
+    return rhs != 0 && !(lhs == INT64_MIN && rhs == -1);
+  case BinOp::Shl:
+  case BinOp::Shr:
+    return rhs >= 0 && rhs < 64;
+  default:
+    return true;
+  }
+}
+
+void CompiledExpr::compile(const Expression *expr, SlotMapTy &slots) {
+  size_t start = _code.size();
+  switch (expr->getKind()) {
+  case Expression::Kind::Constant:
+    emit(PushConstant, cast<Constant>(expr)->num());
+    return;
+  case Expression::Kind::Symbol: {
+    auto it = slots.insert(
+        std::make_pair(cast<Symbol>(expr)->name(), unsigned(slots.size())));
+    emit(PushSymbol, it.first->second);
+    return;
+  }
+  case Expression::Kind::FunctionCall:
+    // Function calls are not supported yet. Their arguments are not
+    // evaluated.
+    emit(Fail, int64_t(LinkerScriptReaderError::unrecognized_function_in_expr));
+    return;
+  case Expression::Kind::Unary: {
+    auto *unary = cast<Unary>(expr);
+    compile(unary->child(), slots);
+    if (_code.size() == start + 1 && _code[start].opcode == PushConstant) {
+      _code[start].operand = applyUnary(unary->op(), _code[start].operand);
+      return;
+    }
+    emit(ApplyUnary);
+    _code.back().unaryOp = unary->op();
+    return;
+  }
+  case Expression::Kind::BinOp: {
+    auto *binOp = cast<BinOp>(expr);
+    compile(binOp->lhs(), slots);
+    compile(binOp->rhs(), slots);
+    if (_code.size() == start + 2 && _code[start].opcode == PushConstant &&
+        _code[start + 1].opcode == PushConstant &&
+        canFold(binOp->op(), _code[start].operand,
+                _code[start + 1].operand)) {
+      _code[start].operand = applyBinOp(binOp->op(), _code[start].operand,
+                                        _code[start + 1].operand);
+      _code.pop_back();
+      return;
+    }
+    emit(ApplyBinary);
+    _code.back().binaryOp = binOp->op();
+    return;
+  }
+  case Expression::Kind::TernaryConditional: {
+    auto *ternary = cast<TernaryConditional>(expr);
+    compile(ternary->conditional(), slots);
+    if (_code.size() == start + 1 && _code[start].opcode == PushConstant) {
+      // Only the selected branch is compiled, as only that one would be
+      // evaluated.
+      bool cond = _code[start].operand != 0;
+      _code.pop_back();
+      compile(cond ? ternary->trueExpr() : ternary->falseExpr(), slots);
+      return;
+    }
+    size_t jumpToFalse = _code.size();
+    emit(JumpIfZero);
+    compile(ternary->trueExpr(), slots);
+    size_t jumpToEnd = _code.size();
+    emit(Jump);
+    _code[jumpToFalse].operand = _code.size();
+    compile(ternary->falseExpr(), slots);
+    _code[jumpToEnd].operand = _code.size();
+    return;
+  }
+  }
+  llvm_unreachable("Unknown expression kind");
+}
+
+ErrorOr<int64_t> CompiledExpr::eval(const SlotTable &table) const {
+  SmallVector<int64_t, 16> stack;
+  for (size_t pc = 0, e = _code.size(); pc < e; ++pc) {
+    const Instruction &inst = _code[pc];
+    switch (inst.opcode) {
+    case PushConstant:
+      stack.push_back(inst.operand);
+      break;
+    case PushSymbol:
+      if (size_t(inst.operand) >= table.defined.size() ||
+          !table.defined[inst.operand])
+        return LinkerScriptReaderError::unknown_symbol_in_expr;
+      stack.push_back(table.values[inst.operand]);
+      break;
+    case ApplyUnary:
+      stack.back() = applyUnary(inst.unaryOp, stack.back());
+      break;
+    case ApplyBinary: {
+      int64_t rhs = stack.pop_back_val();
+      stack.back() = applyBinOp(inst.binaryOp, stack.back(), rhs);
+      break;
+    }
+    case JumpIfZero:
+      if (stack.pop_back_val() == 0)
+        pc = inst.operand - 1;
+      break;
+    case Jump:
+      pc = inst.operand - 1;
+      break;
+    case Fail:
+      return LinkerScriptReaderError(inst.operand);
+    }
+  }
+  assert(stack.size() == 1 && "Unbalanced expression program");
+  return stack.back();
+}
+
 // SymbolAssignment functions
 void SymbolAssignment::dump(raw_ostream &os) const {
   int numParen = 0;
@@ -909,6 +1155,11 @@ void OutputSectionDescription::dump(raw_ostream &os) const {
   }
   os << "  }";
 
+  if (!_region.empty())
+    os << " >" << _region;
+  if (!_lmaRegion.empty())
+    os << " AT>" << _lmaRegion;
+
   if (_fillStream.size() > 0) {
     os << " =";
     dumpByteStream(os, _fillStream);
@@ -1921,6 +2172,29 @@ const OutputSectionDescription *Parser::parseOutputSectionDescription() {
   if (!expectAndConsume(Token::r_brace, "expected }"))
     return nullptr;
 
+  StringRef region;
+  if (_tok._kind == Token::greater) {
+    consumeToken();
+    if (_tok._kind != Token::identifier) {
+      error(_tok, "expected memory region name");
+      return nullptr;
+    }
+    region = _tok._range;
+    consumeToken();
+  }
+
+  StringRef lmaRegion;
+  if (_tok._kind == Token::kw_at && peek()._kind == Token::greater) {
+    consumeToken();
+    consumeToken();
+    if (_tok._kind != Token::identifier) {
+      error(_tok, "expected memory region name");
+      return nullptr;
+    }
+    lmaRegion = _tok._range;
+    consumeToken();
+  }
+
   if (_tok._kind == Token::equal) {
     consumeToken();
     if (_tok._kind != Token::number || !_tok._range.startswith_lower("0x")) {
@@ -1945,7 +2219,8 @@ const OutputSectionDescription *Parser::parseOutputSectionDescription() {
 
   return new (_alloc) OutputSectionDescription(
       *this, sectionName, address, align, subAlign, at, fillExpr, fillStream,
-      alignWithInput, discard, constraint, outputSectionCommands);
+      alignWithInput, discard, constraint, outputSectionCommands, region,
+      lmaRegion);
 }
 
 const Overlay *Parser::parseOverlay() {
@@ -2143,34 +2418,132 @@ Extern *Parser::parseExtern() {
 
 // Sema member functions
 Sema::Sema()
-    : _scripts(), _layoutCommands(), _memberToLayoutOrder(),
-      _memberNameWildcards(), _cacheSectionOrder(), _cacheExpressionOrder(),
-      _deliveredExprs(), _symbolTable() {}
+    : _scripts(), _layoutCommands(), _layoutPatterns(), _memberToLayoutOrder(),
+      _memberNameWildcards(), _memberNameWildcardIndex(), _cacheSectionOrder(),
+      _cacheExpressionOrder(), _deliveredExprs(), _symbolSlots(),
+      _symbolValues(), _compiledExprs() {
+  _symbolSlots.insert(std::make_pair(StringRef("."), 0U));
+}
 
-void Sema::perform() {
+std::error_code Sema::perform() {
   for (auto &parser : _scripts)
     perform(parser->get());
+
+  // Populate the set of symbols defined by the scripts, so that it does not
+  // need to be filled lazily from const member functions. Expressions are
+  // compiled once here rather than each time they are evaluated. We also
+  // record the assignments that precede each layout command, so that
+  // getExprs() does not need to scan the layout commands.
+  unsigned exprBegin = 0;
+  _exprRanges.reserve(_layoutCommands.size());
+  for (auto cmd : _layoutCommands) {
+    _exprRanges.push_back(std::make_pair(exprBegin,
+                                         unsigned(_layoutAssignments.size())));
+    if (isa<InputSection>(cmd))
+      exprBegin = _layoutAssignments.size();
+    auto sa = dyn_cast<SymbolAssignment>(cmd);
+    if (!sa)
+      continue;
+    _layoutAssignments.push_back(sa);
+    StringRef symbol = sa->symbol();
+    if (!symbol.empty() && symbol != ".")
+      _definedSymbols.insert(symbol);
+    compileAssignment(sa);
+  }
+  _deliveredExprs.resize(_layoutCommands.size());
+
+  return buildMemoryRegions();
 }
 
-bool Sema::less(const SectionKey &lhs, const SectionKey &rhs) const {
-  int a = getLayoutOrder(lhs, true);
-  int b = getLayoutOrder(rhs, true);
+std::error_code Sema::buildMemoryRegions() {
+  llvm::StringMap<int> regionIndex;
+  for (auto &parser : _scripts) {
+    for (const Command *c : parser->get()->_commands) {
+      const Memory *memory = dyn_cast<Memory>(c);
+      if (!memory)
+        continue;
+      for (const MemoryBlock *block : *memory) {
+        // ORIGIN and LENGTH must be constant expressions.
+        Expression::SymbolTableTy symbolTable;
+        ErrorOr<int64_t> origin = block->origin()->evalExpr(symbolTable);
+        ErrorOr<int64_t> length = block->length()->evalExpr(symbolTable);
+        if (!origin || !length)
+          return make_dynamic_error_code(Twine("invalid memory region ") +
+                                         block->name());
+        int index = _memoryRegions.size();
+        if (!regionIndex.insert(std::make_pair(block->name(), index)).second)
+          return make_dynamic_error_code(Twine("memory region ") +
+                                         block->name() +
+                                         " is defined more than once");
+        _memoryRegions.push_back({block->name(), uint64_t(*origin),
+                                  uint64_t(*length), uint64_t(*origin),
+                                  StringRef()});
+      }
+    }
+  }
 
-  if (a != b) {
-    if (a < 0)
-      return false;
-    if (b < 0)
-      return true;
-    return a < b;
+  for (const Command *cmd : _layoutCommands) {
+    auto *out = dyn_cast<OutputSectionDescription>(cmd);
+    if (!out || (out->region().empty() && out->lmaRegion().empty()))
+      continue;
+    auto lookup = [&](StringRef name, int &index) -> std::error_code {
+      index = -1;
+      if (name.empty())
+        return std::error_code();
+      auto it = regionIndex.find(name);
+      if (it == regionIndex.end())
+        return make_dynamic_error_code(Twine("memory region ") + name +
+                                       " referenced by " + out->name() +
+                                       " is not declared");
+      index = it->second;
+      return std::error_code();
+    };
+    std::pair<int, int> &regions = _outputSectionRegions[out->name()];
+    if (std::error_code ec = lookup(out->region(), regions.first))
+      return ec;
+    if (std::error_code ec = lookup(out->lmaRegion(), regions.second))
+      return ec;
   }
+  return std::error_code();
+}
 
-  // If both sections are not mapped anywhere, they have the same order
-  if (a < 0)
-    return false;
+Sema::MemoryRegion *Sema::getMemoryRegion(StringRef outputSection) {
+  auto it = _outputSectionRegions.find(outputSection);
+  if (it == _outputSectionRegions.end() || it->second.first < 0)
+    return nullptr;
+  return &_memoryRegions[it->second.first];
+}
+
+Sema::MemoryRegion *Sema::getLMAMemoryRegion(StringRef outputSection) {
+  auto it = _outputSectionRegions.find(outputSection);
+  if (it == _outputSectionRegions.end() || it->second.second < 0)
+    return nullptr;
+  return &_memoryRegions[it->second.second];
+}
+
+void Sema::resetMemoryRegions() {
+  for (MemoryRegion &region : _memoryRegions) {
+    region.cursor = region.origin;
+    region.overflowSection = StringRef();
+  }
+}
 
-  // If both sections fall into the same layout order, we need to find their
-  // relative position as written in the (InputSectionsCmd).
-  return localCompare(a, lhs, rhs);
+std::error_code Sema::checkMemoryRegions() const {
+  std::string msg;
+  llvm::raw_string_ostream os(msg);
+  for (const MemoryRegion &region : _memoryRegions) {
+    uint64_t overflow = region.overflow();
+    if (overflow == 0)
+      continue;
+    if (!os.str().empty())
+      os << "; ";
+    os << "section `" << region.overflowSection << "' will not fit in region `"
+       << region.name << "'; region `" << region.name << "' overflowed by "
+       << overflow << " bytes";
+  }
+  if (!os.str().empty())
+    return make_dynamic_error_code(StringRef(os.str()));
+  return std::error_code();
 }
 
 StringRef Sema::getOutputSection(const SectionKey &key) const {
@@ -2190,68 +2563,60 @@ StringRef Sema::getOutputSection(const SectionKey &key) const {
   return StringRef();
 }
 
-std::vector<const SymbolAssignment *>
-Sema::getExprs(const SectionKey &key) {
+ArrayRef<const SymbolAssignment *> Sema::getExprs(const SectionKey &key) {
   int layoutOrder = getLayoutOrder(key, false);
-  auto ans = std::vector<const SymbolAssignment *>();
+  if (layoutOrder < 0 || _deliveredExprs.test(layoutOrder))
+    return ArrayRef<const SymbolAssignment *>();
 
-  if (layoutOrder < 0 || _deliveredExprs.count(layoutOrder) > 0)
-    return ans;
-
-  for (int i = layoutOrder - 1; i >= 0; --i) {
-    if (isa<InputSection>(_layoutCommands[i]))
-      break;
-    if (auto assgn = dyn_cast<SymbolAssignment>(_layoutCommands[i]))
-      ans.push_back(assgn);
-  }
+  // Mark this layout number as delivered
+  _deliveredExprs.set(layoutOrder);
+  const std::pair<unsigned, unsigned> &range = _exprRanges[layoutOrder];
+  return llvm::makeArrayRef(_layoutAssignments.data() + range.first,
+                            range.second - range.first);
+}
 
-  // Reverse this order so we evaluate the expressions in the original order
-  // of the linker script
-  std::reverse(ans.begin(), ans.end());
+const Sema::CompiledAssignment &
+Sema::compileAssignment(const SymbolAssignment *assgn) {
+  auto it = _compiledExprs.find(assgn);
+  if (it != _compiledExprs.end())
+    return it->second;
 
-  // Mark this layout number as delivered
-  _deliveredExprs.insert(layoutOrder);
-  return ans;
+  CompiledAssignment compiled;
+  compiled.expr = CompiledExpr(assgn->expr(), _symbolSlots);
+  compiled.slot = _symbolSlots.insert(std::make_pair(
+                      assgn->symbol(), unsigned(_symbolSlots.size())))
+                      .first->second;
+  _symbolValues.values.resize(_symbolSlots.size());
+  _symbolValues.defined.resize(_symbolSlots.size());
+  return _compiledExprs[assgn] = std::move(compiled);
 }
 
 std::error_code Sema::evalExpr(const SymbolAssignment *assgn,
                                uint64_t &curPos) {
-  _symbolTable[StringRef(".")] = curPos;
+  const CompiledAssignment &compiled = compileAssignment(assgn);
+  _symbolValues.values[0] = curPos;
+  _symbolValues.defined[0] = true;
 
-  auto ans = assgn->expr()->evalExpr(_symbolTable);
+  auto ans = compiled.expr.eval(_symbolValues);
   if (ans.getError())
     return ans.getError();
   uint64_t result = *ans;
 
-  if (assgn->symbol() == ".") {
+  if (compiled.slot == 0) {
     curPos = result;
     return std::error_code();
   }
 
-  _symbolTable[assgn->symbol()] = result;
+  _symbolValues.values[compiled.slot] = result;
+  _symbolValues.defined[compiled.slot] = true;
   return std::error_code();
 }
 
-const llvm::StringSet<> &Sema::getScriptDefinedSymbols() const {
-  // Do we have cached results?
-  if (!_definedSymbols.empty())
-    return _definedSymbols;
-
-  // Populate our defined set and return it
-  for (auto cmd : _layoutCommands)
-    if (auto sa = dyn_cast<SymbolAssignment>(cmd)) {
-      StringRef symbol = sa->symbol();
-      if (!symbol.empty() && symbol != ".")
-        _definedSymbols.insert(symbol);
-    }
-
-  return _definedSymbols;
-}
-
 uint64_t Sema::getLinkerScriptExprValue(StringRef name) const {
-  auto it = _symbolTable.find(name);
-  assert (it != _symbolTable.end() && "Invalid symbol name!");
-  return it->second;
+  auto it = _symbolSlots.find(name);
+  assert(it != _symbolSlots.end() && _symbolValues.defined[it->second] &&
+         "Invalid symbol name!");
+  return _symbolValues.values[it->second];
 }
 
 void Sema::dump() const {
@@ -2271,66 +2636,133 @@ void Sema::dump() const {
   }
 }
 
-/// Given a string "pattern" with wildcard characters, return true if it
-/// matches "name". This function is useful when checking if a given name
-/// pattern written in the linker script, i.e. ".text*", should match
-/// ".text.anytext".
-static bool wildcardMatch(StringRef pattern, StringRef name) {
-  auto i = name.begin();
+static bool hasWildcard(StringRef name) {
+  for (auto ch : name)
+    if (ch == '*' || ch == '?' || ch == '[' || ch == '\\')
+      return true;
+  return false;
+}
 
-  // Check if each char in pattern also appears in our input name, handling
-  // special wildcard characters.
-  for (auto j = pattern.begin(), e = pattern.end(); j != e; ++j) {
-    if (i == name.end())
-      return false;
+WildcardPattern::WildcardPattern(StringRef pattern) : _kind(Kind::General) {
+  if (!hasWildcard(pattern)) {
+    _kind = Kind::Literal;
+    _text = pattern;
+    return;
+  }
+  if (pattern == "*") {
+    _kind = Kind::Any;
+    return;
+  }
+  if (pattern.endswith("*") && !hasWildcard(pattern.drop_back())) {
+    _kind = Kind::Prefix;
+    _text = pattern.drop_back();
+    return;
+  }
+  if (pattern.startswith("*") && !hasWildcard(pattern.drop_front())) {
+    _kind = Kind::Suffix;
+    _text = pattern.drop_front();
+    return;
+  }
 
-    switch (*j) {
-    case '*':
-      while (!wildcardMatch(pattern.drop_front(j - pattern.begin() + 1),
-                            name.drop_front(i - name.begin() + 1))) {
-        if (i == name.end())
-          return false;
-        ++i;
+  for (size_t i = 0, e = pattern.size(); i < e; ++i) {
+    Element elem;
+    elem.star = false;
+    char c = pattern[i];
+    size_t end = (c == '[') ? pattern.find(']', i + 1) : StringRef::npos;
+    if (c == '*') {
+      // Consecutive stars are the same as one star.
+      if (_elements.empty() || !_elements.back().star) {
+        elem.star = true;
+        _elements.push_back(elem);
       }
-      break;
-    case '?':
-      // Matches any character
-      break;
-    case '[': {
-      // Matches a range of characters specified between brackets
-      size_t end = pattern.find(']', j - pattern.begin());
-      if (end == pattern.size())
-        return false;
-
-      StringRef chars = pattern.slice(j - pattern.begin(), end);
-      if (chars.find(i) == StringRef::npos)
-        return false;
-
-      j = pattern.begin() + end;
-      break;
+      continue;
     }
-    case '\\':
-      ++j;
-      if (*j != *i)
-        return false;
-      break;
-    default:
-      // No wildcard character means we must match exactly the same char
-      if (*j != *i)
-        return false;
-      break;
+    if (c == '?') {
+      elem.chars.set();
+    } else if (end != StringRef::npos) {
+      // A set of characters, such as "[abc]", "[a-z]" or "[!abc]".
+      StringRef set = pattern.slice(i + 1, end);
+      bool negate = set.startswith("!") || set.startswith("^");
+      if (negate)
+        set = set.drop_front();
+      for (size_t j = 0, n = set.size(); j < n; ++j) {
+        if (j + 2 < n && set[j + 1] == '-') {
+          for (unsigned ch = (uint8_t)set[j]; ch <= (uint8_t)set[j + 2]; ++ch)
+            elem.chars.set(ch);
+          j += 2;
+          continue;
+        }
+        elem.chars.set((uint8_t)set[j]);
+      }
+      if (negate)
+        elem.chars.flip();
+      i = end;
+    } else {
+      if (c == '\\' && i + 1 < e)
+        c = pattern[++i];
+      elem.chars.set((uint8_t)c);
     }
-    ++i;
+    _elements.push_back(elem);
   }
+}
 
-  // If our pattern has't consumed the entire string, it is not a match
-  return i == name.end();
+/// Returns true if the pattern matches \p name. This function is useful when
+/// checking if a given name pattern written in the linker script, i.e.
+/// ".text*", should match ".text.anytext".
+bool WildcardPattern::match(StringRef name) const {
+  switch (_kind) {
+  case Kind::Literal:
+    return name == _text;
+  case Kind::Prefix:
+    return name.startswith(_text);
+  case Kind::Suffix:
+    return name.endswith(_text);
+  case Kind::Any:
+    return true;
+  case Kind::General:
+    break;
+  }
+
+  // State i is active if the first i elements match the characters read so
+  // far. An active star lets the following state be active as well, because
+  // a star may match the empty string.
+  size_t n = _elements.size();
+  auto closure = [&](SmallVectorImpl<bool> &states) {
+    for (size_t i = 0; i < n; ++i)
+      if (states[i] && _elements[i].star)
+        states[i + 1] = true;
+  };
+
+  SmallVector<bool, 32> cur(n + 1, false);
+  SmallVector<bool, 32> next(n + 1, false);
+  cur[0] = true;
+  closure(cur);
+  for (char ch : name) {
+    std::fill(next.begin(), next.end(), false);
+    bool active = false;
+    for (size_t i = 0; i < n; ++i) {
+      if (!cur[i])
+        continue;
+      if (_elements[i].star) {
+        next[i] = true;
+        active = true;
+      } else if (_elements[i].chars.test((uint8_t)ch)) {
+        next[i + 1] = true;
+        active = true;
+      }
+    }
+    if (!active)
+      return false;
+    closure(next);
+    cur.swap(next);
+  }
+  return cur[n];
 }
 
 int Sema::matchSectionName(int id, const SectionKey &key) const {
   const InputSectionsCmd *cmd = dyn_cast<InputSectionsCmd>(_layoutCommands[id]);
 
-  if (!cmd || !wildcardMatch(cmd->archiveName(), key.archivePath))
+  if (!cmd || !_layoutPatterns[id].match(key.archivePath))
     return -1;
 
   while ((size_t)++id < _layoutCommands.size() &&
@@ -2338,9 +2770,7 @@ int Sema::matchSectionName(int id, const SectionKey &key) const {
     if (isa<InputSectionSortedGroup>(_layoutCommands[id]))
       continue;
 
-    const InputSectionName *in =
-        dyn_cast<InputSectionName>(_layoutCommands[id]);
-    if (wildcardMatch(in->name(), key.sectionName))
+    if (_layoutPatterns[id].match(key.sectionName))
       return id;
   }
   return -1;
@@ -2348,158 +2778,292 @@ int Sema::matchSectionName(int id, const SectionKey &key) const {
 
 int Sema::getLayoutOrder(const SectionKey &key, bool coarse) const {
   // First check if we already answered this layout question
-  if (coarse) {
-    auto entry = _cacheSectionOrder.find(key);
-    if (entry != _cacheSectionOrder.end())
-      return entry->second;
-  } else {
-    auto entry = _cacheExpressionOrder.find(key);
-    if (entry != _cacheExpressionOrder.end())
-      return entry->second;
-  }
+  LayoutOrderCache &cache = coarse ? _cacheSectionOrder : _cacheExpressionOrder;
+  int order;
+  if (cache.lookup(key, order))
+    return order;
+
+  // Another thread may compute the same order at the same time. That is
+  // harmless because the result is the same.
+  order = findLayoutOrder(key, coarse);
+  cache.insert(key, order);
+  return order;
+}
+
+bool Sema::LayoutOrderCache::lookup(const SectionKey &key, int &order) const {
+  Shard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto entry = shard.map.find(key);
+  if (entry == shard.map.end())
+    return false;
+  order = entry->second;
+  return true;
+}
+
+void Sema::LayoutOrderCache::insert(const SectionKey &key, int order) {
+  Shard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.map.insert(std::make_pair(key, order));
+}
 
+int Sema::findLayoutOrder(const SectionKey &key, bool coarse) const {
   // Try to match exact file name
-  auto range = _memberToLayoutOrder.equal_range(key.memberPath);
-  for (auto I = range.first, E = range.second; I != E; ++I) {
-    int order = I->second;
-    int exprOrder = -1;
+  auto exact = _memberToLayoutOrder.find(key.memberPath);
+  if (exact != _memberToLayoutOrder.end()) {
+    for (int order : exact->second) {
+      int exprOrder = -1;
 
-    if ((exprOrder = matchSectionName(order, key)) >= 0) {
-      if (coarse) {
-        _cacheSectionOrder.insert(std::make_pair(key, order));
-        return order;
-      }
-      _cacheExpressionOrder.insert(std::make_pair(key, exprOrder));
-      return exprOrder;
+      if ((exprOrder = matchSectionName(order, key)) >= 0)
+        return coarse ? order : exprOrder;
     }
   }
 
   // If we still couldn't find a rule for this input section, try to match
-  // wildcards
-  for (auto I = _memberNameWildcards.begin(), E = _memberNameWildcards.end();
-       I != E; ++I) {
-    if (!wildcardMatch(I->first, key.memberPath))
+  // wildcards. Only the rules with a section name pattern that may match
+  // are tried, in the order they appear in the script.
+  SmallVector<unsigned, 16> rules;
+  _memberNameWildcardIndex.lookup(key.sectionName, rules);
+  for (unsigned rule : rules) {
+    const std::pair<WildcardPattern, int> &wildcard =
+        _memberNameWildcards[rule];
+    if (!wildcard.first.match(key.memberPath))
       continue;
-    int order = I->second;
+    int order = wildcard.second;
     int exprOrder = -1;
 
-    if ((exprOrder = matchSectionName(order, key)) >= 0) {
-      if (coarse) {
-        _cacheSectionOrder.insert(std::make_pair(key, order));
-        return order;
-      }
-      _cacheExpressionOrder.insert(std::make_pair(key, exprOrder));
-      return exprOrder;
-    }
+    if ((exprOrder = matchSectionName(order, key)) >= 0)
+      return coarse ? order : exprOrder;
   }
 
-  _cacheSectionOrder.insert(std::make_pair(key, -1));
-  _cacheExpressionOrder.insert(std::make_pair(key, -1));
   return -1;
 }
 
-static bool compareSortedNames(WildcardSortMode sortMode, StringRef lhs,
-                               StringRef rhs) {
+void Sema::SectionNameIndex::add(llvm::StringMap<std::vector<unsigned>> &map,
+                                 StringRef key, unsigned rule) {
+  std::vector<unsigned> &rules = map[key];
+  if (rules.empty() || rules.back() != rule)
+    rules.push_back(rule);
+}
+
+void Sema::SectionNameIndex::add(const WildcardPattern &pattern,
+                                 unsigned rule) {
+  switch (pattern.kind()) {
+  case WildcardPattern::Kind::Literal:
+    add(_literals, pattern.text(), rule);
+    return;
+  case WildcardPattern::Kind::Prefix:
+    add(_prefixes, pattern.text(), rule);
+    _maxPrefixSize = std::max(_maxPrefixSize, pattern.text().size());
+    return;
+  case WildcardPattern::Kind::Suffix:
+    add(_suffixes, pattern.text(), rule);
+    _maxSuffixSize = std::max(_maxSuffixSize, pattern.text().size());
+    return;
+  case WildcardPattern::Kind::Any:
+  case WildcardPattern::Kind::General:
+    if (_others.empty() || _others.back() != rule)
+      _others.push_back(rule);
+    return;
+  }
+}
+
+void Sema::SectionNameIndex::lookup(StringRef name,
+                                    SmallVectorImpl<unsigned> &rules) const {
+  auto append = [&](const llvm::StringMap<std::vector<unsigned>> &map,
+                    StringRef key) {
+    auto it = map.find(key);
+    if (it != map.end())
+      rules.append(it->second.begin(), it->second.end());
+  };
+
+  append(_literals, name);
+  for (size_t i = 1, e = std::min(name.size(), _maxPrefixSize); i <= e; ++i)
+    append(_prefixes, name.substr(0, i));
+  for (size_t i = 1, e = std::min(name.size(), _maxSuffixSize); i <= e; ++i)
+    append(_suffixes, name.substr(name.size() - i));
+  rules.append(_others.begin(), _others.end());
+
+  std::sort(rules.begin(), rules.end());
+  rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+}
+
+/// Returns the priority encoded in the name of a constructor or destructor
+/// section such as .init_array.NNNNN or .ctors.NNNNN. .ctors and .dtors are
+/// run backwards, so their priority is 65535 - NNNNN. Sections without a
+/// priority get 65536, like in GNU ld, so that they go after every section
+/// with an explicit priority.
+static uint64_t getInitPriority(StringRef name) {
+  const uint64_t maxPriority = 65535;
+  const uint64_t defaultPriority = maxPriority + 1;
+  uint64_t priority;
+  for (StringRef prefix : {".init_array.", ".fini_array."})
+    if (name.startswith(prefix) &&
+        !name.substr(prefix.size()).getAsInteger(10, priority))
+      return priority;
+  for (StringRef prefix : {".ctors.", ".dtors."})
+    if (name.startswith(prefix) &&
+        !name.substr(prefix.size()).getAsInteger(10, priority) &&
+        priority <= maxPriority)
+      return maxPriority - priority;
+  return defaultPriority;
+}
+
+namespace {
+/// The keys a sorted group sorts its sections by. See
+/// Sema::SectionOrderKey.
+struct GroupSortKey {
+  uint64_t key;
+  StringRef name;
+  uint64_t subkey;
+};
+} // end anonymous namespace
+
+/// Returns the sort key of a section in a group with the given sort mode.
+/// Larger alignments go first, so alignments are inverted.
+static GroupSortKey getGroupSortKey(WildcardSortMode sortMode,
+                                    const Sema::SectionKey &section) {
+  GroupSortKey ret = {0, StringRef(), 0};
   switch (sortMode) {
   case WildcardSortMode::None:
   case WildcardSortMode::NA:
-    return false;
+    break;
+  case WildcardSortMode::ByName:
+    ret.name = section.sectionName;
+    break;
   case WildcardSortMode::ByAlignment:
+    ret.key = ~section.alignment;
+    break;
   case WildcardSortMode::ByInitPriority:
-  case WildcardSortMode::ByAlignmentAndName:
-    assert(false && "Unimplemented sort order");
+    ret.key = getInitPriority(section.sectionName);
     break;
-  case WildcardSortMode::ByName:
-    return lhs.compare(rhs) < 0;
   case WildcardSortMode::ByNameAndAlignment:
-    int compare = lhs.compare(rhs);
-    if (compare != 0)
-      return compare < 0;
-    return compareSortedNames(WildcardSortMode::ByAlignment, lhs, rhs);
+    ret.name = section.sectionName;
+    ret.subkey = ~section.alignment;
+    break;
+  case WildcardSortMode::ByAlignmentAndName:
+    ret.key = ~section.alignment;
+    ret.name = section.sectionName;
+    break;
   }
-  return false;
+  return ret;
 }
 
-static bool sortedGroupContains(const InputSectionSortedGroup *cmd,
-                                const Sema::SectionKey &key) {
+bool Sema::sortedGroupContains(const InputSectionSortedGroup *cmd,
+                               const SectionKey &key, int &id) const {
+  // Names of a group are linearized in the same order as we visit them here.
+  bool found = false;
   for (const InputSection *child : *cmd) {
-    if (auto i = dyn_cast<InputSectionName>(child)) {
-      if (wildcardMatch(i->name(), key.sectionName))
-        return true;
+    if (isa<InputSectionName>(child)) {
+      found = found || _layoutPatterns[id].match(key.sectionName);
+      ++id;
       continue;
     }
 
     auto *sortedGroup = dyn_cast<InputSectionSortedGroup>(child);
     assert(sortedGroup && "Expected InputSectionSortedGroup object");
 
-    if (sortedGroupContains(sortedGroup, key))
-      return true;
+    if (sortedGroupContains(sortedGroup, key, id))
+      found = true;
+  }
+
+  return found;
+}
+
+/// Returns true if files are sorted by path in the given mode. Files have no
+/// alignment or priority, so only the name part of a sort mode applies to
+/// them.
+static bool isSortedByName(WildcardSortMode sortMode) {
+  return sortMode == WildcardSortMode::ByName ||
+         sortMode == WildcardSortMode::ByNameAndAlignment ||
+         sortMode == WildcardSortMode::ByAlignmentAndName;
+}
+
+bool Sema::SectionOrderKey::operator<(const SectionOrderKey &other) const {
+  if (order != other.order)
+    return order < other.order;
+  if (archiveOrdinal != other.archiveOrdinal)
+    return archiveOrdinal < other.archiveOrdinal;
+  if (archivePath != other.archivePath)
+    return archivePath < other.archivePath;
+  if (fileOrdinal != other.fileOrdinal)
+    return fileOrdinal < other.fileOrdinal;
+  if (memberPath != other.memberPath)
+    return memberPath < other.memberPath;
+  if (rank != other.rank)
+    return rank < other.rank;
+  if (groupKey != other.groupKey)
+    return groupKey < other.groupKey;
+  if (sectionName != other.sectionName)
+    return sectionName < other.sectionName;
+  return groupSubkey < other.groupSubkey;
+}
+
+Sema::SectionOrderKey Sema::getOrderKey(const SectionKey &key,
+                                        unsigned archiveOrdinal,
+                                        unsigned fileOrdinal) const {
+  SectionOrderKey ret;
+  ret.order = findLayoutOrder(key, true);
+  ret.archiveOrdinal = 0;
+  ret.fileOrdinal = 0;
+  ret.rank = 0;
+  ret.groupKey = 0;
+  ret.groupSubkey = 0;
+  if (ret.order < 0) {
+    // Sections with no mapping rule go last.
+    ret.order = INT_MAX;
+    return ret;
   }
 
-  return false;
-}
-
-bool Sema::localCompare(int order, const SectionKey &lhs,
-                        const SectionKey &rhs) const {
   const InputSectionsCmd *cmd =
-      dyn_cast<InputSectionsCmd>(_layoutCommands[order]);
-
+      dyn_cast<InputSectionsCmd>(_layoutCommands[ret.order]);
   assert(cmd && "Invalid InputSectionsCmd index");
+  // Files that are not sorted by name keep their input order, like in GNU
+  // ld, so all sections from one file go before the sections of the next
+  // file. Archives matter only if the members in them are sorted by name.
+  bool archivesSorted = isSortedByName(cmd->archiveSortMode());
+  if (archivesSorted)
+    ret.archivePath = key.archivePath;
+  if (isSortedByName(cmd->fileSortMode())) {
+    if (!archivesSorted)
+      ret.archiveOrdinal = archiveOrdinal;
+    ret.memberPath = key.memberPath;
+  } else {
+    ret.fileOrdinal = fileOrdinal;
+  }
 
-  if (lhs.archivePath != rhs.archivePath)
-    return compareSortedNames(cmd->archiveSortMode(), lhs.archivePath,
-                              rhs.archivePath);
-
-  if (lhs.memberPath != rhs.memberPath)
-    return compareSortedNames(cmd->fileSortMode(), lhs.memberPath,
-                              rhs.memberPath);
-
-  // Both sections come from the same exact same file and rule. Start walking
-  // through input section names as written in the linker script and the
-  // first one to match will have higher priority.
+  // Within a file, sections are ordered by the first input section name or
+  // sorted group that matches them.
+  int id = ret.order + 1;
   for (const InputSection *inputSection : *cmd) {
-    if (auto i = dyn_cast<InputSectionName>(inputSection)) {
-      // If both match, return false (both have equal priority)
-      // If rhs match, return false (rhs has higher priority)
-      if (wildcardMatch(i->name(), rhs.sectionName))
-        return false;
-      //  If lhs matches first, it has priority over rhs
-      if (wildcardMatch(i->name(), lhs.sectionName))
-        return true;
+    if (isa<InputSectionName>(inputSection)) {
+      if (_layoutPatterns[id++].match(key.sectionName))
+        return ret;
+      ++ret.rank;
       continue;
     }
 
-    // Handle sorted subgroups specially
     auto *sortedGroup = dyn_cast<InputSectionSortedGroup>(inputSection);
     assert(sortedGroup && "Expected InputSectionSortedGroup object");
-
-    bool a = sortedGroupContains(sortedGroup, lhs);
-    bool b = sortedGroupContains(sortedGroup, rhs);
-    if (a && !b)
-      return false;
-    if (b && !a)
-      return true;
-    if (!a && !a)
-      continue;
-
-    return compareSortedNames(sortedGroup->sortMode(), lhs.sectionName,
-                              rhs.sectionName);
+    if (sortedGroupContains(sortedGroup, key, id)) {
+      GroupSortKey groupKey = getGroupSortKey(sortedGroup->sortMode(), key);
+      ret.groupKey = groupKey.key;
+      ret.sectionName = groupKey.name;
+      ret.groupSubkey = groupKey.subkey;
+      return ret;
+    }
+    ++ret.rank;
   }
-
-  llvm_unreachable("");
-  return false;
+  return ret;
 }
 
-static bool hasWildcard(StringRef name) {
-  for (auto ch : name)
-    if (ch == '*' || ch == '?' || ch == '[' || ch == '\\')
-      return true;
-  return false;
+void Sema::addLayoutCommand(const Command *cmd, StringRef pattern) {
+  _layoutCommands.push_back(cmd);
+  _layoutPatterns.push_back(WildcardPattern(pattern));
 }
 
 void Sema::linearizeAST(const InputSection *inputSection) {
-  if (isa<InputSectionName>(inputSection)) {
-    _layoutCommands.push_back(inputSection);
+  if (auto *name = dyn_cast<InputSectionName>(inputSection)) {
+    addLayoutCommand(inputSection, name->name());
     return;
   }
 
@@ -2513,35 +3077,41 @@ void Sema::linearizeAST(const InputSection *inputSection) {
 
 void Sema::linearizeAST(const InputSectionsCmd *inputSections) {
   StringRef memberName = inputSections->memberName();
-  // Populate our maps for fast lookup of InputSectionsCmd
-  if (hasWildcard(memberName))
-    _memberNameWildcards.push_back(
-        std::make_pair(memberName, (int)_layoutCommands.size()));
-  else if (!memberName.empty())
-    _memberToLayoutOrder.insert(
-        std::make_pair(memberName.str(), (int)_layoutCommands.size()));
-
-  _layoutCommands.push_back(inputSections);
+  int order = _layoutCommands.size();
+  addLayoutCommand(inputSections, inputSections->archiveName());
   for (const InputSection *inputSection : *inputSections)
     linearizeAST(inputSection);
+
+  // Populate our maps for fast lookup of InputSectionsCmd. Rules with a
+  // wildcard member name are indexed by the patterns of their section names.
+  if (hasWildcard(memberName)) {
+    unsigned rule = _memberNameWildcards.size();
+    _memberNameWildcards.push_back(
+        std::make_pair(WildcardPattern(memberName), order));
+    for (size_t id = order + 1, e = _layoutPatterns.size(); id < e; ++id)
+      _memberNameWildcardIndex.add(_layoutPatterns[id], rule);
+  } else if (!memberName.empty()) {
+    _memberToLayoutOrder[memberName].push_back(order);
+  }
 }
 
 void Sema::linearizeAST(const Sections *sections) {
   for (const Command *sectionCommand : *sections) {
     if (isa<SymbolAssignment>(sectionCommand)) {
-      _layoutCommands.push_back(sectionCommand);
+      addLayoutCommand(sectionCommand);
       continue;
     }
 
     if (!isa<OutputSectionDescription>(sectionCommand))
       continue;
 
-    _layoutCommands.push_back(sectionCommand);
+    addLayoutCommand(sectionCommand);
     auto *outSection = dyn_cast<OutputSectionDescription>(sectionCommand);
 
     for (const Command *outSecCommand : *outSection) {
-      if (isa<SymbolAssignment>(outSecCommand)) {
-        _layoutCommands.push_back(outSecCommand);
+      if (auto *assgn = dyn_cast<SymbolAssignment>(outSecCommand)) {
+        addLayoutCommand(outSecCommand);
+        _assignmentOutputSections[assgn] = outSection->name();
         continue;
       }
 
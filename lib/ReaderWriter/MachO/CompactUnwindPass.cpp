@@ -271,6 +271,8 @@ private:
 ///
 class CompactUnwindPass : public Pass {
 public:
+  const char *name() const override { return "CompactUnwindPass"; }
+
   CompactUnwindPass(const MachOLinkingContext &context)
       : _ctx(context), _archHandler(_ctx.archHandler()),
         _file("<mach-o Compact Unwind Pass>"),
@@ -91,6 +91,8 @@ private:
 ///
 class GOTPass : public Pass {
 public:
+  const char *name() const override { return "GOTPass"; }
+
   GOTPass(const MachOLinkingContext &context)
       : _ctx(context), _archHandler(_ctx.archHandler()),
         _file("<mach-o GOT Pass>") {}
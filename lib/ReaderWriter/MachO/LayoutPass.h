@@ -32,6 +32,8 @@ namespace mach_o {
 /// the sort must take that into account too.
 class LayoutPass : public Pass {
 public:
+  const char *name() const override { return "LayoutPass"; }
+
   struct SortKey {
     SortKey(const DefinedAtom *atom, const DefinedAtom *root, uint64_t override)
         : _atom(atom), _root(root), _override(override) {}
@@ -396,7 +396,10 @@ bool MachOLinkingContext::pathExists(StringRef path) const {
 }
 
 bool MachOLinkingContext::fileExists(StringRef path) const {
-  bool found = pathExists(path);
+  // Files are looked up in the cached listing of their directory, since most
+  // lookups are misses while searching for libraries and frameworks.
+  bool found = _testingFileUsage ? pathExists(path)
+                                 : getDirectoryCache().exists(path);
   // Log search misses.
   if (!found)
     addInputFileNotFound(path);
@@ -504,6 +507,10 @@ MachOLinkingContext::searchDirForLibrary(StringRef path,
 
 
 ErrorOr<StringRef> MachOLinkingContext::searchLibrary(StringRef libName) const {
+  if (!_testingFileUsage) {
+    std::vector<std::string> dirs(searchDirs().begin(), searchDirs().end());
+    getDirectoryCache().listDirectories(dirs);
+  }
   SmallString<256> path;
   for (StringRef dir : searchDirs()) {
     ErrorOr<StringRef> ec = searchDirForLibrary(dir, libName);
@@ -602,8 +609,7 @@ ErrorOr<std::unique_ptr<MemoryBuffer>>
 MachOLinkingContext::getMemoryBuffer(StringRef path) {
   addInputFileDependency(path);
 
-  ErrorOr<std::unique_ptr<MemoryBuffer>> mbOrErr =
-    MemoryBuffer::getFileOrSTDIN(path);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> mbOrErr = getInputFileBuffer(path);
   if (std::error_code ec = mbOrErr.getError())
     return ec;
   std::unique_ptr<MemoryBuffer> mb = std::move(mbOrErr.get());
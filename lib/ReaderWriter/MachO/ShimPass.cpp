@@ -40,6 +40,8 @@ namespace mach_o {
 
 class ShimPass : public Pass {
 public:
+  const char *name() const override { return "ShimPass"; }
+
   ShimPass(const MachOLinkingContext &context)
       : _ctx(context), _archHandler(_ctx.archHandler()),
         _stubInfo(_archHandler.stubInfo()), _file("<mach-o shim pass>") {}
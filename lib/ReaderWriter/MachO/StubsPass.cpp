@@ -205,6 +205,8 @@ private:
 
 class StubsPass : public Pass {
 public:
+  const char *name() const override { return "StubsPass"; }
+
   StubsPass(const MachOLinkingContext &context)
       : _ctx(context), _archHandler(_ctx.archHandler()),
         _stubInfo(_archHandler.stubInfo()), _file("<mach-o Stubs pass>") {}
@@ -288,6 +288,13 @@ public:
 
   uint64_t getNextOrdinal() { return _nextOrdinal++; }
 
+  /// Reserves \p n consecutive ordinals and returns the first one.
+  uint64_t reserveOrdinals(uint64_t n) {
+    uint64_t ret = _nextOrdinal;
+    _nextOrdinal += n;
+    return ret;
+  }
+
 private:
   uint64_t _nextOrdinal;
 };
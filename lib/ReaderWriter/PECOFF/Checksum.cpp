@@ -0,0 +1,97 @@
+//===- lib/ReaderWriter/PECOFF/Checksum.cpp -------------------------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+///
+/// Both the PE checksum and the image hash visit every byte of the output
+/// file, so the image is split into fixed-size slices that are processed in
+/// parallel, and the results of the slices are combined in order.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Checksum.h"
+#include "lld/Core/Parallel.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace llvm::support::endian;
+
+namespace lld {
+namespace pecoff {
+
+// The size of a slice. It must be even so that no 16-bit word of the image
+// straddles two slices.
+static const size_t sliceSize = 1024 * 1024;
+
+static std::vector<ArrayRef<uint8_t>> splitImage(ArrayRef<uint8_t> image) {
+  std::vector<ArrayRef<uint8_t>> slices;
+  for (size_t off = 0, e = image.size(); off < e; off += sliceSize)
+    slices.push_back(image.slice(off, std::min(sliceSize, e - off)));
+  return slices;
+}
+
+// Adds up the 16-bit little-endian words of a slice. A trailing odd byte is
+// treated as a word whose upper half is zero. The sum of a 1MB slice cannot
+// overflow 64 bits, so carries are folded only once at the end.
+static uint64_t sumWords(ArrayRef<uint8_t> slice) {
+  const uint8_t *p = slice.data();
+  size_t numWords = slice.size() / 2;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < numWords; ++i)
+    sum += read16le(p + i * 2);
+  if (slice.size() & 1)
+    sum += p[slice.size() - 1];
+  return sum;
+}
+
+// Folds a sum into 16 bits with end-around carry, which is the same as
+// adding up the words one by one in one's complement arithmetic.
+static uint32_t foldSum(uint64_t sum) {
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+uint32_t computePEChecksum(ArrayRef<uint8_t> image) {
+  std::vector<ArrayRef<uint8_t>> slices = splitImage(image);
+  std::vector<uint64_t> sums(slices.size());
+  parallel_for_each(slices.begin(), slices.end(), [&](ArrayRef<uint8_t> &s) {
+    sums[&s - &slices[0]] = foldSum(sumWords(s));
+  });
+
+  uint64_t sum = 0;
+  for (uint64_t s : sums)
+    sum += s;
+  return foldSum(sum) + image.size();
+}
+
+uint32_t computeImageHash(ArrayRef<uint8_t> image) {
+  // Hash each slice, and then hash the list of the slice hashes.
+  std::vector<ArrayRef<uint8_t>> slices = splitImage(image);
+  std::vector<uint8_t> digests(slices.size() * 16);
+  parallel_for_each(slices.begin(), slices.end(), [&](ArrayRef<uint8_t> &s) {
+    llvm::MD5 hash;
+    llvm::MD5::MD5Result result;
+    hash.update(s);
+    hash.final(result);
+    memcpy(&digests[(&s - &slices[0]) * 16], result, 16);
+  });
+
+  llvm::MD5 hash;
+  llvm::MD5::MD5Result result;
+  hash.update(digests);
+  hash.final(result);
+  return read32le(result);
+}
+
+} // end namespace pecoff
+} // end namespace lld
@@ -0,0 +1,33 @@
+//===- lib/ReaderWriter/PECOFF/Checksum.h ---------------------------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLD_READER_WRITER_PE_COFF_CHECKSUM_H
+#define LLD_READER_WRITER_PE_COFF_CHECKSUM_H
+
+#include "lld/Core/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <cstdint>
+
+namespace lld {
+namespace pecoff {
+
+/// Computes the PE image checksum, which is the 16-bit one's complement sum
+/// of the image plus the image size. The CheckSum field in the PE header
+/// must be zero when this function is called.
+uint32_t computePEChecksum(ArrayRef<uint8_t> image);
+
+/// Computes a hash of the image contents. This is used as the timestamp of
+/// the image with /brepro, so that the same inputs always produce the same
+/// output. The TimeDateStamp field must be zero when this function is called.
+uint32_t computeImageHash(ArrayRef<uint8_t> image);
+
+} // end namespace pecoff
+} // end namespace lld
+
+#endif
@@ -12,6 +12,8 @@
 #include "lld/Core/File.h"
 #include "lld/Core/Pass.h"
 #include "lld/Core/Simple.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Path.h"
 #include <climits>
@@ -37,18 +39,18 @@ typedef PECOFFLinkingContext::ExportDesc ExportDesc;
 static void dedupExports(PECOFFLinkingContext &ctx) {
   std::vector<ExportDesc> &exports = ctx.getDllExports();
   // Pass 1: find duplicate entries
-  std::set<const ExportDesc *> dup;
-  std::map<StringRef, ExportDesc *> map;
+  llvm::DenseSet<const ExportDesc *> dup;
+  llvm::StringMap<ExportDesc *> map;
   for (ExportDesc &exp : exports) {
     if (!exp.externalName.empty())
       continue;
     StringRef symbol = exp.getRealName();
-    auto it = map.find(symbol);
-    if (it == map.end()) {
-      map[symbol] = &exp;
-    } else if (symbol.size() < it->second->getRealName().size()) {
-      map[symbol] = &exp;
-      dup.insert(it->second);
+    ExportDesc *&existing = map[symbol];
+    if (!existing) {
+      existing = &exp;
+    } else if (symbol.size() < existing->getRealName().size()) {
+      dup.insert(existing);
+      existing = &exp;
     } else {
       dup.insert(&exp);
     }
@@ -80,7 +82,7 @@ static void assignOrdinals(PECOFFLinkingContext &ctx) {
 
 static bool getExportedAtoms(PECOFFLinkingContext &ctx, SimpleFile *file,
                              std::vector<TableEntry> &ret) {
-  std::map<StringRef, const DefinedAtom *> definedAtoms;
+  llvm::StringMap<const DefinedAtom *> definedAtoms;
   for (const DefinedAtom *atom : file->defined())
     definedAtoms[atom->name()] = atom;
 
@@ -156,7 +158,9 @@ edata::EdataAtom *EdataPass::createExportDirectoryTable(
   EdataAtom *ret =
       new (_alloc) EdataAtom(_file, sizeof(export_directory_table_entry));
   auto *data = ret->getContents<export_directory_table_entry>();
-  data->TimeDateStamp = time(nullptr);
+  // With /brepro, the timestamp is left zero so that it does not depend on
+  // when the image was linked.
+  data->TimeDateStamp = _ctx.isReproducible() ? 0 : time(nullptr);
   data->OrdinalBase = ordinalBase;
   data->AddressTableEntries = maxOrdinal - ordinalBase + 1;
   data->NumberOfNamePointers = namedEntries.size();
@@ -25,7 +25,6 @@
 #include "lld/Core/Simple.h"
 #include "lld/ReaderWriter/PECOFFLinkingContext.h"
 #include "llvm/Support/COFF.h"
-#include <map>
 
 using llvm::COFF::ImportDirectoryTableEntry;
 
@@ -63,6 +62,8 @@ public:
 
 class EdataPass : public lld::Pass {
 public:
+  const char *name() const override { return "EdataPass"; }
+
   EdataPass(PECOFFLinkingContext &ctx)
       : _ctx(ctx), _file(ctx), _is64(ctx.is64Bit()), _stringOrdinal(1024) {}
 
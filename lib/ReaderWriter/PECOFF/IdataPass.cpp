@@ -11,14 +11,15 @@
 #include "Pass.h"
 #include "lld/Core/File.h"
 #include "lld/Core/Pass.h"
+#include "lld/Core/Parallel.h"
 #include "lld/Core/Simple.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/COFF.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Endian.h"
 #include <algorithm>
 #include <cstddef>
 #include <cstring>
-#include <map>
 #include <vector>
 
 using namespace llvm::support::endian;
@@ -29,9 +30,9 @@ namespace pecoff {
 namespace idata {
 
 IdataAtom::IdataAtom(IdataContext &context, std::vector<uint8_t> data)
-    : COFFLinkerInternalAtom(context.dummyFile,
-                             context.dummyFile.getNextOrdinal(), data) {
-  context.file.addAtom(*this);
+    : COFFLinkerInternalAtom(context.dummyFile, context.getNextOrdinal(),
+                             data) {
+  context.addAtom(*this);
 }
 
 HintNameAtom::HintNameAtom(IdataContext &context, uint16_t hint,
@@ -69,7 +70,7 @@ static std::vector<ImportTableEntryAtom *>
 createImportTableAtoms(IdataContext &context,
                        const std::vector<COFFSharedLibraryAtom *> &sharedAtoms,
                        bool shouldAddReference, StringRef sectionName,
-                       std::map<StringRef, HintNameAtom *> &hintNameCache,
+                       llvm::StringMap<HintNameAtom *> &hintNameCache,
                        llvm::BumpPtrAllocator &alloc) {
   std::vector<ImportTableEntryAtom *> ret;
   for (COFFSharedLibraryAtom *atom : sharedAtoms) {
@@ -82,15 +83,10 @@ createImportTableAtoms(IdataContext &context,
     } else {
       // Import by name
       entry = new (alloc) ImportTableEntryAtom(context, 0, sectionName);
-      HintNameAtom *hintNameAtom;
-      auto it = hintNameCache.find(atom->importName());
-      if (it == hintNameCache.end()) {
+      HintNameAtom *&hintNameAtom = hintNameCache[atom->importName()];
+      if (!hintNameAtom)
         hintNameAtom = new (alloc) HintNameAtom(
             context, atom->hint(), atom->importName());
-        hintNameCache[atom->importName()] = hintNameAtom;
-      } else {
-        hintNameAtom = it->second;
-      }
       addDir32NBReloc(entry, hintNameAtom, context.ctx.getMachineType(), 0);
     }
     ret.push_back(entry);
@@ -112,7 +108,7 @@ void ImportDirectoryAtom::addRelocations(
   // same. The PE/COFF loader overwrites the import address tables with the
   // pointers to the referenced items after loading the executable into
   // memory.
-  std::map<StringRef, HintNameAtom *> hintNameCache;
+  llvm::StringMap<HintNameAtom *> hintNameCache;
   std::vector<ImportTableEntryAtom *> importLookupTables =
       createImportTableAtoms(context, sharedAtoms, false, ".idata.t",
                              hintNameCache, _alloc);
@@ -125,9 +121,9 @@ void ImportDirectoryAtom::addRelocations(
   addDir32NBReloc(this, importAddressTables[0], context.ctx.getMachineType(),
                   offsetof(ImportDirectoryTableEntry, ImportAddressTableRVA));
   auto *atom = new (_alloc)
-      COFFStringAtom(context.dummyFile, context.dummyFile.getNextOrdinal(),
-                     ".idata", loadName);
-  context.file.addAtom(*atom);
+      COFFStringAtom(context.dummyFile, context.getNextOrdinal(), ".idata",
+                     loadName);
+  context.addAtom(*atom);
   addDir32NBReloc(this, atom, context.ctx.getMachineType(),
                   offsetof(ImportDirectoryTableEntry, NameRVA));
 }
@@ -168,7 +164,7 @@ void DelayImportDirectoryAtom::addRelocations(
   // as (non-delay) import table's Import Lookup Table. Contains
   // imported function names. This is a parallel array of AddressTable
   // field.
-  std::map<StringRef, HintNameAtom *> hintNameCache;
+  llvm::StringMap<HintNameAtom *> hintNameCache;
   std::vector<ImportTableEntryAtom *> nameTable =
       createImportTableAtoms(
           context, sharedAtoms, false, ".didat", hintNameCache, _alloc);
@@ -178,9 +174,9 @@ void DelayImportDirectoryAtom::addRelocations(
 
   // "Name" field. This points to the NUL-terminated DLL name string.
   auto *name = new (_alloc)
-      COFFStringAtom(context.dummyFile, context.dummyFile.getNextOrdinal(),
-                     ".didat", loadName);
-  context.file.addAtom(*name);
+      COFFStringAtom(context.dummyFile, context.getNextOrdinal(), ".didat",
+                     loadName);
+  context.addAtom(*name);
   addDir32NBReloc(this, name, context.ctx.getMachineType(),
                   offsetof(delay_import_directory_table_entry, Name));
 
@@ -287,54 +283,111 @@ DelayLoaderAtom::createContent(MachineTypes machine) const {
 
 } // namespace idata
 
+// Returns the maximum number of atoms created for a DLL with the given number
+// of imported symbols. The import directory has one hint/name atom per
+// symbol, two import table entries per symbol and a null entry for each
+// table, and the DLL name. The delay-import directory additionally has the
+// module handle and one loader function per symbol.
+static uint64_t getMaxNumAtoms(size_t numSymbols, bool delayLoad) {
+  if (delayLoad)
+    return 4 * numSymbols + 5;
+  return 3 * numSymbols + 4;
+}
+
+// Creates the import directory of each DLL in parallel. A task only creates
+// atoms for its own DLL and sets import table entries of the DLL's shared
+// library atoms, so the tasks are independent of each other.
+template <typename DirectoryAtom>
+void IdataPass::createDirectories(idata::IdataContext &context,
+                                  const DLLImports &dlls, bool delayLoad) {
+  struct Task {
+    Task(idata::IdataContext &parent, uint64_t firstOrdinal, void *m,
+         StringRef name, const std::vector<COFFSharedLibraryAtom *> &a)
+        : context(parent, firstOrdinal), mem(m), loadName(name), atoms(&a) {}
+    idata::IdataContext context;
+    void *mem;
+    StringRef loadName;
+    const std::vector<COFFSharedLibraryAtom *> *atoms;
+  };
+
+  // Reserve ordinals and memory for the directory atoms in DLL order, so
+  // that the result does not depend on how the tasks are scheduled.
+  std::vector<std::unique_ptr<Task>> tasks;
+  for (const auto &dll : dlls) {
+    if (_ctx.isDelayLoadDLL(dll.first) != delayLoad)
+      continue;
+    uint64_t max = getMaxNumAtoms(dll.second.size(), delayLoad);
+    tasks.push_back(llvm::make_unique<Task>(
+        context, _dummyFile.reserveOrdinals(max),
+        _alloc.Allocate<DirectoryAtom>(), dll.first, dll.second));
+  }
+
+  parallel_for_each(tasks.begin(), tasks.end(),
+                    [](const std::unique_ptr<Task> &task) {
+    new (task->mem) DirectoryAtom(task->context, task->loadName, *task->atoms);
+  });
+
+  for (const std::unique_ptr<Task> &task : tasks)
+    for (const DefinedAtom *atom : task->context.atoms)
+      context.file.addAtom(*atom);
+}
+
 void IdataPass::perform(std::unique_ptr<SimpleFile> &file) {
   if (file->sharedLibrary().empty())
     return;
 
   idata::IdataContext context(*file, _dummyFile, _ctx);
-  std::map<StringRef, std::vector<COFFSharedLibraryAtom *>> sharedAtoms =
-      groupByLoadName(*file);
+  DLLImports dlls = groupByLoadName(*file);
   bool hasImports = false;
   bool hasDelayImports = false;
+  for (const auto &dll : dlls) {
+    if (_ctx.isDelayLoadDLL(dll.first))
+      hasDelayImports = true;
+    else
+      hasImports = true;
+  }
 
   // Create the import table and terminate it with the null entry.
-  for (auto i : sharedAtoms) {
-    StringRef loadName = i.first;
-    if (_ctx.isDelayLoadDLL(loadName))
-      continue;
-    hasImports = true;
-    std::vector<COFFSharedLibraryAtom *> &atoms = i.second;
-    new (_alloc) idata::ImportDirectoryAtom(context, loadName, atoms);
-  }
-  if (hasImports)
+  if (hasImports) {
+    createDirectories<idata::ImportDirectoryAtom>(context, dlls, false);
     new (_alloc) idata::NullImportDirectoryAtom(context);
+  }
 
   // Create the delay import table and terminate it with the null entry.
-  for (auto i : sharedAtoms) {
-    StringRef loadName = i.first;
-    if (!_ctx.isDelayLoadDLL(loadName))
-      continue;
-    hasDelayImports = true;
-    std::vector<COFFSharedLibraryAtom *> &atoms = i.second;
-    new (_alloc) idata::DelayImportDirectoryAtom(context, loadName, atoms);
-  }
-  if (hasDelayImports)
+  if (hasDelayImports) {
+    createDirectories<idata::DelayImportDirectoryAtom>(context, dlls, true);
     new (_alloc) idata::DelayNullImportDirectoryAtom(context);
+  }
 
   replaceSharedLibraryAtoms(*file);
 }
 
-std::map<StringRef, std::vector<COFFSharedLibraryAtom *>>
-IdataPass::groupByLoadName(SimpleFile &file) {
-  std::map<StringRef, COFFSharedLibraryAtom *> uniqueAtoms;
+// Groups the shared library atoms by DLL name. DLLs are sorted by name, and
+// so are the atoms of each DLL.
+IdataPass::DLLImports IdataPass::groupByLoadName(SimpleFile &file) {
+  llvm::StringMap<COFFSharedLibraryAtom *> uniqueAtoms;
   for (const SharedLibraryAtom *atom : file.sharedLibrary())
     uniqueAtoms[atom->name()] =
         (COFFSharedLibraryAtom *)const_cast<SharedLibraryAtom *>(atom);
 
-  std::map<StringRef, std::vector<COFFSharedLibraryAtom *> > ret;
-  for (auto i : uniqueAtoms) {
-    COFFSharedLibraryAtom *atom = i.second;
-    ret[atom->loadName()].push_back(atom);
+  std::vector<COFFSharedLibraryAtom *> atoms;
+  atoms.reserve(uniqueAtoms.size());
+  for (const auto &i : uniqueAtoms)
+    atoms.push_back(i.second);
+  std::sort(atoms.begin(), atoms.end(),
+            [](const COFFSharedLibraryAtom *a, const COFFSharedLibraryAtom *b) {
+    int cmp = a->loadName().compare(b->loadName());
+    if (cmp != 0)
+      return cmp < 0;
+    return a->name() < b->name();
+  });
+
+  DLLImports ret;
+  for (COFFSharedLibraryAtom *atom : atoms) {
+    if (ret.empty() || ret.back().first != atom->loadName())
+      ret.push_back(std::make_pair(atom->loadName(),
+                                   std::vector<COFFSharedLibraryAtom *>()));
+    ret.back().second.push_back(atom);
   }
   return ret;
 }
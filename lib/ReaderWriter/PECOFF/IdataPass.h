@@ -26,7 +26,8 @@
 #include "lld/ReaderWriter/PECOFFLinkingContext.h"
 #include "llvm/Support/COFF.h"
 #include <algorithm>
-#include <map>
+#include <utility>
+#include <vector>
 
 using llvm::COFF::ImportDirectoryTableEntry;
 
@@ -39,12 +40,37 @@ class HintNameAtom;
 class ImportTableEntryAtom;
 
 // A state object of this pass.
+//
+// The import directory of each DLL is created by its own task. Such a task
+// uses a context created with a range of ordinals reserved for the DLL, and
+// buffers the atoms it creates instead of adding them to the file, so that
+// tasks do not share any mutable state. The buffered atoms are added to the
+// file in DLL order once all tasks are done.
 struct IdataContext {
   IdataContext(SimpleFile &f, VirtualFile &g, const PECOFFLinkingContext &c)
-      : file(f), dummyFile(g), ctx(c) {}
+      : file(f), dummyFile(g), ctx(c), buffered(false), nextOrdinal(0) {}
+
+  IdataContext(const IdataContext &parent, uint64_t firstOrdinal)
+      : file(parent.file), dummyFile(parent.dummyFile), ctx(parent.ctx),
+        buffered(true), nextOrdinal(firstOrdinal) {}
+
+  uint64_t getNextOrdinal() {
+    return buffered ? nextOrdinal++ : dummyFile.getNextOrdinal();
+  }
+
+  void addAtom(const DefinedAtom &atom) {
+    if (buffered)
+      atoms.push_back(&atom);
+    else
+      file.addAtom(atom);
+  }
+
   SimpleFile &file;
   VirtualFile &dummyFile;
   const PECOFFLinkingContext &ctx;
+  bool buffered;
+  uint64_t nextOrdinal;
+  std::vector<const DefinedAtom *> atoms;
 };
 
 /// The root class of all idata atoms.
@@ -193,13 +219,21 @@ private:
 
 class IdataPass : public lld::Pass {
 public:
+  const char *name() const override { return "IdataPass"; }
+
   IdataPass(const PECOFFLinkingContext &ctx) : _dummyFile(ctx), _ctx(ctx) {}
 
   void perform(std::unique_ptr<SimpleFile> &file) override;
 
 private:
-  std::map<StringRef, std::vector<COFFSharedLibraryAtom *>>
-  groupByLoadName(SimpleFile &file);
+  typedef std::vector<
+      std::pair<StringRef, std::vector<COFFSharedLibraryAtom *>>> DLLImports;
+
+  DLLImports groupByLoadName(SimpleFile &file);
+
+  template <typename DirectoryAtom>
+  void createDirectories(idata::IdataContext &context,
+                         const DLLImports &dlls, bool delayLoad);
 
   void replaceSharedLibraryAtoms(SimpleFile &file);
 
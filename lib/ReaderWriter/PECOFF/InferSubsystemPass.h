@@ -56,6 +56,12 @@ public:
     llvm::report_fatal_error("Failed to infer subsystem");
   }
 
+  const char *name() const override { return "InferSubsystemPass"; }
+
+  // Reads the atoms and sets nothing but the subsystem.
+  unsigned reads() const override { return AtomGraph | ContextState; }
+  unsigned writes() const override { return ContextState; }
+
 private:
   PECOFFLinkingContext &_ctx;
 };
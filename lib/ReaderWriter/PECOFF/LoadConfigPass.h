@@ -51,6 +51,13 @@ public:
 
   void perform(std::unique_ptr<SimpleFile> &file) override;
 
+  const char *name() const override { return "LoadConfigPass"; }
+
+  // Scans the .sxdata atoms and appends the load configuration atom, so it
+  // can run alongside InferSubsystemPass.
+  unsigned reads() const override { return AtomGraph; }
+  unsigned writes() const override { return NewAtoms; }
+
 private:
   PECOFFLinkingContext &_ctx;
   VirtualFile _file;
@@ -55,6 +55,8 @@ static bool compare(const DefinedAtom *lhs, const DefinedAtom *rhs) {
 
 class OrderPass : public lld::Pass {
 public:
+  const char *name() const override { return "OrderPass"; }
+
   void perform(std::unique_ptr<SimpleFile> &file) override {
     SimpleFile::DefinedAtomRange defined = file->definedAtoms();
     parallel_sort(defined.begin(), defined.end(), compare);
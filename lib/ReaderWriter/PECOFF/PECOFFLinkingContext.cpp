@@ -14,7 +14,6 @@
 #include "LinkerGeneratedSymbolFile.h"
 #include "LoadConfigPass.h"
 #include "OrderPass.h"
-#include "PDBPass.h"
 #include "lld/Core/PassManager.h"
 #include "lld/Core/Reader.h"
 #include "lld/Core/Simple.h"
@@ -220,11 +219,15 @@ StringRef PECOFFLinkingContext::searchLibraryFile(StringRef filename) const {
   // Current directory always takes precedence over the search paths.
   if (llvm::sys::path::is_absolute(filename) || llvm::sys::fs::exists(filename))
     return filename;
-  // Iterate over the search paths.
+  // Iterate over the search paths. Each of them is listed once per link, so
+  // that the many misses do not each cost a stat.
+  DirectoryCache &cache = getDirectoryCache();
+  cache.listDirectories(std::vector<std::string>(_inputSearchPaths.begin(),
+                                                 _inputSearchPaths.end()));
   for (StringRef dir : _inputSearchPaths) {
     SmallString<128> path = dir;
     llvm::sys::path::append(path, filename);
-    if (llvm::sys::fs::exists(path.str()))
+    if (cache.exists(path.str()))
       return allocate(path.str());
   }
   return filename;
@@ -339,7 +342,6 @@ std::string PECOFFLinkingContext::getPDBFilePath() const {
 }
 
 void PECOFFLinkingContext::addPasses(PassManager &pm) {
-  pm.add(llvm::make_unique<pecoff::PDBPass>(*this));
   pm.add(llvm::make_unique<pecoff::EdataPass>(*this));
   pm.add(llvm::make_unique<pecoff::IdataPass>(*this));
   pm.add(llvm::make_unique<pecoff::OrderPass>());
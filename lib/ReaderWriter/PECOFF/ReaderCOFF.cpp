@@ -14,6 +14,7 @@
 #include "lld/Driver/Driver.h"
 #include "lld/ReaderWriter/PECOFFLinkingContext.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Object/COFF.h"
@@ -31,8 +32,6 @@
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
-#include <map>
-#include <mutex>
 #include <set>
 #include <system_error>
 #include <vector>
@@ -54,11 +53,12 @@ using namespace lld;
 
 namespace {
 
+// A string saver backed by a per-file arena. Each file is parsed by one
+// thread at a time, so no locking is needed.
 class BumpPtrStringSaver : public llvm::cl::StringSaver {
 public:
   const char *SaveString(const char *str) override {
     size_t len = strlen(str);
-    std::lock_guard<std::mutex> lock(_allocMutex);
     char *copy = _alloc.Allocate<char>(len + 1);
     memcpy(copy, str, len + 1);
     return copy;
@@ -66,19 +66,19 @@ public:
 
 private:
   llvm::BumpPtrAllocator _alloc;
-  std::mutex _allocMutex;
 };
 
 class FileCOFF : public File {
 private:
   typedef std::vector<llvm::object::COFFSymbolRef> SymbolVectorT;
-  typedef std::map<const coff_section *, SymbolVectorT> SectionToSymbolsT;
+  // Defined symbols grouped by section, indexed by section number.
+  typedef std::vector<SymbolVectorT> SectionToSymbolsT;
 
 public:
   FileCOFF(std::unique_ptr<MemoryBuffer> mb, PECOFFLinkingContext &ctx)
     : File(mb->getBufferIdentifier(), kindObject), _mb(std::move(mb)),
-      _compatibleWithSEH(false), _ordinal(1),
-      _machineType(llvm::COFF::MT_Invalid), _ctx(ctx) {}
+      _compatibleWithSEH(false), _symbolTable(nullptr), _sectionTable(nullptr),
+      _ordinal(1), _machineType(llvm::COFF::MT_Invalid), _ctx(ctx) {}
 
   std::error_code doParse() override;
   bool isCompatibleWithSEH() const { return _compatibleWithSEH; }
@@ -108,7 +108,7 @@ public:
 
   AliasAtom *createAlias(StringRef name, const DefinedAtom *target, int cnt);
   void createAlternateNameAtoms();
-  std::error_code parseDirectiveSection(StringRef directives);
+  std::error_code parseDirectiveSection();
 
   mutable llvm::BumpPtrAllocator _alloc;
 
@@ -126,7 +126,7 @@ private:
   createDefinedSymbols(const SymbolVectorT &symbols,
                        std::vector<const DefinedAtom *> &result);
 
-  std::error_code cacheSectionAttributes();
+  std::error_code cacheSectionAttributes(const SymbolVectorT &symbols);
   std::error_code maybeCreateSXDataAtoms();
 
   std::error_code
@@ -151,9 +151,13 @@ private:
 
   std::error_code getSectionContents(StringRef sectionName,
                                      ArrayRef<uint8_t> &result);
+  std::error_code tokenizeDirectiveSection();
   std::error_code getReferenceArch(Reference::KindArch &result);
   std::error_code addRelocationReferenceToAtoms();
   std::error_code findSection(StringRef name, const coff_section *&result);
+  void collectDebugSections();
+  uint32_t getSymbolIndex(llvm::object::COFFSymbolRef sym) const;
+  uint32_t getSectionIndex(const coff_section *section) const;
   StringRef ArrayRefToString(ArrayRef<uint8_t> array);
   uint64_t getNextOrdinal();
 
@@ -170,32 +174,47 @@ private:
   // True if the object has "@feat.00" symbol.
   bool _compatibleWithSEH;
 
-  // A map from symbol to its name. All symbols should be in this map except
-  // unnamed ones.
-  std::map<llvm::object::COFFSymbolRef, StringRef> _symbolName;
+  // The contents of the .drectve section and its tokens. The section is
+  // tokenized in doParse(), which may run in parallel with other files, and
+  // the options are applied to the context in beforeLink().
+  StringRef _directives;
+  SmallVector<const char *, 16> _directiveTokens;
 
-  // A map from symbol to its resultant atom.
-  std::map<llvm::object::COFFSymbolRef, Atom *> _symbolAtom;
+  // The first entries of the symbol table and the section table. Symbols
+  // are identified by their symbol table indices and sections by their
+  // section numbers, so that the tables below can be plain vectors.
+  const uint8_t *_symbolTable;
+  const coff_section *_sectionTable;
 
-  // A map from symbol to its aux symbol.
-  std::map<llvm::object::COFFSymbolRef, llvm::object::COFFSymbolRef> _auxSymbol;
+  // Symbol names, indexed by symbol table index. Unnamed symbols have an
+  // empty name.
+  std::vector<StringRef> _symbolName;
 
-  // A map from section to its atoms.
-  std::map<const coff_section *, std::vector<COFFDefinedFileAtom *>>
-  _sectionAtoms;
+  // The resultant atom of each symbol, indexed by symbol table index.
+  std::vector<Atom *> _symbolAtom;
 
-  // A set of COMDAT sections.
-  std::set<const coff_section *> _comdatSections;
+  // The first aux record of each symbol, indexed by symbol table index, or
+  // null if the symbol has no aux record.
+  std::vector<const void *> _auxSymbol;
 
-  // A map to get whether the section allows its contents to be merged or not.
-  std::map<const coff_section *, DefinedAtom::Merge> _merge;
+  // Atoms of each section, indexed by section number.
+  std::vector<std::vector<COFFDefinedFileAtom *>> _sectionAtoms;
 
-  // COMDAT associative sections
-  std::multimap<const coff_section *, const coff_section *> _association;
+  // True for COMDAT sections, indexed by section number.
+  std::vector<bool> _comdatSections;
 
-  // A sorted map to find an atom from a section and an offset within
-  // the section.
-  std::map<const coff_section *, std::multimap<uint32_t, COFFDefinedAtom *>>
+  // Whether each section allows its contents to be merged or not, indexed by
+  // section number.
+  std::vector<DefinedAtom::Merge> _merge;
+
+  // COMDAT associative sections, as (parent, child) pairs.
+  std::vector<std::pair<const coff_section *, const coff_section *>>
+      _association;
+
+  // Atoms and their offsets in each section, indexed by section number. The
+  // atoms are sorted by offset so that we can find an atom from a section
+  // and an offset within the section.
+  std::vector<std::vector<std::pair<uint32_t, COFFDefinedAtom *>>>
       _definedAtomLocations;
 
   uint64_t _ordinal;
@@ -338,6 +357,8 @@ std::error_code FileCOFF::doParse() {
     return ec;
   if (std::error_code ec = maybeCreateSXDataAtoms())
     return ec;
+  if (std::error_code ec = tokenizeDirectiveSection())
+    return ec;
 
   // Check for /SAFESEH.
   if (_ctx.requireSEH() && !isCompatibleWithSEH()) {
@@ -349,24 +370,28 @@ std::error_code FileCOFF::doParse() {
   return std::error_code();
 }
 
+// beforeLink is called by the resolver for one file at a time, in link
+// order, so the context is mutated deterministically without locking.
+// Everything that depends only on this file has already been done by
+// doParse().
 void FileCOFF::beforeLink() {
-  // Acquire the mutex to mutate _ctx.
-  std::lock_guard<std::recursive_mutex> lock(_ctx.getMutex());
   std::set<StringRef> undefSyms;
 
-  // Interpret .drectve section if the section has contents.
-  ArrayRef<uint8_t> directives;
-  if (getSectionContents(".drectve", directives))
-    return;
-  if (!directives.empty()) {
-    std::set<StringRef> orig;
-    for (StringRef sym : _ctx.initialUndefinedSymbols())
-      orig.insert(sym);
-    if (parseDirectiveSection(ArrayRefToString(directives)))
+  // Interpret .drectve section if the section has contents. /INCLUDE options
+  // are appended to the initial undefined symbols; pick up the new ones.
+  if (!_directiveTokens.empty()) {
+    size_t numOrig = _ctx.initialUndefinedSymbols().size();
+    if (parseDirectiveSection())
       return;
-    for (StringRef sym : _ctx.initialUndefinedSymbols())
-      if (orig.count(sym) == 0)
-        undefSyms.insert(sym);
+    auto syms = _ctx.initialUndefinedSymbols();
+    if ((size_t)syms.size() > numOrig) {
+      llvm::DenseSet<StringRef> orig;
+      for (auto i = syms.begin(), e = syms.begin() + numOrig; i != e; ++i)
+        orig.insert(*i);
+      for (auto i = syms.begin() + numOrig, e = syms.end(); i != e; ++i)
+        if (orig.count(*i) == 0)
+          undefSyms.insert(*i);
+    }
   }
 
   // Add /INCLUDE'ed symbols to the file as if they existed in the
@@ -385,12 +410,74 @@ void FileCOFF::beforeLink() {
   // SEH. Disable SEH if the file being read is not compatible.
   if (!isCompatibleWithSEH())
     _ctx.setSafeSEH(false);
+
+  // Debug sections are not linked as atoms, but their contents are passed to
+  // the PDB writer.
+  if (_ctx.getDebug())
+    collectDebugSections();
+}
+
+/// Collects the contents of the CodeView debug sections of this file. The
+/// relocations of .debug$S sections are resolved to atoms here, so that the
+/// writer can apply them once the atoms have addresses.
+void FileCOFF::collectDebugSections() {
+  PECOFFLinkingContext::DebugSections sections;
+  sections.file = this;
+  sections.fileName = path();
+  for (const auto &sec : _obj->sections()) {
+    const coff_section *section = _obj->getCOFFSection(sec);
+    StringRef sectionName;
+    if (_obj->getSectionName(section, sectionName))
+      return;
+    if (sectionName != ".debug$T" && sectionName != ".debug$S")
+      continue;
+    ArrayRef<uint8_t> contents;
+    if (_obj->getSectionContents(section, contents))
+      return;
+    if (sectionName == ".debug$T") {
+      sections.types.push_back(contents);
+      continue;
+    }
+    PECOFFLinkingContext::DebugSymbols symbols;
+    symbols.data = contents;
+    for (const auto &reloc : sec.relocations()) {
+      const coff_relocation *rel = _obj->getCOFFRelocation(reloc);
+      // Symbols in discarded sections, such as other debug sections, have
+      // no atoms.
+      const Atom *target = nullptr;
+      if (rel->SymbolTableIndex < _symbolAtom.size())
+        target = _symbolAtom[rel->SymbolTableIndex];
+      PECOFFLinkingContext::DebugRelocation r = {rel->VirtualAddress,
+                                                 rel->Type, target};
+      symbols.relocations.push_back(r);
+    }
+    sections.symbols.push_back(std::move(symbols));
+  }
+  _ctx.addDebugSections(std::move(sections));
 }
 
 /// Iterate over the symbol table to retrieve all symbols.
 std::error_code
 FileCOFF::readSymbolTable(SymbolVectorT &result) {
-  for (uint32_t i = 0, e = _obj->getNumberOfSymbols(); i != e; ++i) {
+  uint32_t numSymbols = _obj->getNumberOfSymbols();
+  uint32_t numSections = _obj->getNumberOfSections();
+  _symbolName.resize(numSymbols);
+  _symbolAtom.resize(numSymbols);
+  _auxSymbol.resize(numSymbols);
+  _sectionAtoms.resize(numSections + 1);
+  _comdatSections.resize(numSections + 1);
+  _merge.resize(numSections + 1, DefinedAtom::mergeNo);
+  _definedAtomLocations.resize(numSections + 1);
+  if (numSections > 0)
+    _sectionTable = _obj->getCOFFSection(*_obj->section_begin());
+  if (numSymbols > 0) {
+    ErrorOr<llvm::object::COFFSymbolRef> first = _obj->getSymbol(0);
+    if (std::error_code ec = first.getError())
+      return ec;
+    _symbolTable = reinterpret_cast<const uint8_t *>(first->getRawPtr());
+  }
+
+  for (uint32_t i = 0; i != numSymbols; ++i) {
     // Retrieve the symbol.
     ErrorOr<llvm::object::COFFSymbolRef> sym = _obj->getSymbol(i);
     StringRef name;
@@ -411,7 +498,7 @@ FileCOFF::readSymbolTable(SymbolVectorT &result) {
     }
 
     // Cache the name.
-    _symbolName[*sym] = name;
+    _symbolName[i] = name;
 
     // Symbol may be followed by auxiliary symbol table records. The aux
     // record can be in any format, but the size is always the same as the
@@ -422,7 +509,7 @@ FileCOFF::readSymbolTable(SymbolVectorT &result) {
       ErrorOr<llvm::object::COFFSymbolRef> aux = _obj->getSymbol(i + 1);
       if (std::error_code ec = aux.getError())
         return ec;
-      _auxSymbol[*sym] = *aux;
+      _auxSymbol[i] = aux->getRawPtr();
     }
   next:
     i += sym->getNumberOfAuxSymbols();
@@ -430,16 +517,30 @@ FileCOFF::readSymbolTable(SymbolVectorT &result) {
   return std::error_code();
 }
 
+/// Returns the symbol table index of \p sym.
+uint32_t FileCOFF::getSymbolIndex(llvm::object::COFFSymbolRef sym) const {
+  size_t entrySize = sym.isBigObj() ? sizeof(llvm::object::coff_symbol32)
+                                    : sizeof(llvm::object::coff_symbol16);
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(sym.getRawPtr());
+  return (p - _symbolTable) / entrySize;
+}
+
+/// Returns the 1-based section number of \p section.
+uint32_t FileCOFF::getSectionIndex(const coff_section *section) const {
+  return section - _sectionTable + 1;
+}
+
 /// Create atoms for the absolute symbols.
 void FileCOFF::createAbsoluteAtoms(const SymbolVectorT &symbols,
                                    std::vector<const AbsoluteAtom *> &result) {
   for (llvm::object::COFFSymbolRef sym : symbols) {
     if (sym.getSectionNumber() != llvm::COFF::IMAGE_SYM_ABSOLUTE)
       continue;
-    auto *atom = new (_alloc) SimpleAbsoluteAtom(*this, _symbolName[sym],
+    uint32_t index = getSymbolIndex(sym);
+    auto *atom = new (_alloc) SimpleAbsoluteAtom(*this, _symbolName[index],
                                                  getScope(sym), sym.getValue());
     result.push_back(atom);
-    _symbolAtom[sym] = atom;
+    _symbolAtom[index] = atom;
   }
 }
 
@@ -453,49 +554,48 @@ void FileCOFF::createAbsoluteAtoms(const SymbolVectorT &symbols,
 std::error_code
 FileCOFF::createUndefinedAtoms(const SymbolVectorT &symbols,
                                std::vector<const UndefinedAtom *> &result) {
-  std::map<llvm::object::COFFSymbolRef, llvm::object::COFFSymbolRef>
-      weakExternal;
-  std::set<llvm::object::COFFSymbolRef> fallback;
+  // A mapping from sym1 to sym2 and the set of sym2s, both indexed by
+  // symbol table index.
+  std::vector<uint32_t> weakExternal(_symbolName.size(), UINT32_MAX);
+  std::vector<bool> isFallback(_symbolName.size());
   for (llvm::object::COFFSymbolRef sym : symbols) {
     if (sym.getSectionNumber() != llvm::COFF::IMAGE_SYM_UNDEFINED)
       continue;
     // Create a mapping from sym1 to sym2, if the undefined symbol has
     // auxiliary data.
-    auto iter = _auxSymbol.find(sym);
-    if (iter == _auxSymbol.end())
+    const void *auxPtr = _auxSymbol[getSymbolIndex(sym)];
+    if (!auxPtr)
       continue;
     const coff_aux_weak_external *aux =
-        reinterpret_cast<const coff_aux_weak_external *>(
-            iter->second.getRawPtr());
-    ErrorOr<llvm::object::COFFSymbolRef> sym2 = _obj->getSymbol(aux->TagIndex);
-    if (std::error_code ec = sym2.getError())
-      return ec;
-    weakExternal[sym] = *sym2;
-    fallback.insert(*sym2);
+        reinterpret_cast<const coff_aux_weak_external *>(auxPtr);
+    if (aux->TagIndex >= _symbolName.size())
+      return llvm::object::object_error::parse_failed;
+    weakExternal[getSymbolIndex(sym)] = aux->TagIndex;
+    isFallback[aux->TagIndex] = true;
   }
 
   // Create atoms for the undefined symbols.
   for (llvm::object::COFFSymbolRef sym : symbols) {
     if (sym.getSectionNumber() != llvm::COFF::IMAGE_SYM_UNDEFINED)
       continue;
-    if (fallback.count(sym) > 0)
+    uint32_t index = getSymbolIndex(sym);
+    if (isFallback[index])
       continue;
 
     // If the symbol has sym2, create an undefiend atom for sym2, so that we
     // can pass it as a fallback atom.
     UndefinedAtom *fallback = nullptr;
-    auto iter = weakExternal.find(sym);
-    if (iter != weakExternal.end()) {
-      llvm::object::COFFSymbolRef sym2 = iter->second;
-      fallback = new (_alloc) COFFUndefinedAtom(*this, _symbolName[sym2]);
-      _symbolAtom[sym2] = fallback;
+    uint32_t index2 = weakExternal[index];
+    if (index2 != UINT32_MAX) {
+      fallback = new (_alloc) COFFUndefinedAtom(*this, _symbolName[index2]);
+      _symbolAtom[index2] = fallback;
     }
 
     // Create an atom for the symbol.
     auto *atom =
-        new (_alloc) COFFUndefinedAtom(*this, _symbolName[sym], fallback);
+        new (_alloc) COFFUndefinedAtom(*this, _symbolName[index], fallback);
     result.push_back(atom);
-    _symbolAtom[sym] = atom;
+    _symbolAtom[index] = atom;
   }
   return std::error_code();
 }
@@ -510,11 +610,11 @@ FileCOFF::createDefinedSymbols(const SymbolVectorT &symbols,
   // to be merged. In COFF, it's not very easy to get the section attribute
   // for the symbol, so scan all sections in advance and cache the attributes
   // for later use.
-  if (std::error_code ec = cacheSectionAttributes())
+  if (std::error_code ec = cacheSectionAttributes(symbols))
     return ec;
 
   // Filter non-defined atoms, and group defined atoms by its section.
-  SectionToSymbolsT definedSymbols;
+  SectionToSymbolsT definedSymbols(_sectionAtoms.size());
   for (llvm::object::COFFSymbolRef sym : symbols) {
     // A symbol with section number 0 and non-zero value represents a common
     // symbol. The MS COFF spec did not give a definition of what the common
@@ -533,7 +633,7 @@ FileCOFF::createDefinedSymbols(const SymbolVectorT &symbols,
     // mergeable atom. Implement the above semantcis.
     if (sym.getSectionNumber() == llvm::COFF::IMAGE_SYM_UNDEFINED &&
         sym.getValue() > 0) {
-      StringRef name = _symbolName[sym];
+      StringRef name = _symbolName[getSymbolIndex(sym)];
       uint32_t size = sym.getValue();
       auto *atom = new (_alloc)
           COFFBSSAtom(*this, name, getScope(sym), DefinedAtom::permRW_,
@@ -563,12 +663,13 @@ FileCOFF::createDefinedSymbols(const SymbolVectorT &symbols,
         sc != llvm::COFF::IMAGE_SYM_CLASS_STATIC &&
         sc != llvm::COFF::IMAGE_SYM_CLASS_FUNCTION &&
         sc != llvm::COFF::IMAGE_SYM_CLASS_LABEL) {
-      llvm::errs() << "Unable to create atom for: " << _symbolName[sym] << " ("
+      llvm::errs() << "Unable to create atom for: "
+                   << _symbolName[getSymbolIndex(sym)] << " ("
                    << static_cast<int>(sc) << ")\n";
       return llvm::object::object_error::parse_failed;
     }
 
-    definedSymbols[sec].push_back(sym);
+    definedSymbols[getSectionIndex(sec)].push_back(sym);
   }
 
   // Atomize the defined symbols.
@@ -580,14 +681,17 @@ FileCOFF::createDefinedSymbols(const SymbolVectorT &symbols,
 
 // Cache the COMDAT attributes, which indicate whether the symbols in the
 // section can be merged or not.
-std::error_code FileCOFF::cacheSectionAttributes() {
+std::error_code
+FileCOFF::cacheSectionAttributes(const SymbolVectorT &symbols) {
   // The COMDAT section attribute is not an attribute of coff_section, but is
   // stored in the auxiliary symbol for the first symbol referring a COMDAT
   // section. It feels to me that it's unnecessarily complicated, but this is
   // how COFF works.
-  for (auto i : _auxSymbol) {
+  for (llvm::object::COFFSymbolRef sym : symbols) {
+    const void *auxPtr = _auxSymbol[getSymbolIndex(sym)];
+    if (!auxPtr)
+      continue;
     // Read a section from the file
-    llvm::object::COFFSymbolRef sym = i.first;
     if (sym.getSectionNumber() == llvm::COFF::IMAGE_SYM_ABSOLUTE ||
         sym.getSectionNumber() == llvm::COFF::IMAGE_SYM_UNDEFINED)
       continue;
@@ -596,13 +700,12 @@ std::error_code FileCOFF::cacheSectionAttributes() {
     if (std::error_code ec = _obj->getSection(sym.getSectionNumber(), sec))
       return ec;
     const coff_aux_section_definition *aux =
-        reinterpret_cast<const coff_aux_section_definition *>(
-            i.second.getRawPtr());
+        reinterpret_cast<const coff_aux_section_definition *>(auxPtr);
 
     if (sec->Characteristics & llvm::COFF::IMAGE_SCN_LNK_COMDAT) {
       // Read aux symbol data.
-      _comdatSections.insert(sec);
-      _merge[sec] = getMerge(aux);
+      _comdatSections[getSectionIndex(sec)] = true;
+      _merge[getSectionIndex(sec)] = getMerge(aux);
     }
 
     // Handle associative sections.
@@ -611,17 +714,20 @@ std::error_code FileCOFF::cacheSectionAttributes() {
       if (std::error_code ec =
               _obj->getSection(aux->getNumber(sym.isBigObj()), parent))
         return ec;
-      _association.insert(std::make_pair(parent, sec));
+      _association.push_back(std::make_pair(parent, sec));
     }
   }
+  // Keep the associations grouped by parent section in section order.
+  std::stable_sort(
+      _association.begin(), _association.end(),
+      [](const std::pair<const coff_section *, const coff_section *> &a,
+         const std::pair<const coff_section *, const coff_section *> &b) {
+        return a.first < b.first;
+      });
 
   // The sections that does not have auxiliary symbol are regular sections, in
-  // which symbols are not allowed to be merged.
-  for (const auto &section : _obj->sections()) {
-    const coff_section *sec = _obj->getCOFFSection(section);
-    if (!_merge.count(sec))
-      _merge[sec] = DefinedAtom::mergeNo;
-  }
+  // which symbols are not allowed to be merged. _merge is initialized with
+  // mergeNo for them.
   return std::error_code();
 }
 
@@ -647,11 +753,12 @@ std::error_code FileCOFF::AtomizeDefinedSymbolsInSection(
       llvm::object::COFFSymbolRef sym = *si;
       uint32_t size = (si + 1 == se) ? section->SizeOfRawData - sym.getValue()
                                      : si[1].getValue() - sym.getValue();
+      uint32_t index = getSymbolIndex(sym);
       auto *atom = new (_alloc) COFFBSSAtom(
-          *this, _symbolName[sym], getScope(sym), getPermissions(section),
+          *this, _symbolName[index], getScope(sym), getPermissions(section),
           DefinedAtom::mergeAsWeakAndAddressUsed, size, getNextOrdinal());
       atoms.push_back(atom);
-      _symbolAtom[sym] = atom;
+      _symbolAtom[index] = atom;
     }
     return std::error_code();
   }
@@ -666,10 +773,10 @@ std::error_code FileCOFF::AtomizeDefinedSymbolsInSection(
       section->Characteristics & llvm::COFF::IMAGE_SCN_LNK_REMOVE)
     return std::error_code();
 
-  // Supporting debug info needs more work than just linking and combining
-  // .debug sections. We don't support it yet. Let's discard .debug sections at
-  // the very beginning of the process so that we don't spend time on linking
-  // blobs that nobody would understand.
+  // Debug sections are not linked into the image. If /DEBUG is given, the
+  // CodeView sections are read by beforeLink() and written to the PDB file
+  // instead. Let's discard .debug sections at the very beginning of the
+  // process so that we don't spend time on linking them as atoms.
   if ((section->Characteristics & llvm::COFF::IMAGE_SCN_MEM_DISCARDABLE) &&
       (sectionName == ".debug" || sectionName.startswith(".debug$"))) {
     return std::error_code();
@@ -678,16 +785,20 @@ std::error_code FileCOFF::AtomizeDefinedSymbolsInSection(
   DefinedAtom::ContentType type = getContentType(section);
   DefinedAtom::ContentPermissions perms = getPermissions(section);
   uint64_t sectionSize = section->SizeOfRawData;
-  bool isComdat = (_comdatSections.count(section) == 1);
+  uint32_t sectionIndex = getSectionIndex(section);
+  bool isComdat = _comdatSections[sectionIndex];
+  DefinedAtom::Merge merge = _merge[sectionIndex];
+  std::vector<std::pair<uint32_t, COFFDefinedAtom *>> &locations =
+      _definedAtomLocations[sectionIndex];
 
   // Create an atom for the entire section.
   if (symbols.empty()) {
     ArrayRef<uint8_t> data(secData.data(), secData.size());
     auto *atom = new (_alloc) COFFDefinedAtom(
         *this, "", sectionName, sectionSize, Atom::scopeTranslationUnit,
-        type, isComdat, perms, _merge[section], data, getNextOrdinal());
+        type, isComdat, perms, merge, data, getNextOrdinal());
     atoms.push_back(atom);
-    _definedAtomLocations[section].insert(std::make_pair(0, atom));
+    locations.push_back(std::make_pair(0, atom));
     return std::error_code();
   }
 
@@ -698,9 +809,9 @@ std::error_code FileCOFF::AtomizeDefinedSymbolsInSection(
     ArrayRef<uint8_t> data(secData.data(), size);
     auto *atom = new (_alloc) COFFDefinedAtom(
         *this, "", sectionName, sectionSize, Atom::scopeTranslationUnit,
-        type, isComdat, perms, _merge[section], data, getNextOrdinal());
+        type, isComdat, perms, merge, data, getNextOrdinal());
     atoms.push_back(atom);
-    _definedAtomLocations[section].insert(std::make_pair(0, atom));
+    locations.push_back(std::make_pair(0, atom));
   }
 
   for (auto si = symbols.begin(), se = symbols.end(); si != se; ++si) {
@@ -709,12 +820,14 @@ std::error_code FileCOFF::AtomizeDefinedSymbolsInSection(
     const uint8_t *end = (si + 1 == se) ? secData.data() + secData.size()
                                         : secData.data() + (si + 1)->getValue();
     ArrayRef<uint8_t> data(start, end);
+    uint32_t index = getSymbolIndex(*si);
     auto *atom = new (_alloc) COFFDefinedAtom(
-        *this, _symbolName[*si], sectionName, sectionSize, getScope(*si),
-        type, isComdat, perms, _merge[section], data, getNextOrdinal());
+        *this, _symbolName[index], sectionName, sectionSize, getScope(*si),
+        type, isComdat, perms, merge, data, getNextOrdinal());
     atoms.push_back(atom);
-    _symbolAtom[*si] = atom;
-    _definedAtomLocations[section].insert(std::make_pair(si->getValue(), atom));
+    _symbolAtom[index] = atom;
+    // Symbols are sorted by value, so the locations stay sorted.
+    locations.push_back(std::make_pair(si->getValue(), atom));
   }
   return std::error_code();
 }
@@ -724,9 +837,13 @@ std::error_code FileCOFF::AtomizeDefinedSymbols(
     std::vector<const DefinedAtom *> &definedAtoms) {
   // For each section, make atoms for all the symbols defined in the
   // section, and append the atoms to the result objects.
-  for (auto &i : definedSymbols) {
-    const coff_section *section = i.first;
-    SymbolVectorT &symbols = i.second;
+  for (uint32_t i = 1, e = definedSymbols.size(); i < e; ++i) {
+    SymbolVectorT &symbols = definedSymbols[i];
+    if (symbols.empty())
+      continue;
+    const coff_section *section;
+    if (std::error_code ec = _obj->getSection(i, section))
+      return ec;
     std::vector<COFFDefinedFileAtom *> atoms;
     if (std::error_code ec =
             AtomizeDefinedSymbolsInSection(section, symbols, atoms))
@@ -747,7 +864,7 @@ std::error_code FileCOFF::AtomizeDefinedSymbols(
         addLayoutEdge(*it, *(it + 1), lld::Reference::kindLayoutAfter);
 
     for (COFFDefinedFileAtom *atom : atoms) {
-      _sectionAtoms[section].push_back(atom);
+      _sectionAtoms[i].push_back(atom);
       definedAtoms.push_back(atom);
     }
   }
@@ -763,9 +880,11 @@ std::error_code FileCOFF::AtomizeDefinedSymbols(
   for (auto i : _association) {
     const coff_section *parent = i.first;
     const coff_section *child = i.second;
-    if (_sectionAtoms.count(child)) {
-      COFFDefinedFileAtom *p = _sectionAtoms[parent][0];
-      p->addAssociate(_sectionAtoms[child][0]);
+    std::vector<COFFDefinedFileAtom *> &childAtoms =
+        _sectionAtoms[getSectionIndex(child)];
+    if (!childAtoms.empty()) {
+      COFFDefinedFileAtom *p = _sectionAtoms[getSectionIndex(parent)][0];
+      p->addAssociate(childAtoms[0]);
     }
   }
 
@@ -777,13 +896,14 @@ std::error_code FileCOFF::findAtomAt(const coff_section *section,
                                      uint32_t targetAddress,
                                      COFFDefinedFileAtom *&result,
                                      uint32_t &offsetInAtom) {
-  auto loc = _definedAtomLocations.find(section);
-  if (loc == _definedAtomLocations.end())
-    return llvm::object::object_error::parse_failed;
-  std::multimap<uint32_t, COFFDefinedAtom *> &map = loc->second;
-
-  auto it = map.upper_bound(targetAddress);
-  if (it == map.begin())
+  const std::vector<std::pair<uint32_t, COFFDefinedAtom *>> &locations =
+      _definedAtomLocations[getSectionIndex(section)];
+  auto it = std::upper_bound(
+      locations.begin(), locations.end(), targetAddress,
+      [](uint32_t addr, const std::pair<uint32_t, COFFDefinedAtom *> &loc) {
+        return addr < loc.first;
+      });
+  if (it == locations.begin())
     return llvm::object::object_error::parse_failed;
   --it;
   uint32_t atomAddress = it->first;
@@ -795,10 +915,9 @@ std::error_code FileCOFF::findAtomAt(const coff_section *section,
 /// Find the atom for the symbol that was at the \p index in the symbol
 /// table.
 std::error_code FileCOFF::getAtomBySymbolIndex(uint32_t index, Atom *&ret) {
-  ErrorOr<llvm::object::COFFSymbolRef> symbol = _obj->getSymbol(index);
-  if (std::error_code ec = symbol.getError())
-    return ec;
-  ret = _symbolAtom[*symbol];
+  if (index >= _symbolAtom.size())
+    return llvm::object::object_error::parse_failed;
+  ret = _symbolAtom[index];
   assert(ret);
   return std::error_code();
 }
@@ -864,26 +983,35 @@ void FileCOFF::createAlternateNameAtoms() {
     _definedAtoms.push_back(alias);
 }
 
+// Read the .drectve section and split its contents into tokens, as the
+// shell would do for argv. This does not touch the context.
+std::error_code FileCOFF::tokenizeDirectiveSection() {
+  ArrayRef<uint8_t> contents;
+  if (std::error_code ec = getSectionContents(".drectve", contents))
+    return ec;
+  if (contents.empty())
+    return std::error_code();
+  _directives = ArrayRefToString(contents);
+  DEBUG(llvm::dbgs() << ".drectve: " << _directives << "\n");
+
+  _directiveTokens.push_back("link"); // argv[0] is the command name.
+  llvm::cl::TokenizeWindowsCommandLine(_directives, _stringSaver,
+                                       _directiveTokens);
+  _directiveTokens.push_back(nullptr);
+  return std::error_code();
+}
+
 // Interpret the contents of .drectve section. If exists, the section contains
 // a string containing command line options. The linker is expected to
 // interpret the options as if they were given via the command line.
 //
 // The section mainly contains /defaultlib (-l in Unix), but can contain any
 // options as long as they are valid.
-std::error_code
-FileCOFF::parseDirectiveSection(StringRef directives) {
-  DEBUG(llvm::dbgs() << ".drectve: " << directives << "\n");
-
-  // Split the string into tokens, as the shell would do for argv.
-  SmallVector<const char *, 16> tokens;
-  tokens.push_back("link"); // argv[0] is the command name. Will be ignored.
-  llvm::cl::TokenizeWindowsCommandLine(directives, _stringSaver, tokens);
-  tokens.push_back(nullptr);
-
+std::error_code FileCOFF::parseDirectiveSection() {
   // Calls the command line parser to interpret the token string as if they
   // were given via the command line.
-  int argc = tokens.size() - 1;
-  const char **argv = &tokens[0];
+  int argc = _directiveTokens.size() - 1;
+  const char **argv = &_directiveTokens[0];
   std::string errorMessage;
   llvm::raw_string_ostream stream(errorMessage);
   PECOFFLinkingContext::ParseDirectives parseDirectives =
@@ -893,7 +1021,7 @@ FileCOFF::parseDirectiveSection(StringRef directives) {
   // Print error message if error.
   if (parseFailed) {
     return make_dynamic_error_code(
-      Twine("Failed to parse '") + directives + "'\n"
+      Twine("Failed to parse '") + _directives + "'\n"
       + "Reason: " + errorMessage);
   }
   if (!errorMessage.empty()) {
@@ -932,7 +1060,7 @@ std::error_code FileCOFF::addRelocationReferenceToAtoms() {
     // Skip if there's no atom for the section. Currently we do not create any
     // atoms for some sections, such as "debug$S", and such sections need to
     // be skipped here too.
-    if (_sectionAtoms.find(section) == _sectionAtoms.end())
+    if (_sectionAtoms[getSectionIndex(section)].empty())
       continue;
 
     for (const auto &reloc : sec.relocations()) {
@@ -1031,10 +1159,10 @@ StringRef FileCOFF::ArrayRefToString(ArrayRef<uint8_t> array) {
   }
   if (array.empty())
     return "";
+  // The section contents live as long as this file, so no copy is needed.
   StringRef s(reinterpret_cast<const char *>(array.data()), array.size());
   s = s.substr(0, s.find_first_of('\0'));
-  std::string *contents = new (_alloc) std::string(s.data(), s.size());
-  return StringRef(*contents).trim();
+  return s.trim();
 }
 
 // getNextOrdinal returns a monotonically increasaing uint64_t number
@@ -9,18 +9,63 @@
 ///
 /// This file is responsible for creating the Import Library file.
 ///
+/// An import library is an archive file whose members are short import
+/// objects. A short import object is an IMPORT_OBJECT_HEADER followed by the
+/// null-terminated symbol name and DLL name. It describes one exported
+/// symbol; the linker consuming the import library synthesizes the import
+/// table entries from it (see ReaderImportHeader.cpp).
+///
+/// The archive starts with the two linker members that map symbol names to
+/// member offsets, followed by an optional long name table and one member
+/// per exported symbol. We create the whole file in memory, so that we do
+/// not depend on an external lib.exe.
+///
 //===----------------------------------------------------------------------===//
 
+#include "lld/Core/Error.h"
+#include "lld/Core/Parallel.h"
 #include "lld/ReaderWriter/PECOFFLinkingContext.h"
+#include "llvm/Support/COFF.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/FileSystem.h"
-#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
-#include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+using namespace llvm::support::endian;
 
 namespace lld {
 namespace pecoff {
 
+typedef PECOFFLinkingContext::ExportDesc ExportDesc;
+
+namespace {
+
+/// An archive member for one exported symbol.
+struct ImportMember {
+  explicit ImportMember(const ExportDesc *d) : desc(d) {}
+  const ExportDesc *desc;
+  std::string data;
+  std::vector<std::string> symbols;
+};
+
+/// An entry of the archive symbol table.
+struct ArchiveSymbol {
+  StringRef name;
+  uint32_t memberIndex;
+  uint32_t memberOffset;
+};
+
+} // end anonymous namespace
+
+static const char archiveMagic[] = "!<arch>\n";
+static const size_t memberHeaderSize = 60;
+
 /// Creates a .def file containing the list of exported symbols.
 static std::string
 createModuleDefinitionFile(const PECOFFLinkingContext &ctx) {
@@ -55,18 +100,6 @@ createModuleDefinitionFile(const PECOFFLinkingContext &ctx) {
   return ret;
 }
 
-static std::string writeToTempFile(StringRef contents) {
-  SmallString<128> path;
-  int fd;
-  if (llvm::sys::fs::createTemporaryFile("tmp", "def", fd, path)) {
-    llvm::errs() << "Failed to create temporary file\n";
-    return "";
-  }
-  llvm::raw_fd_ostream os(fd, /*shouldClose*/ true);
-  os << contents;
-  return path.str();
-}
-
 static void writeTo(StringRef path, StringRef contents) {
   int fd;
   if (llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::F_Text)) {
@@ -77,41 +110,222 @@ static void writeTo(StringRef path, StringRef contents) {
   os << contents;
 }
 
-/// Creates a .def file and runs lib.exe on it to create an import library.
-void writeImportLibrary(const PECOFFLinkingContext &ctx) {
-  std::string fileContents = createModuleDefinitionFile(ctx);
+/// Returns the undecorated export name, the same name we would write to a
+/// .def file for lib.exe.
+static std::string getExportName(const PECOFFLinkingContext &ctx,
+                                 const ExportDesc &desc) {
+  if (!desc.externalName.empty())
+    return desc.externalName;
+  if (!desc.mangledName.empty())
+    return ctx.undecorateSymbol(desc.mangledName);
+  return ctx.undecorateSymbol(desc.name);
+}
+
+/// Creates a short import object for the given export. Symbol names are
+/// decorated the way lib.exe does for a .def file entry: on x86, C symbols
+/// get a leading underscore and the loader is told to strip it and any
+/// "@<n>" suffix.
+static void createImportMember(const PECOFFLinkingContext &ctx,
+                               StringRef dllName, uint32_t timestamp,
+                               ImportMember &member) {
+  const ExportDesc &desc = *member.desc;
+  std::string exportName = getExportName(ctx, desc);
+  bool isCxx = StringRef(exportName).startswith("?");
+  std::string symbolName = exportName;
+  if (!isCxx)
+    symbolName = ctx.decorateSymbol(exportName);
+
+  int nameType;
+  if (desc.noname)
+    nameType = llvm::COFF::IMPORT_ORDINAL;
+  else if (isCxx || symbolName == exportName)
+    nameType = llvm::COFF::IMPORT_NAME;
+  else
+    nameType = llvm::COFF::IMPORT_NAME_UNDECORATE;
+  int type = desc.isData ? llvm::COFF::IMPORT_DATA : llvm::COFF::IMPORT_CODE;
+
+  // The header is followed by the null-terminated symbol and DLL names.
+  uint32_t dataSize = symbolName.size() + dllName.size() + 2;
+  member.data.resize(sizeof(llvm::COFF::ImportHeader) + dataSize);
+  char *buf = &member.data[0];
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, Sig1),
+            llvm::COFF::IMAGE_FILE_MACHINE_UNKNOWN);
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, Sig2), 0xFFFF);
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, Version), 0);
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, Machine),
+            ctx.getMachineType());
+  write32le(buf + offsetof(llvm::COFF::ImportHeader, TimeDateStamp),
+            timestamp);
+  write32le(buf + offsetof(llvm::COFF::ImportHeader, SizeOfData), dataSize);
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, OrdinalHint),
+            desc.ordinal);
+  write16le(buf + offsetof(llvm::COFF::ImportHeader, TypeInfo),
+            type | (nameType << 2));
+
+  char *p = buf + sizeof(llvm::COFF::ImportHeader);
+  memcpy(p, symbolName.data(), symbolName.size());
+  p += symbolName.size() + 1;
+  memcpy(p, dllName.data(), dllName.size());
+
+  // Data can only be accessed through the __imp_ pointer. Functions are
+  // also accessible through the jump table with the plain symbol name.
+  if (!desc.isData)
+    member.symbols.push_back(symbolName);
+  member.symbols.push_back("__imp_" + symbolName);
+}
+
+/// Writes an archive member header. Short names are written as "name/", and
+/// long names are references to the long name table.
+static void writeMemberHeader(llvm::raw_ostream &os, StringRef name,
+                              uint32_t timestamp, uint64_t size) {
+  os << llvm::format("%-16s%-12u%-6s%-6s%-8s%-10llu`\n", name.str().c_str(),
+                     timestamp, "", "", "0", (unsigned long long)size);
+}
+
+static void writePadding(llvm::raw_ostream &os, uint64_t size) {
+  if (size & 1)
+    os << '\n';
+}
+
+static uint64_t alignToMember(uint64_t size) { return (size + 1) & ~1ULL; }
+
+static void writeArchive(llvm::raw_ostream &os, StringRef dllName,
+                         uint32_t timestamp,
+                         const std::vector<ImportMember> &members) {
+  // All members are named after the DLL. Names longer than 15 characters
+  // do not fit in the header and go to the long name table.
+  std::string memberName;
+  std::string longNames;
+  if (dllName.size() < 16) {
+    memberName = (dllName + "/").str();
+  } else {
+    memberName = "/0";
+    longNames = (dllName + "/\n").str();
+  }
+
+  std::vector<ArchiveSymbol> symbols;
+  uint64_t stringTableSize = 0;
+  for (size_t i = 0, e = members.size(); i < e; ++i) {
+    for (const std::string &sym : members[i].symbols) {
+      symbols.push_back(ArchiveSymbol{sym, uint32_t(i + 1), 0});
+      stringTableSize += sym.size() + 1;
+    }
+  }
+
+  // Compute the offsets of the members. The first linker member consists of
+  // the number of symbols, their member offsets and their names. The second
+  // one has the number of members, the member offsets, the number of symbols,
+  // 16-bit member indices and the sorted names.
+  uint64_t firstSize = 4 + 4 * symbols.size() + stringTableSize;
+  uint64_t secondSize =
+      4 + 4 * members.size() + 4 + 2 * symbols.size() + stringTableSize;
+  uint64_t offset = sizeof(archiveMagic) - 1;
+  offset += memberHeaderSize + alignToMember(firstSize);
+  offset += memberHeaderSize + alignToMember(secondSize);
+  if (!longNames.empty())
+    offset += memberHeaderSize + alignToMember(longNames.size());
+
+  std::vector<uint32_t> memberOffsets;
+  for (const ImportMember &member : members) {
+    memberOffsets.push_back(offset);
+    offset += memberHeaderSize + alignToMember(member.data.size());
+  }
+  for (ArchiveSymbol &sym : symbols)
+    sym.memberOffset = memberOffsets[sym.memberIndex - 1];
+
+  os << archiveMagic;
+
+  // The first linker member. Integers are big-endian.
+  writeMemberHeader(os, "/", timestamp, firstSize);
+  char buf[4];
+  write32be(buf, symbols.size());
+  os.write(buf, 4);
+  for (const ArchiveSymbol &sym : symbols) {
+    write32be(buf, sym.memberOffset);
+    os.write(buf, 4);
+  }
+  for (const ArchiveSymbol &sym : symbols)
+    os << sym.name << '\0';
+  writePadding(os, firstSize);
+
+  // The second linker member. Integers are little-endian, and the symbols
+  // are sorted by name so that the linker can binary search them.
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](const ArchiveSymbol &a, const ArchiveSymbol &b) {
+    return a.name < b.name;
+  });
+  writeMemberHeader(os, "/", timestamp, secondSize);
+  write32le(buf, members.size());
+  os.write(buf, 4);
+  for (uint32_t memberOffset : memberOffsets) {
+    write32le(buf, memberOffset);
+    os.write(buf, 4);
+  }
+  write32le(buf, symbols.size());
+  os.write(buf, 4);
+  for (const ArchiveSymbol &sym : symbols) {
+    // writeImportLibrary checked that the indices fit in 16 bits.
+    write16le(buf, uint16_t(sym.memberIndex));
+    os.write(buf, 2);
+  }
+  for (const ArchiveSymbol &sym : symbols)
+    os << sym.name << '\0';
+  writePadding(os, secondSize);
+
+  if (!longNames.empty()) {
+    writeMemberHeader(os, "//", timestamp, longNames.size());
+    os << longNames;
+    writePadding(os, longNames.size());
+  }
+
+  for (const ImportMember &member : members) {
+    writeMemberHeader(os, memberName, timestamp, member.data.size());
+    os << member.data;
+    writePadding(os, member.data.size());
+  }
+}
+
+/// Creates an import library containing a short import object for each
+/// exported symbol.
+std::error_code writeImportLibrary(const PECOFFLinkingContext &ctx) {
+  std::string dllName = llvm::sys::path::filename(ctx.outputPath());
+  uint32_t timestamp = ctx.isReproducible() ? 0 : time(nullptr);
+
+  // Private exports are accessible only through GetProcAddress, so they are
+  // not written to the import library.
+  std::vector<ImportMember> members;
+  for (const ExportDesc &desc : ctx.getDllExports())
+    if (!desc.isPrivate)
+      members.push_back(ImportMember(&desc));
+
+  // The second linker member refers to members by 16-bit indices, so an
+  // import library cannot have more than 65535 members.
+  if (members.size() > UINT16_MAX)
+    return make_dynamic_error_code(Twine("too many exports for an import "
+                                         "library: ") +
+                                   Twine(members.size()) + " (limit is " +
+                                   Twine(UINT16_MAX) + ")");
+
+  // Members are independent of each other, so we create them in parallel.
+  // Each task fills its own slot, so the member order is deterministic.
+  parallel_for_each(members.begin(), members.end(), [&](ImportMember &member) {
+    createImportMember(ctx, dllName, timestamp, member);
+  });
 
-  std::string program = "lib.exe";
-  ErrorOr<std::string> programPathOrErr = llvm::sys::findProgramByName(program);
-  if (!programPathOrErr) {
-    llvm::errs() << "Unable to find " << program << " in PATH\n";
+  std::string path = ctx.getOutputImportLibraryPath();
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::F_None);
+  if (ec) {
+    llvm::errs() << "Failed to open " << path << ": " << ec.message() << "\n";
   } else {
-    const std::string &programPath = *programPathOrErr;
-
-    std::string defPath = writeToTempFile(fileContents);
-    llvm::FileRemover tmpFile(defPath);
-
-    std::string defArg = "/def:";
-    defArg.append(defPath);
-    std::string outputArg = "/out:";
-    outputArg.append(ctx.getOutputImportLibraryPath());
-
-    std::vector<const char *> args;
-    args.push_back(programPath.c_str());
-    args.push_back("/nologo");
-    args.push_back(ctx.is64Bit() ? "/machine:x64" : "/machine:x86");
-    args.push_back(defArg.c_str());
-    args.push_back(outputArg.c_str());
-    args.push_back(nullptr);
-
-    if (llvm::sys::ExecuteAndWait(programPath.c_str(), &args[0]) != 0)
-      llvm::errs() << program << " failed\n";
+    writeArchive(os, dllName, timestamp, members);
   }
 
-  // If /lldmoduledeffile:<filename> is given, make a copy of the
-  // temporary module definition file. This feature is for unit tests.
+  // If /lldmoduledeffile:<filename> is given, write the module definition
+  // file that lib.exe would consume. This feature is for unit tests.
   if (!ctx.getModuleDefinitionFile().empty())
-    writeTo(ctx.getModuleDefinitionFile(), fileContents);
+    writeTo(ctx.getModuleDefinitionFile(), createModuleDefinitionFile(ctx));
+  return std::error_code();
 }
 
 } // end namespace pecoff
@@ -10,12 +10,14 @@
 #ifndef LLD_READER_WRITER_PE_COFF_WRITER_IMPORT_LIBRARY_H
 #define LLD_READER_WRITER_PE_COFF_WRITER_IMPORT_LIBRARY_H
 
+#include <system_error>
+
 namespace lld {
 class PECOFFLinkingContext;
 
 namespace pecoff {
 
-void writeImportLibrary(const PECOFFLinkingContext &ctx);
+std::error_code writeImportLibrary(const PECOFFLinkingContext &ctx);
 
 } // end namespace pecoff
 } // end namespace lld
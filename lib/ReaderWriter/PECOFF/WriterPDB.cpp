@@ -0,0 +1,1681 @@
+//===- lib/ReaderWriter/PECOFF/WriterPDB.cpp ------------------------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+///
+/// This file creates PDB files from the CodeView debug sections of the input
+/// object files.
+///
+/// A PDB file is a Multi-Stream File (MSF). We write the PDB info stream, the
+/// type stream (TPI) and the ID stream (IPI) with their hash streams, the
+/// debug info stream (DBI), the /names string table, a symbol stream for
+/// each module and a copy of the section headers of the image. Each linked
+/// object file is a module. The records in the .debug$T sections of all
+/// modules are merged into one type stream and one ID stream.
+///
+/// Type Merging
+/// ============
+///
+/// Records refer to other records by index. An index is local to the
+/// .debug$T section it was read from, where type records and ID records
+/// share one index space. Records are merged module by module: type records
+/// are appended to the type table and ID records to the ID table, each with
+/// its own index space, and the indices in each record are rewritten to the
+/// indices in the table of the record they refer to.
+///
+/// The same types usually appear in many modules because they come from the
+/// same header files. To eliminate duplicates, we first compute a structural
+/// hash for each record in parallel. The hash of a record covers its contents
+/// with each type index replaced by the hash of the record it refers to, so
+/// that it does not depend on the module-local numbering. Records are then
+/// merged sequentially in link order, which makes the output deterministic.
+///
+/// Records may only refer to preceding records. A module that has a forward
+/// reference is malformed, and its type information is ignored.
+///
+/// Symbols and Line Tables
+/// =======================
+///
+/// Symbol records and line tables in .debug$S sections refer to code and
+/// data by section-relative addresses, so the PDB file is created by the
+/// writer after layout. The relocations of the sections are applied to a
+/// copy of their contents, and then the symbol records are copied to the
+/// symbol stream of the module with their type indices remapped, and the
+/// line tables and file checksums follow them. The DBI stream describes
+/// which module contributed each range of the output sections.
+///
+//===----------------------------------------------------------------------===//
+
+#include "WriterPDB.h"
+#include "lld/Core/Parallel.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/COFF.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
+
+using namespace llvm::support::endian;
+
+namespace lld {
+namespace pecoff {
+namespace pdb {
+
+const char msfMagic[32] = {'M', 'i', 'c', 'r', 'o', 's', 'o', 'f', 't', ' ',
+                           'C', '/', 'C', '+', '+', ' ', 'M', 'S', 'F', ' ',
+                           '7', '.', '0', '0', '\r', '\n', '\x1a', 'D', 'S',
+                           '\0', '\0', '\0'};
+
+namespace {
+
+// CodeView type record kinds.
+enum LeafKind : uint16_t {
+  LF_MODIFIER = 0x1001,
+  LF_POINTER = 0x1002,
+  LF_PROCEDURE = 0x1008,
+  LF_MFUNCTION = 0x1009,
+  LF_ARGLIST = 0x1201,
+  LF_FIELDLIST = 0x1203,
+  LF_BITFIELD = 0x1205,
+  LF_METHODLIST = 0x1206,
+  LF_BCLASS = 0x1400,
+  LF_VBCLASS = 0x1401,
+  LF_IVBCLASS = 0x1402,
+  LF_INDEX = 0x1404,
+  LF_VFUNCTAB = 0x1409,
+  LF_ENUMERATE = 0x1502,
+  LF_ARRAY = 0x1503,
+  LF_CLASS = 0x1504,
+  LF_STRUCTURE = 0x1505,
+  LF_UNION = 0x1506,
+  LF_ENUM = 0x1507,
+  LF_MEMBER = 0x150d,
+  LF_STMEMBER = 0x150e,
+  LF_METHOD = 0x150f,
+  LF_NESTTYPE = 0x1510,
+  LF_ONEMETHOD = 0x1511,
+  LF_TYPESERVER2 = 0x1515,
+  LF_INTERFACE = 0x1519,
+  LF_VFTABLE = 0x151d,
+  LF_FUNC_ID = 0x1601,
+  LF_MFUNC_ID = 0x1602,
+  LF_BUILDINFO = 0x1603,
+  LF_SUBSTR_LIST = 0x1604,
+  LF_STRING_ID = 0x1605,
+  LF_UDT_SRC_LINE = 0x1606,
+  LF_UDT_MOD_SRC_LINE = 0x1607,
+
+  // Numeric leaves.
+  LF_NUMERIC = 0x8000,
+  LF_CHAR = 0x8000,
+  LF_SHORT = 0x8001,
+  LF_USHORT = 0x8002,
+  LF_LONG = 0x8003,
+  LF_ULONG = 0x8004,
+  LF_REAL32 = 0x8005,
+  LF_REAL64 = 0x8006,
+  LF_QUADWORD = 0x8009,
+  LF_UQUADWORD = 0x800a,
+
+  // Padding bytes in field lists are 0xf0 to 0xff.
+  LF_PAD0 = 0xf0
+};
+
+// CodeView symbol record kinds.
+enum SymbolKind : uint16_t {
+  S_END = 0x0006,
+  S_THUNK32 = 0x1102,
+  S_BLOCK32 = 0x1103,
+  S_REGISTER = 0x1106,
+  S_CONSTANT = 0x1107,
+  S_UDT = 0x1108,
+  S_BPREL32 = 0x110b,
+  S_LDATA32 = 0x110c,
+  S_GDATA32 = 0x110d,
+  S_LPROC32 = 0x110f,
+  S_GPROC32 = 0x1110,
+  S_REGREL32 = 0x1111,
+  S_LTHREAD32 = 0x1112,
+  S_GTHREAD32 = 0x1113,
+  S_SEPCODE = 0x1132,
+  S_CALLSITEINFO = 0x1139,
+  S_LOCAL = 0x113e,
+  S_LPROC32_ID = 0x1146,
+  S_GPROC32_ID = 0x1147,
+  S_BUILDINFO = 0x114c,
+  S_INLINESITE = 0x114d,
+  S_INLINESITE_END = 0x114e,
+  S_PROC_ID_END = 0x114f,
+  S_FILESTATIC = 0x1153,
+  S_LPROC32_DPC = 0x1155,
+  S_LPROC32_DPC_ID = 0x1156,
+  S_CALLEES = 0x115a,
+  S_CALLERS = 0x115b,
+  S_HEAPALLOCSITE = 0x115e
+};
+
+// The kinds of the subsections of .debug$S sections.
+enum SubsectionKind : uint32_t {
+  DEBUG_S_IGNORE = 0x80000000,
+  DEBUG_S_SYMBOLS = 0xf1,
+  DEBUG_S_STRINGTABLE = 0xf3,
+  DEBUG_S_FILECHKSMS = 0xf4,
+  DEBUG_S_INLINEELINES = 0xf6
+};
+
+// The first type index that refers to a type record. Smaller indices are
+// built-in simple types.
+const uint32_t firstNonSimpleIndex = 0x1000;
+
+// The signature at the beginning of .debug$T and .debug$S sections.
+const uint32_t cvSignatureC13 = 4;
+
+// Stream format versions.
+const uint32_t pdbInfoVersionVC70 = 20000404;
+const uint32_t pdbFeatureVC140 = 20140508;
+const uint32_t tpiVersionV80 = 20040203;
+const uint32_t tpiHeaderSize = 56;
+const uint32_t tpiNumHashBuckets = 0x3ffff;
+const uint32_t dbiVersionV70 = 19990903;
+const uint32_t dbiHeaderSize = 64;
+const uint32_t sectionContribVersion60 = 0xeffe0000 + 19970605;
+const uint32_t stringTableSignature = 0xeffeeffe;
+const uint32_t stringTableHashVersion = 1;
+const uint16_t invalidStream = 0xffff;
+
+// The index of the section header stream in the optional debug header of
+// the DBI stream, and the number of entries in the header.
+const uint32_t debugStreamSectionHeaders = 5;
+const uint32_t numDebugStreams = 11;
+
+// The flags of section map entries.
+enum SectionMapFlags : uint16_t {
+  secMapRead = 0x1,
+  secMapWrite = 0x2,
+  secMapExecute = 0x4,
+  secMapAddressIs32Bit = 0x8,
+  secMapIsSelector = 0x100,
+  secMapIsAbsoluteAddress = 0x200
+};
+
+// The method properties of LF_ONEMETHOD and LF_METHODLIST that have an
+// additional vftable offset field.
+bool isIntroducingVirtual(uint16_t attrs) {
+  uint16_t mprop = (attrs >> 2) & 7;
+  return mprop == 4 || mprop == 6;
+}
+
+/// Returns true if records of \p kind go to the IPI stream.
+bool isIdRecord(uint16_t kind) {
+  switch (kind) {
+  case LF_FUNC_ID:
+  case LF_MFUNC_ID:
+  case LF_BUILDINFO:
+  case LF_SUBSTR_LIST:
+  case LF_STRING_ID:
+  case LF_UDT_SRC_LINE:
+  case LF_UDT_MOD_SRC_LINE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// A view of a type record, including the 2-byte length and the 2-byte kind.
+struct TypeRecord {
+  ArrayRef<uint8_t> data;
+  uint16_t kind() const { return read16le(data.data() + 2); }
+};
+
+/// Returns the size of the numeric leaf at \p off.
+uint32_t getNumericLeafSize(ArrayRef<uint8_t> rec, uint32_t off) {
+  if (off + 2 > rec.size())
+    return rec.size() - off;
+  uint16_t val = read16le(rec.data() + off);
+  if (val < LF_NUMERIC)
+    return 2;
+  switch (val) {
+  case LF_CHAR:
+    return 3;
+  case LF_SHORT:
+  case LF_USHORT:
+    return 4;
+  case LF_LONG:
+  case LF_ULONG:
+  case LF_REAL32:
+    return 6;
+  case LF_REAL64:
+  case LF_QUADWORD:
+  case LF_UQUADWORD:
+    return 10;
+  default:
+    return 2;
+  }
+}
+
+/// Returns the size of the null-terminated string at \p off.
+uint32_t getStringSize(ArrayRef<uint8_t> rec, uint32_t off) {
+  const uint8_t *start = rec.data() + off;
+  const uint8_t *end = rec.data() + rec.size();
+  const uint8_t *p = std::find(start, end, 0);
+  return (p == end) ? end - start : p - start + 1;
+}
+
+/// Calls \p fn with the offsets of the type indices in the members of the
+/// field list record \p rec.
+template <typename Fn> void forEachFieldListTypeIndex(ArrayRef<uint8_t> rec,
+                                                      Fn fn) {
+  uint32_t off = 4;
+  while (off + 4 <= rec.size()) {
+    if (rec[off] >= LF_PAD0) {
+      off += rec[off] & 0xf;
+      continue;
+    }
+    uint16_t kind = read16le(rec.data() + off);
+    uint16_t attrs = read16le(rec.data() + off + 2);
+    if (kind != LF_ENUMERATE && off + 8 > rec.size())
+      return;
+    switch (kind) {
+    case LF_BCLASS:
+      fn(off + 4, false);
+      off += 8 + getNumericLeafSize(rec, off + 8);
+      break;
+    case LF_VBCLASS:
+    case LF_IVBCLASS: {
+      if (off + 12 > rec.size())
+        return;
+      fn(off + 4, false);
+      fn(off + 8, false);
+      off += 12;
+      off += getNumericLeafSize(rec, off);
+      off += getNumericLeafSize(rec, off);
+      break;
+    }
+    case LF_ENUMERATE:
+      off += 4;
+      off += getNumericLeafSize(rec, off);
+      off += getStringSize(rec, off);
+      break;
+    case LF_MEMBER:
+      fn(off + 4, false);
+      off += 8;
+      off += getNumericLeafSize(rec, off);
+      off += getStringSize(rec, off);
+      break;
+    case LF_STMEMBER:
+    case LF_METHOD:
+    case LF_NESTTYPE:
+      fn(off + 4, false);
+      off += 8;
+      off += getStringSize(rec, off);
+      break;
+    case LF_ONEMETHOD:
+      fn(off + 4, false);
+      off += isIntroducingVirtual(attrs) ? 12 : 8;
+      off += getStringSize(rec, off);
+      break;
+    case LF_VFUNCTAB:
+    case LF_INDEX:
+      fn(off + 4, false);
+      off += 8;
+      break;
+    default:
+      // We don't know the layout of this member, so we cannot find the
+      // next one.
+      return;
+    }
+  }
+}
+
+/// Calls \p fn with the offset of each index in \p rec, and whether it
+/// refers to an ID record rather than a type record. Records of unknown
+/// kinds are assumed to have no indices.
+template <typename Fn> void forEachTypeIndex(ArrayRef<uint8_t> rec, Fn fn) {
+  if (rec.size() < 4)
+    return;
+  auto type = [&](uint32_t off) {
+    if (off + 4 <= rec.size())
+      fn(off, false);
+  };
+  auto id = [&](uint32_t off) {
+    if (off + 4 <= rec.size())
+      fn(off, true);
+  };
+  switch (read16le(rec.data() + 2)) {
+  case LF_MODIFIER:
+  case LF_BITFIELD:
+  case LF_UDT_MOD_SRC_LINE:
+    type(4);
+    break;
+  case LF_STRING_ID:
+    id(4);
+    break;
+  case LF_POINTER: {
+    type(4);
+    if (rec.size() < 12)
+      break;
+    // Pointers to members have the containing class type.
+    uint32_t mode = (read32le(rec.data() + 8) >> 5) & 7;
+    if (mode == 2 || mode == 3)
+      type(12);
+    break;
+  }
+  case LF_PROCEDURE:
+    type(4);
+    type(12);
+    break;
+  case LF_MFUNCTION:
+    type(4);
+    type(8);
+    type(12);
+    type(20);
+    break;
+  case LF_ARGLIST:
+  case LF_SUBSTR_LIST: {
+    if (rec.size() < 8)
+      break;
+    bool isId = read16le(rec.data() + 2) == LF_SUBSTR_LIST;
+    uint32_t count = read32le(rec.data() + 4);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (isId)
+        id(8 + i * 4);
+      else
+        type(8 + i * 4);
+    }
+    break;
+  }
+  case LF_BUILDINFO: {
+    if (rec.size() < 6)
+      break;
+    uint16_t count = read16le(rec.data() + 4);
+    for (uint32_t i = 0; i < count; ++i)
+      id(6 + i * 4);
+    break;
+  }
+  case LF_ARRAY:
+  case LF_MFUNC_ID:
+  case LF_VFTABLE:
+    type(4);
+    type(8);
+    break;
+  case LF_FUNC_ID:
+    // The parent scope is an ID.
+    id(4);
+    type(8);
+    break;
+  case LF_UDT_SRC_LINE:
+    // The source file is an LF_STRING_ID.
+    type(4);
+    id(8);
+    break;
+  case LF_CLASS:
+  case LF_STRUCTURE:
+  case LF_INTERFACE:
+    type(8);
+    type(12);
+    type(16);
+    break;
+  case LF_UNION:
+    type(8);
+    break;
+  case LF_ENUM:
+    type(8);
+    type(12);
+    break;
+  case LF_METHODLIST: {
+    uint32_t off = 4;
+    while (off + 8 <= rec.size()) {
+      uint16_t attrs = read16le(rec.data() + off);
+      fn(off + 4, false);
+      off += isIntroducingVirtual(attrs) ? 12 : 8;
+    }
+    break;
+  }
+  case LF_FIELDLIST:
+    forEachFieldListTypeIndex(rec, fn);
+    break;
+  default:
+    break;
+  }
+}
+
+/// Splits a .debug$T section into type records. Returns false if the section
+/// is not in the format we support.
+bool readTypeRecords(ArrayRef<uint8_t> section,
+                     std::vector<TypeRecord> &result) {
+  if (section.size() < 4 || read32le(section.data()) != cvSignatureC13)
+    return false;
+  uint32_t off = 4;
+  while (off + 4 <= section.size()) {
+    uint32_t len = read16le(section.data() + off) + 2;
+    if (len < 4 || off + len > section.size())
+      return false;
+    TypeRecord rec;
+    rec.data = section.slice(off, len);
+    // A type server record means the types are in an external PDB file
+    // (/Zi), which we cannot read.
+    if (rec.kind() == LF_TYPESERVER2)
+      return false;
+    result.push_back(rec);
+    off += len;
+  }
+  return true;
+}
+
+/// The type records of one module and their structural hashes. \p error is
+/// set if the records cannot be merged.
+struct ModuleTypes {
+  std::vector<TypeRecord> records;
+  std::vector<uint64_t> hashes;
+  const char *error;
+};
+
+/// Computes the structural hash of each record of a module. A type index
+/// can only refer to a preceding record, so one forward pass is enough.
+/// Returns false if a record refers to itself or to a later record.
+bool computeHashes(ModuleTypes &mod) {
+  mod.hashes.resize(mod.records.size());
+  llvm::SmallVector<uint8_t, 256> buf;
+  llvm::SmallVector<uint64_t, 16> refs;
+  for (size_t i = 0, e = mod.records.size(); i < e; ++i) {
+    ArrayRef<uint8_t> rec = mod.records[i].data;
+    buf.assign(rec.begin(), rec.end());
+    refs.clear();
+    bool valid = true;
+    forEachTypeIndex(rec, [&](uint32_t off, bool) {
+      uint32_t ti = read32le(rec.data() + off);
+      write32le(&buf[off], 0);
+      if (ti < firstNonSimpleIndex)
+        refs.push_back(ti);
+      else if (ti - firstNonSimpleIndex < i)
+        refs.push_back(mod.hashes[ti - firstNonSimpleIndex]);
+      else
+        valid = false;
+    });
+    if (!valid)
+      return false;
+    mod.hashes[i] = llvm::hash_combine(
+        llvm::hash_combine_range(buf.begin(), buf.end()),
+        llvm::hash_combine_range(refs.begin(), refs.end()));
+  }
+  return true;
+}
+
+/// Returns the record at \p index in \p table.
+ArrayRef<uint8_t> getRecord(const TypeTable &table, uint32_t index) {
+  uint32_t i = index - firstNonSimpleIndex;
+  uint32_t begin = table.offsets[i];
+  uint32_t end = (i + 1 == table.offsets.size()) ? table.records.size()
+                                                 : table.offsets[i + 1];
+  return ArrayRef<uint8_t>(table.records.data() + begin, end - begin);
+}
+
+/// UniqueTable appends records to a TypeTable, reusing identical records
+/// that were added before.
+class UniqueTable {
+public:
+  explicit UniqueTable(TypeTable &table) : _table(table) {}
+
+  uint32_t insert(uint64_t hash, ArrayRef<uint8_t> rec) {
+    auto it = _hashToIndex.find(hash);
+    if (it != _hashToIndex.end() && getRecord(_table, it->second) == rec)
+      return it->second;
+    uint32_t index = firstNonSimpleIndex + _table.offsets.size();
+    _table.offsets.push_back(_table.records.size());
+    _table.records.insert(_table.records.end(), rec.begin(), rec.end());
+    // On a hash collision the record is added without being registered, so
+    // the first record with the hash stays the canonical one.
+    if (it == _hashToIndex.end())
+      _hashToIndex[hash] = index;
+    return index;
+  }
+
+private:
+  TypeTable &_table;
+  std::unordered_map<uint64_t, uint32_t> _hashToIndex;
+};
+
+/// TypeTableBuilder merges the records of modules into a type table and an
+/// ID table.
+class TypeTableBuilder {
+public:
+  explicit TypeTableBuilder(MergedTypes &result)
+      : _types(result.types), _ids(result.ids) {}
+
+  /// Adds the records of a module, which must have been accepted by
+  /// computeHashes(), and returns the index map of the module.
+  IndexMap addModule(const ModuleTypes &mod) {
+    IndexMap map;
+    map.types.resize(mod.records.size());
+    map.ids.resize(mod.records.size());
+    llvm::SmallVector<uint8_t, 256> buf;
+    for (size_t i = 0, e = mod.records.size(); i < e; ++i) {
+      ArrayRef<uint8_t> rec = mod.records[i].data;
+      buf.assign(rec.begin(), rec.end());
+      forEachTypeIndex(rec, [&](uint32_t off, bool isId) {
+        uint32_t ti = read32le(rec.data() + off);
+        if (ti < firstNonSimpleIndex)
+          return;
+        uint32_t local = ti - firstNonSimpleIndex;
+        assert(local < i && "forward references are rejected");
+        // An index into the wrong table cannot be remapped. The map has 0
+        // for it, which is "no type".
+        write32le(&buf[off], isId ? map.ids[local] : map.types[local]);
+      });
+      if (isIdRecord(mod.records[i].kind()))
+        map.ids[i] = _ids.insert(mod.hashes[i], buf);
+      else
+        map.types[i] = _types.insert(mod.hashes[i], buf);
+    }
+    return map;
+  }
+
+private:
+  UniqueTable _types;
+  UniqueTable _ids;
+};
+
+/// Appends little-endian integers and bytes to a stream.
+class StreamWriter {
+public:
+  explicit StreamWriter(std::vector<uint8_t> &buf) : _buf(buf) {}
+
+  void u16(uint16_t v) {
+    uint8_t b[2];
+    write16le(b, v);
+    bytes(b, 2);
+  }
+
+  void u32(uint32_t v) {
+    uint8_t b[4];
+    write32le(b, v);
+    bytes(b, 4);
+  }
+
+  void u64(uint64_t v) {
+    uint8_t b[8];
+    write64le(b, v);
+    bytes(b, 8);
+  }
+
+  void bytes(const void *p, size_t n) {
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+    _buf.insert(_buf.end(), b, b + n);
+  }
+
+  void string(StringRef s) {
+    bytes(s.data(), s.size());
+    _buf.push_back(0);
+  }
+
+  void align(size_t n) {
+    while (_buf.size() % n)
+      _buf.push_back(0);
+  }
+
+  size_t size() const { return _buf.size(); }
+
+private:
+  std::vector<uint8_t> &_buf;
+};
+
+/// Calls \p fn with the offset of each index in the symbol record \p rec,
+/// and whether it refers to an ID record rather than a type record. Records
+/// of unknown kinds are assumed to have no indices.
+template <typename Fn>
+void forEachSymbolTypeIndex(ArrayRef<uint8_t> rec, Fn fn) {
+  if (rec.size() < 4)
+    return;
+  auto type = [&](uint32_t off) {
+    if (off + 4 <= rec.size())
+      fn(off, false);
+  };
+  auto id = [&](uint32_t off) {
+    if (off + 4 <= rec.size())
+      fn(off, true);
+  };
+  switch (read16le(rec.data() + 2)) {
+  case S_REGISTER:
+  case S_CONSTANT:
+  case S_UDT:
+  case S_LDATA32:
+  case S_GDATA32:
+  case S_LTHREAD32:
+  case S_GTHREAD32:
+  case S_LOCAL:
+  case S_FILESTATIC:
+    type(4);
+    break;
+  case S_BPREL32:
+  case S_REGREL32:
+    type(8);
+    break;
+  case S_CALLSITEINFO:
+  case S_HEAPALLOCSITE:
+    type(12);
+    break;
+  case S_LPROC32:
+  case S_GPROC32:
+  case S_LPROC32_DPC:
+    type(28);
+    break;
+  case S_LPROC32_ID:
+  case S_GPROC32_ID:
+  case S_LPROC32_DPC_ID:
+    id(28);
+    break;
+  case S_BUILDINFO:
+    id(4);
+    break;
+  case S_INLINESITE:
+    // The inlined function.
+    id(12);
+    break;
+  case S_CALLEES:
+  case S_CALLERS: {
+    if (rec.size() < 8)
+      break;
+    uint32_t count = std::min<uint32_t>(read32le(rec.data() + 4),
+                                        (rec.size() - 8) / 4);
+    for (uint32_t i = 0; i < count; ++i)
+      id(8 + i * 4);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/// Returns true if symbol records of \p kind open a scope. A scope is closed
+/// by the matching end record, and has the offsets of its parent scope and
+/// of the end record at offsets 4 and 8.
+bool opensScope(uint16_t kind) {
+  switch (kind) {
+  case S_THUNK32:
+  case S_BLOCK32:
+  case S_LPROC32:
+  case S_GPROC32:
+  case S_SEPCODE:
+  case S_LPROC32_ID:
+  case S_GPROC32_ID:
+  case S_INLINESITE:
+  case S_LPROC32_DPC:
+  case S_LPROC32_DPC_ID:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool closesScope(uint16_t kind) {
+  return kind == S_END || kind == S_INLINESITE_END || kind == S_PROC_ID_END;
+}
+
+/// Returns the kind of the record written to the PDB file for a symbol
+/// record of \p kind. Debuggers expect procedures to refer to their function
+/// types rather than to function IDs, so the ID variants are converted, as
+/// the MSVC linker does.
+uint16_t getOutputSymbolKind(uint16_t kind) {
+  switch (kind) {
+  case S_LPROC32_ID:
+    return S_LPROC32;
+  case S_GPROC32_ID:
+    return S_GPROC32;
+  case S_LPROC32_DPC_ID:
+    return S_LPROC32_DPC;
+  case S_PROC_ID_END:
+    return S_END;
+  default:
+    return kind;
+  }
+}
+
+/// The address of an atom in the image.
+struct AtomAddress {
+  uint16_t section;
+  uint32_t sectionOffset;
+  uint32_t rva;
+};
+
+typedef llvm::DenseMap<const Atom *, AtomAddress> AtomAddressMap;
+
+/// The kinds of the relocations in .debug$S sections.
+enum class DebugRelocKind { secRel, section, rva, unsupported };
+
+DebugRelocKind getDebugRelocKind(uint16_t machine, uint16_t type) {
+  switch (machine) {
+  case llvm::COFF::IMAGE_FILE_MACHINE_I386:
+    switch (type) {
+    case llvm::COFF::IMAGE_REL_I386_SECREL:
+      return DebugRelocKind::secRel;
+    case llvm::COFF::IMAGE_REL_I386_SECTION:
+      return DebugRelocKind::section;
+    case llvm::COFF::IMAGE_REL_I386_DIR32NB:
+      return DebugRelocKind::rva;
+    }
+    break;
+  case llvm::COFF::IMAGE_FILE_MACHINE_AMD64:
+    switch (type) {
+    case llvm::COFF::IMAGE_REL_AMD64_SECREL:
+      return DebugRelocKind::secRel;
+    case llvm::COFF::IMAGE_REL_AMD64_SECTION:
+      return DebugRelocKind::section;
+    case llvm::COFF::IMAGE_REL_AMD64_ADDR32NB:
+      return DebugRelocKind::rva;
+    }
+    break;
+  case llvm::COFF::IMAGE_FILE_MACHINE_ARMNT:
+    switch (type) {
+    case llvm::COFF::IMAGE_REL_ARM_SECREL:
+      return DebugRelocKind::secRel;
+    case llvm::COFF::IMAGE_REL_ARM_SECTION:
+      return DebugRelocKind::section;
+    case llvm::COFF::IMAGE_REL_ARM_ADDR32NB:
+      return DebugRelocKind::rva;
+    }
+    break;
+  }
+  return DebugRelocKind::unsupported;
+}
+
+/// Returns a copy of the .debug$S section \p sym with its relocations
+/// applied. A relocation whose target is not in the image, such as a
+/// discarded COMDAT function, is resolved to zero.
+std::vector<uint8_t>
+applyRelocations(const PECOFFLinkingContext::DebugSymbols &sym,
+                 const AtomAddressMap &atoms, uint16_t machine) {
+  std::vector<uint8_t> buf(sym.data.begin(), sym.data.end());
+  for (const PECOFFLinkingContext::DebugRelocation &rel : sym.relocations) {
+    DebugRelocKind kind = getDebugRelocKind(machine, rel.type);
+    uint32_t size = (kind == DebugRelocKind::section) ? 2 : 4;
+    if (kind == DebugRelocKind::unsupported ||
+        (uint64_t)rel.offset + size > buf.size())
+      continue;
+    uint8_t *p = &buf[rel.offset];
+    auto it = atoms.find(rel.target);
+    if (it == atoms.end()) {
+      memset(p, 0, size);
+      continue;
+    }
+    const AtomAddress &addr = it->second;
+    switch (kind) {
+    case DebugRelocKind::secRel:
+      write32le(p, read32le(p) + addr.sectionOffset);
+      break;
+    case DebugRelocKind::section:
+      write16le(p, read16le(p) + addr.section);
+      break;
+    case DebugRelocKind::rva:
+      write32le(p, read32le(p) + addr.rva);
+      break;
+    case DebugRelocKind::unsupported:
+      break;
+    }
+  }
+  return buf;
+}
+
+/// Calls \p fn with the kind and the contents of each subsection of the
+/// .debug$S section \p section.
+template <typename Fn>
+void forEachSubsection(ArrayRef<uint8_t> section, Fn fn) {
+  if (section.size() < 4 || read32le(section.data()) != cvSignatureC13)
+    return;
+  uint32_t off = 4;
+  while (off + 8 <= section.size()) {
+    uint32_t kind = read32le(section.data() + off);
+    uint32_t len = read32le(section.data() + off + 4);
+    if (len > section.size() - off - 8)
+      return;
+    if (!(kind & DEBUG_S_IGNORE))
+      fn(kind, section.slice(off + 8, len));
+    off = (off + 8 + len + 3) & ~3U;
+  }
+}
+
+/// The symbol stream of a module. File checksums refer to source file names
+/// by their offsets in the /names stream, which is created after the streams
+/// of all modules, so the positions of the name fields are listed in
+/// \p fileNames to be filled in later.
+struct ModuleStream {
+  std::vector<uint8_t> data;
+  uint32_t symbolBytes;
+  uint32_t c13Bytes;
+  std::vector<std::pair<uint32_t, StringRef>> fileNames;
+};
+
+/// ModuleStreamBuilder creates the symbol stream of a module from its
+/// relocated .debug$S sections. The stream has the symbol records, followed
+/// by the line tables and the other subsections in the C13 format.
+class ModuleStreamBuilder {
+public:
+  ModuleStreamBuilder(const IndexMap &map, const TypeTable &ids)
+      : _map(map), _ids(ids) {
+    StreamWriter(_symbols).u32(cvSignatureC13);
+  }
+
+  /// Adds a .debug$S section. \p strings is the string table of the object
+  /// file, which the file checksums refer to.
+  void addSection(ArrayRef<uint8_t> section, StringRef strings) {
+    forEachSubsection(section, [&](uint32_t kind, ArrayRef<uint8_t> data) {
+      if (kind == DEBUG_S_SYMBOLS)
+        addSymbols(data);
+      else if (kind != DEBUG_S_STRINGTABLE)
+        addSubsection(kind, data, strings);
+    });
+  }
+
+  ModuleStream finish() {
+    ModuleStream result;
+    result.symbolBytes = _symbols.size();
+    result.c13Bytes = _c13.size();
+    result.data = std::move(_symbols);
+    result.data.insert(result.data.end(), _c13.begin(), _c13.end());
+    StreamWriter(result.data).u32(0); // Global references
+    for (const auto &name : _fileNames)
+      result.fileNames.push_back(
+          std::make_pair(result.symbolBytes + name.first, name.second));
+    return result;
+  }
+
+private:
+  uint32_t remap(uint32_t ti, bool isId) const {
+    if (ti < firstNonSimpleIndex)
+      return ti;
+    const std::vector<uint32_t> &map = isId ? _map.ids : _map.types;
+    uint32_t local = ti - firstNonSimpleIndex;
+    return local < map.size() ? map[local] : 0;
+  }
+
+  /// Returns the function type of the LF_FUNC_ID or LF_MFUNC_ID record at
+  /// \p id in the ID table, or 0.
+  uint32_t getFunctionType(uint32_t id) const {
+    if (id < firstNonSimpleIndex ||
+        id - firstNonSimpleIndex >= _ids.offsets.size())
+      return 0;
+    ArrayRef<uint8_t> rec = getRecord(_ids, id);
+    uint16_t kind = read16le(rec.data() + 2);
+    if ((kind != LF_FUNC_ID && kind != LF_MFUNC_ID) || rec.size() < 12)
+      return 0;
+    return read32le(rec.data() + 8);
+  }
+
+  void addSymbols(ArrayRef<uint8_t> data) {
+    uint32_t off = 0;
+    while (off + 4 <= data.size()) {
+      uint32_t len = read16le(data.data() + off) + 2;
+      if (len < 4 || off + len > data.size())
+        return;
+      addSymbol(data.slice(off, len));
+      off += len;
+    }
+  }
+
+  void addSymbol(ArrayRef<uint8_t> rec) {
+    // Records in a symbol stream are 4-byte aligned.
+    uint32_t pos = _symbols.size();
+    StreamWriter w(_symbols);
+    w.bytes(rec.data(), rec.size());
+    w.align(4);
+    uint8_t *p = &_symbols[pos];
+    write16le(p, _symbols.size() - pos - 2);
+    forEachSymbolTypeIndex(rec, [&](uint32_t off, bool isId) {
+      write32le(p + off, remap(read32le(p + off), isId));
+    });
+
+    uint16_t kind = rec.size() >= 4 ? read16le(p + 2) : 0;
+    uint16_t outputKind = getOutputSymbolKind(kind);
+    if (outputKind != kind) {
+      write16le(p + 2, outputKind);
+      if (kind != S_PROC_ID_END && rec.size() >= 32)
+        write32le(p + 28, getFunctionType(read32le(p + 28)));
+    }
+
+    // The parent and the end of a scope are offsets in the symbol stream,
+    // which the compiler leaves zero.
+    if (opensScope(kind) && rec.size() >= 12) {
+      write32le(p + 4, _scopes.empty() ? 0 : _scopes.back());
+      write32le(p + 8, 0);
+      _scopes.push_back(pos);
+    } else if (closesScope(kind) && !_scopes.empty()) {
+      write32le(&_symbols[_scopes.back()] + 8, pos);
+      _scopes.pop_back();
+    }
+  }
+
+  void addSubsection(uint32_t kind, ArrayRef<uint8_t> data,
+                     StringRef strings) {
+    StreamWriter w(_c13);
+    w.u32(kind);
+    w.u32(data.size());
+    uint32_t pos = _c13.size();
+    w.bytes(data.data(), data.size());
+    w.align(4);
+    uint8_t *p = &_c13[pos];
+
+    if (kind == DEBUG_S_FILECHKSMS) {
+      // An entry has the offset of the file name in the string table, the
+      // size and the kind of the checksum, and the checksum.
+      uint32_t off = 0;
+      while (off + 6 <= data.size()) {
+        uint32_t nameOff = read32le(p + off);
+        StringRef name;
+        if (nameOff < strings.size())
+          name = strings.substr(nameOff);
+        _fileNames.push_back(
+            std::make_pair(pos + off, name.substr(0, name.find('\0'))));
+        off = (off + 6 + p[off + 4] + 3) & ~3U;
+      }
+    } else if (kind == DEBUG_S_INLINEELINES && data.size() >= 4) {
+      // An entry has the ID of the inlined function, the file and the line
+      // number. With signature 1, a list of extra files follows.
+      bool hasExtraFiles = read32le(p) == 1;
+      uint64_t off = 4;
+      while (off + 12 <= data.size()) {
+        write32le(p + off, remap(read32le(p + off), true));
+        off += 12;
+        if (!hasExtraFiles)
+          continue;
+        if (off + 4 > data.size())
+          break;
+        off += 4 + (uint64_t)read32le(p + off) * 4;
+      }
+    }
+  }
+
+  const IndexMap &_map;
+  const TypeTable &_ids;
+  std::vector<uint8_t> _symbols;
+  std::vector<uint8_t> _c13;
+  // The offsets of the records of the open scopes.
+  std::vector<uint32_t> _scopes;
+  // The offsets of the file name fields in _c13 and the names.
+  std::vector<std::pair<uint32_t, StringRef>> _fileNames;
+};
+
+ModuleStream createModuleStream(
+    const PECOFFLinkingContext::DebugSections &sections, const IndexMap &map,
+    const TypeTable &ids, const AtomAddressMap &atoms, uint16_t machine) {
+  // An object file has one string table for all its .debug$S sections.
+  StringRef strings;
+  for (const PECOFFLinkingContext::DebugSymbols &sym : sections.symbols)
+    forEachSubsection(sym.data, [&](uint32_t kind, ArrayRef<uint8_t> data) {
+      if (kind == DEBUG_S_STRINGTABLE && strings.empty())
+        strings = StringRef((const char *)data.data(), data.size());
+    });
+
+  ModuleStreamBuilder builder(map, ids);
+  for (const PECOFFLinkingContext::DebugSymbols &sym : sections.symbols)
+    builder.addSection(applyRelocations(sym, atoms, machine), strings);
+  return builder.finish();
+}
+
+// The string hash used by PDB hash tables.
+uint32_t hashStringV1(StringRef str) {
+  uint32_t result = 0;
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(str.data());
+  size_t size = str.size();
+  for (; size >= 4; p += 4, size -= 4)
+    result ^= read32le(p);
+  if (size >= 2) {
+    result ^= read16le(p);
+    p += 2;
+    size -= 2;
+  }
+  if (size == 1)
+    result ^= *p;
+  result |= 0x20202020;
+  result ^= (result >> 11);
+  return result ^ (result >> 16);
+}
+
+// CRC-32 without the final inversion, used to hash type records that have
+// no name. The table is built by the caller, before hashing in parallel.
+class JamCRC {
+public:
+  JamCRC() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : (c >> 1);
+      _table[i] = c;
+    }
+  }
+
+  uint32_t operator()(ArrayRef<uint8_t> data) const {
+    uint32_t crc = 0;
+    for (uint8_t b : data)
+      crc = _table[(crc ^ b) & 0xff] ^ (crc >> 8);
+    return crc;
+  }
+
+private:
+  uint32_t _table[256];
+};
+
+/// Returns the hash of a type record used for the TPI hash stream. User
+/// defined types are hashed by name so that a debugger can look them up.
+uint32_t hashTypeRecord(ArrayRef<uint8_t> rec, const JamCRC &jamCRC) {
+  const uint16_t fwdRef = 0x80;
+  const uint16_t scoped = 0x100;
+  const uint16_t hasUniqueName = 0x200;
+  uint16_t kind = read16le(rec.data() + 2);
+  uint32_t nameOff = 0;
+  switch (kind) {
+  case LF_CLASS:
+  case LF_STRUCTURE:
+  case LF_INTERFACE:
+    nameOff = 20 + getNumericLeafSize(rec, 20);
+    break;
+  case LF_UNION:
+    nameOff = 12 + getNumericLeafSize(rec, 12);
+    break;
+  case LF_ENUM:
+    nameOff = 16;
+    break;
+  case LF_UDT_SRC_LINE:
+  case LF_UDT_MOD_SRC_LINE:
+    return hashStringV1(StringRef((const char *)rec.data() + 4, 4));
+  default:
+    return jamCRC(rec);
+  }
+  if (nameOff >= rec.size())
+    return jamCRC(rec);
+  uint16_t props = read16le(rec.data() + 6);
+  StringRef name((const char *)rec.data() + nameOff,
+                 getStringSize(rec, nameOff));
+  name = name.substr(0, name.find('\0'));
+  bool anonymous = name == "<unnamed-tag>" || name == "__unnamed";
+  if (!(props & fwdRef) && !anonymous && (props & scoped) &&
+      (props & hasUniqueName)) {
+    uint32_t uniqueOff = nameOff + name.size() + 1;
+    StringRef unique((const char *)rec.data() + uniqueOff,
+                     getStringSize(rec, uniqueOff));
+    return hashStringV1(unique.substr(0, unique.find('\0')));
+  }
+  if (!(props & fwdRef) && anonymous)
+    return jamCRC(rec);
+  return hashStringV1(name);
+}
+
+std::vector<uint8_t> createInfoStream(const PDBInfo &info) {
+  std::vector<uint8_t> buf;
+  StreamWriter w(buf);
+  w.u32(pdbInfoVersionVC70);
+  w.u32(info.signature);
+  w.u32(info.age);
+  w.bytes(info.guid, sizeof(info.guid));
+  // The named stream map, which has the single entry "/names". It consists
+  // of a string buffer, and a hash table with its size, capacity, the
+  // present and deleted bit vectors, and the (name offset, stream) pairs of
+  // the present buckets. With a capacity of one, the entry is in bucket 0.
+  const char names[] = "/names";
+  w.u32(sizeof(names));
+  w.string(names);
+  w.u32(1); // Size
+  w.u32(1); // Capacity
+  w.u32(1); // Present bit vector: one word with bit 0 set
+  w.u32(1);
+  w.u32(0); // Deleted bit vector: no words
+  w.u32(0); // Offset of "/names"
+  w.u32(streamNames);
+  w.u32(pdbFeatureVC140);
+  return buf;
+}
+
+/// StringTableBuilder creates a string table. It is used for the /names
+/// stream, which other streams refer to by offset, and for the names of
+/// edit-and-continue files in the DBI stream. The empty string is at offset
+/// 0.
+class StringTableBuilder {
+public:
+  StringTableBuilder() : _buf(1, 0) {}
+
+  /// Adds \p str if it is not in the table yet, and returns its offset.
+  uint32_t add(StringRef str) {
+    if (str.empty())
+      return 0;
+    auto ins = _offsets.insert(std::make_pair(str, uint32_t(_buf.size())));
+    if (ins.second) {
+      _strings.push_back(ins.first->getKey());
+      _buf.insert(_buf.end(), str.begin(), str.end());
+      _buf.push_back(0);
+    }
+    return ins.first->second;
+  }
+
+  std::vector<uint8_t> build() const {
+    // The hash table maps the hash of a string to its offset. Collisions
+    // are resolved by linear probing, and empty buckets have offset 0.
+    uint32_t numBuckets = _strings.size() * 4 / 3 + 1;
+    std::vector<uint32_t> buckets(numBuckets);
+    for (StringRef str : _strings) {
+      uint32_t i = hashStringV1(str) % numBuckets;
+      while (buckets[i])
+        i = (i + 1) % numBuckets;
+      buckets[i] = _offsets.lookup(str);
+    }
+
+    std::vector<uint8_t> buf;
+    StreamWriter w(buf);
+    w.u32(stringTableSignature);
+    w.u32(stringTableHashVersion);
+    w.u32(_buf.size());
+    w.bytes(_buf.data(), _buf.size());
+    w.u32(numBuckets);
+    for (uint32_t offset : buckets)
+      w.u32(offset);
+    w.u32(_strings.size());
+    return buf;
+  }
+
+private:
+  llvm::StringMap<uint32_t> _offsets;
+  // The strings in the order they were added.
+  std::vector<StringRef> _strings;
+  std::vector<uint8_t> _buf;
+};
+
+void writeTPIHeader(StreamWriter &w, uint32_t numRecords, uint32_t recordBytes,
+                    uint16_t hashStream, uint32_t hashValueBytes,
+                    uint32_t indexOffsetBytes) {
+  w.u32(tpiVersionV80);
+  w.u32(tpiHeaderSize);
+  w.u32(firstNonSimpleIndex);
+  w.u32(firstNonSimpleIndex + numRecords);
+  w.u32(recordBytes);
+  w.u16(hashStream);
+  w.u16(invalidStream); // Aux hash stream
+  w.u32(4);             // Hash key size
+  w.u32(tpiNumHashBuckets);
+  w.u32(0); // Hash value buffer offset
+  w.u32(hashValueBytes);
+  w.u32(hashValueBytes); // Index offset buffer offset
+  w.u32(indexOffsetBytes);
+  w.u32(hashValueBytes + indexOffsetBytes); // Hash adjustment buffer offset
+  w.u32(0);
+}
+
+/// Creates the TPI or IPI stream for \p types, and its hash stream, whose
+/// stream number is \p hashStream.
+void createTPIStreams(const TypeTable &types, uint16_t hashStream,
+                      std::vector<uint8_t> &tpi, std::vector<uint8_t> &hash) {
+  size_t numRecords = types.offsets.size();
+
+  // Hash the records in parallel.
+  std::vector<uint32_t> hashes(numRecords);
+  std::vector<uint32_t> indices(numRecords);
+  JamCRC jamCRC;
+  for (size_t i = 0; i < numRecords; ++i)
+    indices[i] = i;
+  parallel_for_each(indices.begin(), indices.end(), [&](uint32_t i) {
+    uint32_t begin = types.offsets[i];
+    uint32_t end = (i + 1 == numRecords) ? types.records.size()
+                                         : types.offsets[i + 1];
+    ArrayRef<uint8_t> rec(types.records.data() + begin, end - begin);
+    hashes[i] = hashTypeRecord(rec, jamCRC) % tpiNumHashBuckets;
+  });
+
+  StreamWriter hw(hash);
+  for (uint32_t h : hashes)
+    hw.u32(h);
+  // The index offset buffer allows a reader to find a record by type index
+  // without scanning the whole stream. It has an entry every 8KB.
+  uint32_t hashValueBytes = hw.size();
+  uint32_t nextOffset = 0;
+  for (size_t i = 0; i < numRecords; ++i) {
+    if (types.offsets[i] < nextOffset)
+      continue;
+    hw.u32(firstNonSimpleIndex + i);
+    hw.u32(types.offsets[i]);
+    nextOffset = types.offsets[i] + 8192;
+  }
+  uint32_t indexOffsetBytes = hw.size() - hashValueBytes;
+
+  StreamWriter w(tpi);
+  writeTPIHeader(w, numRecords, types.records.size(), hashStream,
+                 hashValueBytes, indexOffsetBytes);
+  w.bytes(types.records.data(), types.records.size());
+}
+
+/// A range of an output section that was contributed by one module.
+struct SectionContrib {
+  uint16_t section;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t characteristics;
+  uint16_t module;
+};
+
+void writeSectionContrib(StreamWriter &w, const SectionContrib &sc) {
+  w.u16(sc.section);
+  w.u16(0);
+  w.u32(sc.offset);
+  w.u32(sc.size);
+  w.u32(sc.characteristics);
+  w.u16(sc.module);
+  w.u16(0);
+  w.u32(0); // Data CRC
+  w.u32(0); // Relocation CRC
+}
+
+/// Returns the section contributions of the modules in address order.
+/// Consecutive atoms of the same module are one contribution. Atoms created
+/// by the linker do not belong to any module.
+std::vector<SectionContrib>
+createSectionContribs(ArrayRef<PECOFFLinkingContext::DebugSections> modules,
+                      ArrayRef<OutputSection> sections) {
+  llvm::DenseMap<const File *, uint16_t> moduleIndex;
+  for (size_t i = 0, e = modules.size(); i < e; ++i)
+    if (modules[i].file)
+      moduleIndex[modules[i].file] = i;
+
+  std::vector<SectionContrib> result;
+  for (size_t i = 0, e = sections.size(); i < e; ++i) {
+    const OutputSection &sec = sections[i];
+    // True if the last contribution ends at the previous atom.
+    bool adjacent = false;
+    for (const auto &a : sec.atoms) {
+      const DefinedAtom *atom = a.first;
+      if (atom->size() == 0)
+        continue;
+      auto it = moduleIndex.find(&atom->file());
+      if (it == moduleIndex.end()) {
+        adjacent = false;
+        continue;
+      }
+      uint32_t offset = a.second - sec.header.VirtualAddress;
+      if (adjacent && result.back().module == it->second) {
+        result.back().size = offset + atom->size() - result.back().offset;
+        continue;
+      }
+      SectionContrib sc = {uint16_t(i + 1), offset, uint32_t(atom->size()),
+                           sec.header.Characteristics, it->second};
+      result.push_back(sc);
+      adjacent = true;
+    }
+  }
+  return result;
+}
+
+/// Creates the section map, which has an entry for each output section and
+/// one for absolute addresses.
+std::vector<uint8_t> createSectionMap(ArrayRef<OutputSection> sections) {
+  std::vector<uint8_t> buf;
+  StreamWriter w(buf);
+  w.u16(sections.size() + 1);
+  w.u16(sections.size() + 1);
+  for (size_t i = 0, e = sections.size(); i < e; ++i) {
+    uint32_t characteristics = sections[i].header.Characteristics;
+    uint16_t flags = secMapAddressIs32Bit | secMapIsSelector;
+    if (characteristics & llvm::COFF::IMAGE_SCN_MEM_READ)
+      flags |= secMapRead;
+    if (characteristics & llvm::COFF::IMAGE_SCN_MEM_WRITE)
+      flags |= secMapWrite;
+    if (characteristics & llvm::COFF::IMAGE_SCN_MEM_EXECUTE)
+      flags |= secMapExecute;
+    w.u16(flags);
+    w.u16(0);      // Overlay
+    w.u16(0);      // Group
+    w.u16(i + 1);  // Frame
+    w.u16(0xffff); // Section name
+    w.u16(0xffff); // Class name
+    w.u32(0);      // Offset
+    w.u32(sections[i].header.VirtualSize);
+  }
+  w.u16(secMapAddressIs32Bit | secMapIsAbsoluteAddress);
+  w.u16(0);
+  w.u16(0);
+  w.u16(sections.size() + 1);
+  w.u16(0xffff);
+  w.u16(0xffff);
+  w.u32(0);
+  w.u32(0xffffffff);
+  return buf;
+}
+
+/// Creates the file info substream of the DBI stream, which lists the source
+/// files of each module.
+std::vector<uint8_t> createFileInfo(ArrayRef<ModuleStream> streams) {
+  std::vector<uint8_t> names;
+  llvm::StringMap<uint32_t> nameOffsets;
+  std::vector<uint32_t> offsets;
+  for (const ModuleStream &stream : streams) {
+    for (const auto &name : stream.fileNames) {
+      auto ins = nameOffsets.insert(
+          std::make_pair(name.second, uint32_t(names.size())));
+      if (ins.second)
+        StreamWriter(names).string(name.second);
+      offsets.push_back(ins.first->second);
+    }
+  }
+
+  // The counts are 16-bit. Readers compute the number of files from the
+  // counts of the modules.
+  std::vector<uint8_t> buf;
+  StreamWriter w(buf);
+  w.u16(streams.size());
+  w.u16(offsets.size());
+  uint32_t first = 0;
+  for (const ModuleStream &stream : streams) {
+    w.u16(first);
+    first += stream.fileNames.size();
+  }
+  for (const ModuleStream &stream : streams)
+    w.u16(stream.fileNames.size());
+  for (uint32_t offset : offsets)
+    w.u32(offset);
+  w.bytes(names.data(), names.size());
+  w.align(4);
+  return buf;
+}
+
+/// Creates the DBI stream. It has a module info record for each module, the
+/// section contributions, the section map and the source files of each
+/// module.
+std::vector<uint8_t>
+createDBIStream(ArrayRef<PECOFFLinkingContext::DebugSections> modules,
+                ArrayRef<ModuleStream> streams,
+                ArrayRef<SectionContrib> contribs,
+                ArrayRef<OutputSection> sections, uint16_t machine,
+                uint32_t age) {
+  // A module info record has the first section contribution of the module.
+  std::vector<const SectionContrib *> firstContrib(modules.size());
+  for (const SectionContrib &sc : contribs)
+    if (!firstContrib[sc.module])
+      firstContrib[sc.module] = &sc;
+
+  std::vector<uint8_t> modInfo;
+  StreamWriter mw(modInfo);
+  for (size_t i = 0, e = modules.size(); i < e; ++i) {
+    mw.u32(0); // Unused
+    if (firstContrib[i]) {
+      writeSectionContrib(mw, *firstContrib[i]);
+    } else {
+      SectionContrib sc = {invalidStream, 0, 0, 0, uint16_t(i)};
+      writeSectionContrib(mw, sc);
+    }
+    mw.u16(0); // Flags
+    mw.u16(streamFirstModule + i);
+    mw.u32(streams[i].symbolBytes);
+    mw.u32(0); // C11 line info byte size
+    mw.u32(streams[i].c13Bytes);
+    mw.u16(streams[i].fileNames.size());
+    mw.u16(0);
+    mw.u32(0); // Unused
+    mw.u32(0); // Source file name index
+    mw.u32(0); // PDB file path name index
+    mw.string(modules[i].fileName);
+    mw.string(modules[i].fileName);
+    mw.align(4);
+  }
+
+  std::vector<uint8_t> sectionContrib;
+  StreamWriter cw(sectionContrib);
+  cw.u32(sectionContribVersion60);
+  for (const SectionContrib &sc : contribs)
+    writeSectionContrib(cw, sc);
+
+  std::vector<uint8_t> sectionMap = createSectionMap(sections);
+  std::vector<uint8_t> fileInfo = createFileInfo(streams);
+  std::vector<uint8_t> ecNames = StringTableBuilder().build();
+
+  std::vector<uint8_t> buf;
+  StreamWriter w(buf);
+  w.u32(0xffffffff); // Version signature
+  w.u32(dbiVersionV70);
+  w.u32(age);
+  w.u16(invalidStream); // Global symbol stream
+  w.u16(0x8e00);        // Build number; new format, toolchain 14.0
+  w.u16(invalidStream); // Public symbol stream
+  w.u16(0);             // PDB DLL version
+  w.u16(invalidStream); // Symbol record stream
+  w.u16(0);             // PDB DLL rebuild
+  w.u32(modInfo.size());
+  w.u32(sectionContrib.size());
+  w.u32(sectionMap.size());
+  w.u32(fileInfo.size());
+  w.u32(0); // Type server map size
+  w.u32(0); // MFC type server index
+  w.u32(numDebugStreams * 2);
+  w.u32(ecNames.size());
+  w.u16(0); // Flags
+  w.u16(machine);
+  w.u32(0);
+  assert(buf.size() == dbiHeaderSize);
+  w.bytes(modInfo.data(), modInfo.size());
+  w.bytes(sectionContrib.data(), sectionContrib.size());
+  w.bytes(sectionMap.data(), sectionMap.size());
+  w.bytes(fileInfo.data(), fileInfo.size());
+  w.bytes(ecNames.data(), ecNames.size());
+
+  // The optional debug header has the stream numbers of FPO data, section
+  // headers and so on. We write only the section headers, which debuggers
+  // use to convert section-relative addresses to RVAs.
+  for (uint32_t i = 0; i < numDebugStreams; ++i) {
+    if (i == debugStreamSectionHeaders)
+      w.u16(streamFirstModule + modules.size());
+    else
+      w.u16(invalidStream);
+  }
+  return buf;
+}
+
+bool isFreePageMapBlock(uint32_t block) {
+  uint32_t i = block % blockSize;
+  return i == 1 || i == 2;
+}
+
+} // end anonymous namespace
+
+uint32_t MSFBuilder::addStream(std::vector<uint8_t> data) {
+  _streams.push_back(std::move(data));
+  return _streams.size() - 1;
+}
+
+std::vector<uint8_t> MSFBuilder::build() const {
+  // Block 0 is the superblock and blocks 1 and 2 are the free page maps.
+  uint32_t nextBlock = 3;
+  auto allocate = [&]() {
+    while (isFreePageMapBlock(nextBlock))
+      ++nextBlock;
+    return nextBlock++;
+  };
+  auto numBlocksFor = [](uint64_t size) {
+    return (size + blockSize - 1) / blockSize;
+  };
+
+  std::vector<std::vector<uint32_t>> streamBlocks(_streams.size());
+  for (size_t i = 0, e = _streams.size(); i < e; ++i)
+    for (uint64_t j = 0, n = numBlocksFor(_streams[i].size()); j < n; ++j)
+      streamBlocks[i].push_back(allocate());
+
+  // The stream directory consists of the number of streams, the size of each
+  // stream and the block numbers of each stream.
+  std::vector<uint8_t> directory;
+  StreamWriter dw(directory);
+  dw.u32(_streams.size());
+  for (const std::vector<uint8_t> &stream : _streams)
+    dw.u32(stream.size());
+  for (const std::vector<uint32_t> &blocks : streamBlocks)
+    for (uint32_t block : blocks)
+      dw.u32(block);
+
+  std::vector<uint32_t> directoryBlocks;
+  for (uint64_t j = 0, n = numBlocksFor(directory.size()); j < n; ++j)
+    directoryBlocks.push_back(allocate());
+  // The block map lists the directory blocks. It must fit in one block.
+  assert(directoryBlocks.size() * 4 <= blockSize);
+  uint32_t blockMapAddr = allocate();
+  uint32_t numBlocks = nextBlock;
+
+  std::vector<uint8_t> buf((uint64_t)numBlocks * blockSize);
+  uint8_t *p = buf.data();
+  memcpy(p + superBlockMagic, msfMagic, sizeof(msfMagic));
+  write32le(p + superBlockBlockSize, blockSize);
+  write32le(p + superBlockFreeBlockMapBlock, 1);
+  write32le(p + superBlockNumBlocks, numBlocks);
+  write32le(p + superBlockNumDirectoryBytes, directory.size());
+  write32le(p + superBlockBlockMapAddr, blockMapAddr);
+
+  // All blocks in the file are in use. The free page map is split into the
+  // free page map blocks of each 4096-block interval; mark the bits beyond
+  // the end of the file as free in both maps.
+  for (uint32_t fpm = 1; fpm < numBlocks; fpm += blockSize) {
+    uint64_t firstBit = (uint64_t)(fpm / blockSize) * blockSize * 8;
+    for (uint32_t i = 0; i < blockSize * 8; ++i) {
+      if (firstBit + i < numBlocks)
+        continue;
+      uint32_t byte = i / 8;
+      p[(uint64_t)fpm * blockSize + byte] |= 1 << (i % 8);
+      p[(uint64_t)(fpm + 1) * blockSize + byte] |= 1 << (i % 8);
+    }
+  }
+
+  auto writeBlocks = [&](const std::vector<uint8_t> &data,
+                         const std::vector<uint32_t> &blocks) {
+    for (size_t j = 0, e = blocks.size(); j < e; ++j) {
+      size_t begin = j * blockSize;
+      size_t len = std::min<size_t>(blockSize, data.size() - begin);
+      memcpy(p + (uint64_t)blocks[j] * blockSize, data.data() + begin, len);
+    }
+  };
+  for (size_t i = 0, e = _streams.size(); i < e; ++i)
+    writeBlocks(_streams[i], streamBlocks[i]);
+  writeBlocks(directory, directoryBlocks);
+  for (size_t j = 0, e = directoryBlocks.size(); j < e; ++j)
+    write32le(p + (uint64_t)blockMapAddr * blockSize + j * 4,
+              directoryBlocks[j]);
+  return buf;
+}
+
+MergedTypes mergeTypes(ArrayRef<PECOFFLinkingContext::DebugSections> modules) {
+  std::vector<ModuleTypes> mods(modules.size());
+
+  // Read and hash the records of each module in parallel.
+  parallel_for_each(mods.begin(), mods.end(), [&](ModuleTypes &mod) {
+    const PECOFFLinkingContext::DebugSections &sections =
+        modules[&mod - &mods[0]];
+    mod.error = nullptr;
+    for (ArrayRef<uint8_t> section : sections.types) {
+      if (!readTypeRecords(section, mod.records)) {
+        mod.error = "unsupported type information";
+        return;
+      }
+    }
+    if (!computeHashes(mod))
+      mod.error = "malformed type information";
+  });
+
+  // Merge the records in link order.
+  MergedTypes result;
+  result.modules.resize(mods.size());
+  TypeTableBuilder builder(result);
+  for (size_t i = 0, e = mods.size(); i < e; ++i) {
+    if (mods[i].error) {
+      llvm::errs() << "lld warning: " << modules[i].fileName << ": "
+                   << mods[i].error << "; ignored\n";
+      continue;
+    }
+    result.modules[i] = builder.addModule(mods[i]);
+  }
+  return result;
+}
+
+std::vector<uint8_t>
+createPDB(ArrayRef<PECOFFLinkingContext::DebugSections> modules,
+          ArrayRef<OutputSection> sections, uint16_t machine, PDBInfo &info) {
+  MergedTypes merged = mergeTypes(modules);
+
+  std::vector<uint8_t> tpi, tpiHash, ipi, ipiHash;
+  createTPIStreams(merged.types, streamTPIHash, tpi, tpiHash);
+  createTPIStreams(merged.ids, streamIPIHash, ipi, ipiHash);
+
+  AtomAddressMap atoms;
+  for (size_t i = 0, e = sections.size(); i < e; ++i) {
+    const OutputSection &sec = sections[i];
+    for (const auto &a : sec.atoms) {
+      AtomAddress addr = {uint16_t(i + 1),
+                          a.second - sec.header.VirtualAddress, a.second};
+      atoms[a.first] = addr;
+    }
+  }
+
+  // Create the symbol streams of the modules in parallel.
+  std::vector<ModuleStream> streams(modules.size());
+  std::vector<uint32_t> indices(modules.size());
+  for (size_t i = 0, e = modules.size(); i < e; ++i)
+    indices[i] = i;
+  parallel_for_each(indices.begin(), indices.end(), [&](uint32_t i) {
+    streams[i] = createModuleStream(modules[i], merged.modules[i],
+                                    merged.ids, atoms, machine);
+  });
+
+  // Add the source file names to the /names stream in link order, and fill
+  // in their offsets in the file checksums.
+  StringTableBuilder names;
+  for (ModuleStream &stream : streams)
+    for (const auto &name : stream.fileNames)
+      write32le(&stream.data[name.first], names.add(name.second));
+
+  std::vector<SectionContrib> contribs =
+      createSectionContribs(modules, sections);
+  std::vector<uint8_t> dbi = createDBIStream(modules, streams, contribs,
+                                             sections, machine, info.age);
+
+  // The GUID is derived from the contents so that the same link produces
+  // the same PDB file.
+  llvm::hash_code hash = llvm::hash_combine_range(dbi.begin(), dbi.end());
+  for (const ModuleStream &stream : streams)
+    hash = llvm::hash_combine(
+        hash, llvm::hash_combine_range(stream.data.begin(), stream.data.end()));
+  write64le(info.guid, llvm::hash_combine(
+                           info.signature,
+                           llvm::hash_combine_range(tpi.begin(), tpi.end()),
+                           llvm::hash_combine_range(ipi.begin(), ipi.end())));
+  write64le(info.guid + 8, hash);
+
+  // The fixed streams are added in the order of their stream numbers, and
+  // are followed by the module streams and the section headers.
+  MSFBuilder msf;
+  msf.addStream(std::vector<uint8_t>());
+  msf.addStream(createInfoStream(info));
+  msf.addStream(std::move(tpi));
+  msf.addStream(std::move(dbi));
+  msf.addStream(std::move(ipi));
+  msf.addStream(std::move(tpiHash));
+  msf.addStream(std::move(ipiHash));
+  msf.addStream(names.build());
+  for (ModuleStream &stream : streams)
+    msf.addStream(std::move(stream.data));
+  std::vector<uint8_t> headers;
+  for (const OutputSection &sec : sections)
+    StreamWriter(headers).bytes(&sec.header, sizeof(sec.header));
+  msf.addStream(std::move(headers));
+  return msf.build();
+}
+
+std::error_code writePDB(StringRef path, ArrayRef<uint8_t> contents) {
+  std::unique_ptr<llvm::FileOutputBuffer> buffer;
+  if (std::error_code ec =
+          llvm::FileOutputBuffer::create(path, contents.size(), buffer))
+    return ec;
+  memcpy(buffer->getBufferStart(), contents.data(), contents.size());
+  return buffer->commit();
+}
+
+} // end namespace pdb
+} // end namespace pecoff
+} // end namespace lld
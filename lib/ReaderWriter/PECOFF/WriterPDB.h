@@ -0,0 +1,137 @@
+//===- lib/ReaderWriter/PECOFF/WriterPDB.h --------------------------------===//
+//
+//                             The LLVM Linker
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLD_READER_WRITER_PE_COFF_WRITER_PDB_H
+#define LLD_READER_WRITER_PE_COFF_WRITER_PDB_H
+
+#include "lld/Core/DefinedAtom.h"
+#include "lld/Core/LLVM.h"
+#include "lld/ReaderWriter/PECOFFLinkingContext.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Object/COFF.h"
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+namespace lld {
+namespace pecoff {
+namespace pdb {
+
+/// The block size of the MSF container.
+const uint32_t blockSize = 4096;
+
+/// The stream numbers of the streams we write to a PDB file. The symbol
+/// streams of the modules start at streamFirstModule, and are followed by
+/// the section header stream.
+enum StreamIndex : uint32_t {
+  streamOldDirectory = 0,
+  streamPDBInfo = 1,
+  streamTPI = 2,
+  streamDBI = 3,
+  streamIPI = 4,
+  streamTPIHash = 5,
+  streamIPIHash = 6,
+  streamNames = 7,
+  streamFirstModule = 8
+};
+
+/// The offsets of the fields in the MSF superblock.
+enum SuperBlockOffset : uint32_t {
+  superBlockMagic = 0,
+  superBlockBlockSize = 32,
+  superBlockFreeBlockMapBlock = 36,
+  superBlockNumBlocks = 40,
+  superBlockNumDirectoryBytes = 44,
+  superBlockBlockMapAddr = 52,
+  superBlockSize = 56
+};
+
+extern const char msfMagic[32];
+
+/// MSFBuilder lays out streams in a Multi-Stream File, which is the container
+/// format of PDB files. An MSF file is a sequence of fixed-size blocks. The
+/// first block is the superblock, blocks 1 and 2 of every 4096 blocks are
+/// free page maps, and the stream directory describes which blocks belong
+/// to which stream.
+class MSFBuilder {
+public:
+  /// Adds a stream and returns its stream number.
+  uint32_t addStream(std::vector<uint8_t> data);
+
+  /// Returns the MSF file image.
+  std::vector<uint8_t> build() const;
+
+private:
+  std::vector<std::vector<uint8_t>> _streams;
+};
+
+/// A table of merged type or ID records.
+struct TypeTable {
+  /// Concatenated records. The first record has index 0x1000.
+  std::vector<uint8_t> records;
+  /// The offset of each record in \p records.
+  std::vector<uint32_t> offsets;
+};
+
+/// Maps the type indices of a module to the indices in the merged tables.
+struct IndexMap {
+  /// The index of each record of the module in the type table, or 0 if the
+  /// record is not a type record.
+  std::vector<uint32_t> types;
+  /// The same for the ID table.
+  std::vector<uint32_t> ids;
+};
+
+/// The result of type merging. Type records go to the TPI stream and ID
+/// records, such as LF_FUNC_ID and LF_STRING_ID, go to the IPI stream. The
+/// two tables have separate index spaces.
+struct MergedTypes {
+  TypeTable types;
+  TypeTable ids;
+  /// The index map of each module. It is empty if the type information of
+  /// the module was ignored.
+  std::vector<IndexMap> modules;
+};
+
+/// An output section of the image and the atoms in it.
+struct OutputSection {
+  llvm::object::coff_section header;
+  /// The atoms and their RVAs, in address order.
+  std::vector<std::pair<const DefinedAtom *, uint32_t>> atoms;
+};
+
+/// The values that identify a PDB file. The CodeView entry in the debug
+/// directory of the image has the same GUID and age, which is how a debugger
+/// checks that the PDB file belongs to the image.
+struct PDBInfo {
+  uint32_t signature;
+  uint32_t age;
+  uint8_t guid[16];
+};
+
+/// Merges the records in the given .debug$T sections into a type table and
+/// an ID table. Indices in the records are rewritten, and structurally
+/// identical records are emitted only once.
+MergedTypes mergeTypes(ArrayRef<PECOFFLinkingContext::DebugSections> modules);
+
+/// Creates the contents of a PDB file for an image with the given sections.
+/// The signature and the age are taken from \p info, and the GUID, which is
+/// derived from the contents, is stored to \p info.
+std::vector<uint8_t>
+createPDB(ArrayRef<PECOFFLinkingContext::DebugSections> modules,
+          ArrayRef<OutputSection> sections, uint16_t machine, PDBInfo &info);
+
+/// Writes the contents of a PDB file to \p path.
+std::error_code writePDB(StringRef path, ArrayRef<uint8_t> contents);
+
+} // end namespace pdb
+} // end namespace pecoff
+} // end namespace lld
+
+#endif
@@ -20,13 +20,18 @@
 //===----------------------------------------------------------------------===//
 
 #include "Atoms.h"
+#include "Checksum.h"
 #include "WriterImportLibrary.h"
+#include "WriterPDB.h"
 #include "lld/Core/DefinedAtom.h"
 #include "lld/Core/File.h"
 #include "lld/Core/Writer.h"
 #include "lld/ReaderWriter/AtomLayout.h"
 #include "lld/ReaderWriter/PECOFFLinkingContext.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Object/COFF.h"
 #include "llvm/Support/COFF.h"
 #include "llvm/Support/Debug.h"
@@ -34,10 +39,11 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include <algorithm>
+#include <cstddef>
 #include <cstdlib>
-#include <map>
 #include <time.h>
 #include <vector>
 
@@ -58,9 +64,23 @@ namespace pecoff {
 // file.
 static const int SECTOR_SIZE = 512;
 
+// The size of an IMAGE_DEBUG_DIRECTORY entry, and the size of the header of
+// the CodeView record that the entry points to, which precedes the path of
+// the PDB file.
+static const uint32_t DEBUG_DIRECTORY_SIZE = 28;
+static const uint32_t CODEVIEW_HEADER_SIZE = 24;
+
+// IMAGE_DEBUG_TYPE_CODEVIEW.
+static const uint32_t DEBUG_TYPE_CODEVIEW = 2;
+
 namespace {
 class SectionChunk;
 
+/// The map from atom to its relative virtual address. It is filled once
+/// before relocations are applied and only read afterwards, so it can be
+/// shared by the parallel relocation workers without locking.
+typedef llvm::DenseMap<const Atom *, uint64_t> AtomRvaMap;
+
 /// A Chunk is an abstract contiguous range in an output file.
 class Chunk {
 public:
@@ -160,6 +180,16 @@ public:
     _coffHeader.PointerToSymbolTable = rva;
   }
 
+  // Returns the file offsets of the TimeDateStamp and CheckSum fields.
+  uint64_t timeDateStampOffset() const {
+    return fileOffset() + sizeof(llvm::COFF::PEMagic) +
+           offsetof(llvm::object::coff_file_header, TimeDateStamp);
+  }
+  uint64_t checkSumOffset() const {
+    return fileOffset() + sizeof(llvm::COFF::PEMagic) + sizeof(_coffHeader) +
+           offsetof(PEHeader, CheckSum);
+  }
+
 private:
   llvm::object::coff_file_header _coffHeader;
   PEHeader _peHeader;
@@ -174,9 +204,9 @@ public:
   uint64_t size() const override;
   void write(uint8_t *buffer) override;
 
-private:
   static llvm::object::coff_section createSectionHeader(SectionChunk *chunk);
 
+private:
   std::vector<SectionChunk *> _sections;
 };
 
@@ -278,20 +308,28 @@ public:
 
   uint64_t memAlign() const override;
   void appendAtom(const DefinedAtom *atom);
-  void buildAtomRvaMap(std::map<const Atom *, uint64_t> &atomRva) const;
-
-  void applyRelocationsARM(uint8_t *buffer,
-                           std::map<const Atom *, uint64_t> &atomRva,
-                           std::vector<uint64_t> &sectionRva,
-                           uint64_t imageBaseAddress);
-  void applyRelocationsX86(uint8_t *buffer,
-                           std::map<const Atom *, uint64_t> &atomRva,
-                           std::vector<uint64_t> &sectionRva,
-                           uint64_t imageBaseAddress);
-  void applyRelocationsX64(uint8_t *buffer,
-                           std::map<const Atom *, uint64_t> &atomRva,
-                           std::vector<uint64_t> &sectionRva,
-                           uint64_t imageBaseAddress);
+  size_t numAtoms() const { return _atomLayouts.size(); }
+  void buildAtomRvaMap(AtomRvaMap &atomRva) const;
+
+  const std::vector<AtomLayout *> &atomLayouts() const {
+    return _atomLayouts;
+  }
+
+  // Apply the relocations of the atom at \p layout, which must be one of
+  // this chunk's atoms. These functions are called for all atoms of all
+  // chunks in parallel.
+  void applyRelocationsARM(uint8_t *buffer, const AtomLayout *layout,
+                           const AtomRvaMap &atomRva,
+                           const std::vector<uint64_t> &sectionRva,
+                           uint64_t imageBaseAddress) const;
+  void applyRelocationsX86(uint8_t *buffer, const AtomLayout *layout,
+                           const AtomRvaMap &atomRva,
+                           const std::vector<uint64_t> &sectionRva,
+                           uint64_t imageBaseAddress) const;
+  void applyRelocationsX64(uint8_t *buffer, const AtomLayout *layout,
+                           const AtomRvaMap &atomRva,
+                           const std::vector<uint64_t> &sectionRva,
+                           uint64_t imageBaseAddress) const;
 
   void printAtomAddresses(uint64_t baseAddr) const;
   void addBaseRelocations(std::vector<BaseReloc> &relocSites) const;
@@ -321,6 +359,26 @@ private:
   const PECOFFLinkingContext &_ctx;
 };
 
+/// A DebugDirectoryAtom is the debug directory of the image, which has one
+/// CodeView entry, followed by the CodeView record that the entry points to.
+/// The record has the GUID, the age and the path of the PDB file. The atom
+/// is created by the writer, and its contents are written after the PDB file
+/// is created.
+class DebugDirectoryAtom : public COFFLinkerInternalAtom {
+public:
+  DebugDirectoryAtom(const File &file, StringRef pdbPath)
+      : COFFLinkerInternalAtom(file, 0, std::vector<uint8_t>(
+                                            DEBUG_DIRECTORY_SIZE +
+                                            CODEVIEW_HEADER_SIZE +
+                                            pdbPath.size() + 1)) {}
+
+  SectionChoice sectionChoice() const override { return sectionCustomRequired; }
+  StringRef customSectionName() const override { return ".rdata"; }
+  ContentType contentType() const override { return typeData; }
+  ContentPermissions permissions() const override { return permR__; }
+  Alignment alignment() const override { return 4; }
+};
+
 /// A DataDirectoryChunk represents data directory entries that follows the PE
 /// header in the output file. An entry consists of an 8 byte field that
 /// indicates a relative virtual address (the starting address of the entry data
@@ -378,13 +436,12 @@ private:
   std::vector<uint8_t> createContents(ChunkVectorT &chunks) const;
 
   // Returns a list of RVAs that needs to be relocated if the binary is loaded
-  // at an address different from its preferred one.
+  // at an address different from its preferred one, grouped by page.
   std::vector<BaseReloc> listRelocSites(ChunkVectorT &chunks) const;
 
-  // Create the content of a relocation block.
-  std::vector<uint8_t>
-  createBaseRelocBlock(uint64_t pageAddr, const BaseReloc *begin,
-                       const BaseReloc *end) const;
+  // Write a relocation block to \p buffer.
+  void writeBaseRelocBlock(uint8_t *buffer, uint64_t pageAddr,
+                           const BaseReloc *begin, const BaseReloc *end) const;
 
   const PECOFFLinkingContext &_ctx;
   std::vector<uint8_t> _contents;
@@ -399,7 +456,10 @@ PEHeaderChunk<PEHeader>::PEHeaderChunk(const PECOFFLinkingContext &ctx)
   std::memset(&_peHeader, 0, sizeof(_peHeader));
 
   _coffHeader.Machine = ctx.getMachineType();
-  _coffHeader.TimeDateStamp = time(nullptr);
+  // With /brepro, the timestamp is set to a hash of the image after the
+  // image is written. See PECOFFWriter::writeFile.
+  if (!ctx.isReproducible())
+    _coffHeader.TimeDateStamp = time(nullptr);
 
   // Attributes of the executable.
   uint16_t characteristics = llvm::COFF::IMAGE_FILE_EXECUTABLE_IMAGE;
@@ -537,31 +597,35 @@ void AtomChunk::write(uint8_t *buffer) {
 }
 
 // Add all atoms to the given map. This data will be used to do relocation.
-void
-AtomChunk::buildAtomRvaMap(std::map<const Atom *, uint64_t> &atomRva) const {
+void AtomChunk::buildAtomRvaMap(AtomRvaMap &atomRva) const {
   for (const auto *layout : _atomLayouts)
     atomRva[layout->_atom] = layout->_virtualAddr;
 }
 
+// Returns the RVA of the given atom, or 0 if the atom is not in any section
+// (e.g. an absolute atom). The map must not be modified here because this
+// function is called from parallel relocation workers.
+static uint64_t getAtomRva(const AtomRvaMap &atomRva, const Atom *atom) {
+  return atomRva.lookup(atom);
+}
+
+// sectionRva is sorted in ascending order because sections are laid out in
+// the order they were added, so the section lookups can use binary search.
 static int getSectionIndex(uint64_t targetAddr,
                            const std::vector<uint64_t> &sectionRva) {
-  int i = 1;
-  for (uint64_t rva : sectionRva) {
-    if (targetAddr < rva)
-      return i;
-    ++i;
-  }
-  return i;
+  auto it = std::upper_bound(sectionRva.begin(), sectionRva.end(), targetAddr);
+  return (it - sectionRva.begin()) + 1;
 }
 
 static uint32_t getSectionStartAddr(uint64_t targetAddr,
                                     const std::vector<uint64_t> &sectionRva) {
-  // Scan the list of section start addresses to find the section start address
-  // for the given RVA.
-  for (int i = 0, e = sectionRva.size(); i < e; ++i)
-    if (i == e - 1 || (sectionRva[i] <= targetAddr && targetAddr < sectionRva[i + 1]))
-      return sectionRva[i];
-  llvm_unreachable("Section missing");
+  // Find the last section that starts at or before the given RVA. An address
+  // below the first section is attributed to the last section.
+  assert(!sectionRva.empty() && "Section missing");
+  auto it = std::upper_bound(sectionRva.begin(), sectionRva.end(), targetAddr);
+  if (it == sectionRva.begin())
+    return sectionRva.back();
+  return *(it - 1);
 }
 
 static void applyThumbMoveImmediate(ulittle16_t *mov, uint16_t imm) {
@@ -593,175 +657,169 @@ static void applyThumbBranchImmediate(ulittle16_t *bl, int32_t imm) {
   bl[1] = bl[1] | (((imm & 0x00000ffe) >>  1) << 0) | (J2 << 11) | (J1 << 13);
 }
 
-void AtomChunk::applyRelocationsARM(uint8_t *Buffer,
-                                    std::map<const Atom *, uint64_t> &AtomRVA,
-                                    std::vector<uint64_t> &SectionRVA,
-                                    uint64_t ImageBase) {
+void AtomChunk::applyRelocationsARM(uint8_t *Buffer, const AtomLayout *layout,
+                                    const AtomRvaMap &AtomRVA,
+                                    const std::vector<uint64_t> &SectionRVA,
+                                    uint64_t ImageBase) const {
   Buffer = Buffer + _fileOffset;
-  parallel_for_each(_atomLayouts.begin(), _atomLayouts.end(),
-                    [&](const AtomLayout *layout) {
-    const DefinedAtom *Atom = cast<DefinedAtom>(layout->_atom);
-    for (const Reference *R : *Atom) {
-      if (R->kindNamespace() != Reference::KindNamespace::COFF)
-        continue;
+  const DefinedAtom *Atom = cast<DefinedAtom>(layout->_atom);
+  const uint64_t AtomAddr = layout->_virtualAddr;
+  for (const Reference *R : *Atom) {
+    if (R->kindNamespace() != Reference::KindNamespace::COFF)
+      continue;
 
-      bool AssumeTHUMBCode = false;
-      if (auto Target = dyn_cast<DefinedAtom>(R->target()))
-        AssumeTHUMBCode = Target->permissions() == DefinedAtom::permR_X ||
-                          Target->permissions() == DefinedAtom::permRWX;
-
-      const auto AtomOffset = R->offsetInAtom();
-      const auto FileOffset = layout->_fileOffset;
-      const auto TargetAddr = AtomRVA[R->target()] | (AssumeTHUMBCode ? 1 : 0);
-      auto RelocSite16 =
-          reinterpret_cast<ulittle16_t *>(Buffer + FileOffset + AtomOffset);
-      auto RelocSite32 =
-          reinterpret_cast<ulittle32_t *>(Buffer + FileOffset + AtomOffset);
-
-      switch (R->kindValue()) {
-      default: llvm_unreachable("unsupported relocation type");
-      case llvm::COFF::IMAGE_REL_ARM_ADDR32:
-        *RelocSite32 = *RelocSite32 + TargetAddr + ImageBase;
-        break;
-      case llvm::COFF::IMAGE_REL_ARM_ADDR32NB:
-        *RelocSite32 = *RelocSite32 + TargetAddr;
-        break;
-      case llvm::COFF::IMAGE_REL_ARM_MOV32T:
-        applyThumbMoveImmediate(&RelocSite16[0], (TargetAddr + ImageBase) >>  0);
-        applyThumbMoveImmediate(&RelocSite16[2], (TargetAddr + ImageBase) >> 16);
-        break;
-      case llvm::COFF::IMAGE_REL_ARM_BRANCH24T:
-        // NOTE: the thumb bit will implicitly be truncated properly
-        applyThumbBranchImmediate(RelocSite16,
-                                  TargetAddr - AtomRVA[Atom] - AtomOffset - 4);
-        break;
-      case llvm::COFF::IMAGE_REL_ARM_BLX23T:
-        // NOTE: the thumb bit will implicitly be truncated properly
-        applyThumbBranchImmediate(RelocSite16,
-                                  TargetAddr - AtomRVA[Atom] - AtomOffset - 4);
-        break;
-      }
+    bool AssumeTHUMBCode = false;
+    if (auto Target = dyn_cast<DefinedAtom>(R->target()))
+      AssumeTHUMBCode = Target->permissions() == DefinedAtom::permR_X ||
+                        Target->permissions() == DefinedAtom::permRWX;
+
+    const auto AtomOffset = R->offsetInAtom();
+    const auto FileOffset = layout->_fileOffset;
+    const auto TargetAddr =
+        getAtomRva(AtomRVA, R->target()) | (AssumeTHUMBCode ? 1 : 0);
+    auto RelocSite16 =
+        reinterpret_cast<ulittle16_t *>(Buffer + FileOffset + AtomOffset);
+    auto RelocSite32 =
+        reinterpret_cast<ulittle32_t *>(Buffer + FileOffset + AtomOffset);
+
+    switch (R->kindValue()) {
+    default: llvm_unreachable("unsupported relocation type");
+    case llvm::COFF::IMAGE_REL_ARM_ADDR32:
+      *RelocSite32 = *RelocSite32 + TargetAddr + ImageBase;
+      break;
+    case llvm::COFF::IMAGE_REL_ARM_ADDR32NB:
+      *RelocSite32 = *RelocSite32 + TargetAddr;
+      break;
+    case llvm::COFF::IMAGE_REL_ARM_MOV32T:
+      applyThumbMoveImmediate(&RelocSite16[0], (TargetAddr + ImageBase) >>  0);
+      applyThumbMoveImmediate(&RelocSite16[2], (TargetAddr + ImageBase) >> 16);
+      break;
+    case llvm::COFF::IMAGE_REL_ARM_BRANCH24T:
+      // NOTE: the thumb bit will implicitly be truncated properly
+      applyThumbBranchImmediate(RelocSite16,
+                                TargetAddr - AtomAddr - AtomOffset - 4);
+      break;
+    case llvm::COFF::IMAGE_REL_ARM_BLX23T:
+      // NOTE: the thumb bit will implicitly be truncated properly
+      applyThumbBranchImmediate(RelocSite16,
+                                TargetAddr - AtomAddr - AtomOffset - 4);
+      break;
     }
-  });
+  }
 }
 
-void AtomChunk::applyRelocationsX86(uint8_t *buffer,
-                                    std::map<const Atom *, uint64_t> &atomRva,
-                                    std::vector<uint64_t> &sectionRva,
-                                    uint64_t imageBaseAddress) {
+void AtomChunk::applyRelocationsX86(uint8_t *buffer, const AtomLayout *layout,
+                                    const AtomRvaMap &atomRva,
+                                    const std::vector<uint64_t> &sectionRva,
+                                    uint64_t imageBaseAddress) const {
   buffer += _fileOffset;
-  parallel_for_each(_atomLayouts.begin(), _atomLayouts.end(),
-                    [&](const AtomLayout *layout) {
-    const DefinedAtom *atom = cast<DefinedAtom>(layout->_atom);
-    for (const Reference *ref : *atom) {
-      // Skip if this reference is not for COFF relocation.
-      if (ref->kindNamespace() != Reference::KindNamespace::COFF)
-        continue;
-      auto relocSite32 = reinterpret_cast<ulittle32_t *>(
-          buffer + layout->_fileOffset + ref->offsetInAtom());
-      auto relocSite16 = reinterpret_cast<ulittle16_t *>(relocSite32);
-      const Atom *target = ref->target();
-      uint64_t targetAddr = atomRva[target];
-      // Also account for whatever offset is already stored at the relocation
-      // site.
-      switch (ref->kindValue()) {
-      case llvm::COFF::IMAGE_REL_I386_ABSOLUTE:
-        // This relocation is no-op.
-        break;
-      case llvm::COFF::IMAGE_REL_I386_DIR32:
-        // Set target's 32-bit VA.
-        if (auto *abs = dyn_cast<AbsoluteAtom>(target))
-          *relocSite32 += abs->value();
-        else
-          *relocSite32 += targetAddr + imageBaseAddress;
-        break;
-      case llvm::COFF::IMAGE_REL_I386_DIR32NB:
-        // Set target's 32-bit RVA.
-        *relocSite32 += targetAddr;
-        break;
-      case llvm::COFF::IMAGE_REL_I386_REL32: {
-        // Set 32-bit relative address of the target. This relocation is
-        // usually used for relative branch or call instruction.
-        uint32_t disp = atomRva[atom] + ref->offsetInAtom() + 4;
-        *relocSite32 += targetAddr - disp;
-        break;
-      }
-      case llvm::COFF::IMAGE_REL_I386_SECTION:
-        // The 16-bit section index that contains the target symbol.
-        *relocSite16 += getSectionIndex(targetAddr, sectionRva);
-        break;
-      case llvm::COFF::IMAGE_REL_I386_SECREL:
-        // The 32-bit relative address from the beginning of the section that
-        // contains the target symbol.
-        *relocSite32 +=
-            targetAddr - getSectionStartAddr(targetAddr, sectionRva);
-        break;
-      default:
-        llvm::report_fatal_error("Unsupported relocation kind");
-      }
+  const DefinedAtom *atom = cast<DefinedAtom>(layout->_atom);
+  for (const Reference *ref : *atom) {
+    // Skip if this reference is not for COFF relocation.
+    if (ref->kindNamespace() != Reference::KindNamespace::COFF)
+      continue;
+    auto relocSite32 = reinterpret_cast<ulittle32_t *>(
+        buffer + layout->_fileOffset + ref->offsetInAtom());
+    auto relocSite16 = reinterpret_cast<ulittle16_t *>(relocSite32);
+    const Atom *target = ref->target();
+    uint64_t targetAddr = getAtomRva(atomRva, target);
+    // Also account for whatever offset is already stored at the relocation
+    // site.
+    switch (ref->kindValue()) {
+    case llvm::COFF::IMAGE_REL_I386_ABSOLUTE:
+      // This relocation is no-op.
+      break;
+    case llvm::COFF::IMAGE_REL_I386_DIR32:
+      // Set target's 32-bit VA.
+      if (auto *abs = dyn_cast<AbsoluteAtom>(target))
+        *relocSite32 += abs->value();
+      else
+        *relocSite32 += targetAddr + imageBaseAddress;
+      break;
+    case llvm::COFF::IMAGE_REL_I386_DIR32NB:
+      // Set target's 32-bit RVA.
+      *relocSite32 += targetAddr;
+      break;
+    case llvm::COFF::IMAGE_REL_I386_REL32: {
+      // Set 32-bit relative address of the target. This relocation is
+      // usually used for relative branch or call instruction.
+      uint32_t disp = layout->_virtualAddr + ref->offsetInAtom() + 4;
+      *relocSite32 += targetAddr - disp;
+      break;
     }
-  });
+    case llvm::COFF::IMAGE_REL_I386_SECTION:
+      // The 16-bit section index that contains the target symbol.
+      *relocSite16 += getSectionIndex(targetAddr, sectionRva);
+      break;
+    case llvm::COFF::IMAGE_REL_I386_SECREL:
+      // The 32-bit relative address from the beginning of the section that
+      // contains the target symbol.
+      *relocSite32 +=
+          targetAddr - getSectionStartAddr(targetAddr, sectionRva);
+      break;
+    default:
+      llvm::report_fatal_error("Unsupported relocation kind");
+    }
+  }
 }
 
-void AtomChunk::applyRelocationsX64(uint8_t *buffer,
-                                    std::map<const Atom *, uint64_t> &atomRva,
-                                    std::vector<uint64_t> &sectionRva,
-                                    uint64_t imageBase) {
+void AtomChunk::applyRelocationsX64(uint8_t *buffer, const AtomLayout *layout,
+                                    const AtomRvaMap &atomRva,
+                                    const std::vector<uint64_t> &sectionRva,
+                                    uint64_t imageBase) const {
   buffer += _fileOffset;
-  parallel_for_each(_atomLayouts.begin(), _atomLayouts.end(),
-                    [&](const AtomLayout *layout) {
-    const DefinedAtom *atom = cast<DefinedAtom>(layout->_atom);
-    for (const Reference *ref : *atom) {
-      if (ref->kindNamespace() != Reference::KindNamespace::COFF)
-        continue;
-
-      uint8_t *loc = buffer + layout->_fileOffset + ref->offsetInAtom();
-      auto relocSite16 = reinterpret_cast<ulittle16_t *>(loc);
-      auto relocSite32 = reinterpret_cast<ulittle32_t *>(loc);
-      auto relocSite64 = reinterpret_cast<ulittle64_t *>(loc);
-      uint64_t targetAddr = atomRva[ref->target()];
+  const DefinedAtom *atom = cast<DefinedAtom>(layout->_atom);
+  uint64_t atomAddr = layout->_virtualAddr;
+  for (const Reference *ref : *atom) {
+    if (ref->kindNamespace() != Reference::KindNamespace::COFF)
+      continue;
 
-      switch (ref->kindValue()) {
-      case llvm::COFF::IMAGE_REL_AMD64_ADDR64:
-        *relocSite64 += targetAddr + imageBase;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_ADDR32:
-        *relocSite32 += targetAddr + imageBase;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_ADDR32NB:
-        *relocSite32 += targetAddr;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 4;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32_1:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 5;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32_2:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 6;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32_3:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 7;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32_4:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 8;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_REL32_5:
-        *relocSite32 += targetAddr - atomRva[atom] - ref->offsetInAtom() - 9;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_SECTION:
-        *relocSite16 += getSectionIndex(targetAddr, sectionRva) - 1;
-        break;
-      case llvm::COFF::IMAGE_REL_AMD64_SECREL:
-        *relocSite32 +=
-            targetAddr - getSectionStartAddr(targetAddr, sectionRva);
-        break;
-      default:
-        llvm::errs() << "Kind: " << (int)ref->kindValue() << "\n";
-        llvm::report_fatal_error("Unsupported relocation kind");
-      }
+    uint8_t *loc = buffer + layout->_fileOffset + ref->offsetInAtom();
+    auto relocSite16 = reinterpret_cast<ulittle16_t *>(loc);
+    auto relocSite32 = reinterpret_cast<ulittle32_t *>(loc);
+    auto relocSite64 = reinterpret_cast<ulittle64_t *>(loc);
+    uint64_t targetAddr = getAtomRva(atomRva, ref->target());
+
+    switch (ref->kindValue()) {
+    case llvm::COFF::IMAGE_REL_AMD64_ADDR64:
+      *relocSite64 += targetAddr + imageBase;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_ADDR32:
+      *relocSite32 += targetAddr + imageBase;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_ADDR32NB:
+      *relocSite32 += targetAddr;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 4;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32_1:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 5;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32_2:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 6;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32_3:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 7;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32_4:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 8;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_REL32_5:
+      *relocSite32 += targetAddr - atomAddr - ref->offsetInAtom() - 9;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_SECTION:
+      *relocSite16 += getSectionIndex(targetAddr, sectionRva) - 1;
+      break;
+    case llvm::COFF::IMAGE_REL_AMD64_SECREL:
+      *relocSite32 +=
+          targetAddr - getSectionStartAddr(targetAddr, sectionRva);
+      break;
+    default:
+      llvm::errs() << "Kind: " << (int)ref->kindValue() << "\n";
+      llvm::report_fatal_error("Unsupported relocation kind");
     }
-  });
+  }
 }
 
 /// Print atom VAs. Used only for debugging.
@@ -957,19 +1015,24 @@ SectionHeaderTableChunk::createSectionHeader(SectionChunk *chunk) {
 /// the base relocation. A block consists of a 32 bit page RVA and 16 bit
 /// relocation entries which represent offsets in the page. That is a more
 /// compact representation than a simple vector of 32 bit RVAs.
+///
+/// Blocks are found with one linear scan over the relocation sites, which
+/// gives the size and offset of each block, and then written to the result
+/// in parallel.
 std::vector<uint8_t>
 BaseRelocChunk::createContents(ChunkVectorT &chunks) const {
-  std::vector<uint8_t> contents;
   std::vector<BaseReloc> relocSites = listRelocSites(chunks);
 
+  // Base relocations for the same memory page are grouped together.
+  struct Block {
+    uint64_t pageAddr;
+    const BaseReloc *begin;
+    const BaseReloc *end;
+    uint32_t offset;
+  };
+  std::vector<Block> blocks;
   uint64_t mask = _ctx.getPageSize() - 1;
-  parallel_sort(relocSites.begin(), relocSites.end(),
-                [=](const BaseReloc &a, const BaseReloc &b) {
-                  return (a.addr & ~mask) < (b.addr & ~mask);
-                });
-
-  // Base relocations for the same memory page are grouped together
-  // and passed to createBaseRelocBlock.
+  uint32_t size = 0;
   for (auto it = relocSites.begin(), e = relocSites.end(); it != e;) {
     auto beginIt = it;
     uint64_t pageAddr = (beginIt->addr & ~mask);
@@ -978,35 +1041,67 @@ BaseRelocChunk::createContents(ChunkVectorT &chunks) const {
         break;
     const BaseReloc *begin = &*beginIt;
     const BaseReloc *end = begin + (it - beginIt);
-    std::vector<uint8_t> block = createBaseRelocBlock(pageAddr, begin, end);
-    contents.insert(contents.end(), block.begin(), block.end());
+    blocks.push_back(Block{pageAddr, begin, end, size});
+    // Relocation blocks should be padded with IMAGE_REL_I386_ABSOLUTE to be
+    // aligned to a DWORD size boundary.
+    size += llvm::RoundUpToAlignment(
+        sizeof(ulittle32_t) * 2 + sizeof(ulittle16_t) * (end - begin),
+        sizeof(ulittle32_t));
   }
+
+  std::vector<uint8_t> contents(size);
+  parallel_for_each(blocks.begin(), blocks.end(), [&](const Block &b) {
+    writeBaseRelocBlock(&contents[b.offset], b.pageAddr, b.begin, b.end);
+  });
   return contents;
 }
 
 // Returns a list of RVAs that needs to be relocated if the binary is loaded
-// at an address different from its preferred one.
+// at an address different from its preferred one. Sections are visited in
+// parallel. Sections are laid out in ascending address order, and so are the
+// atoms in a section, so the result only needs to be sorted by page within a
+// section if an atom's references are out of order.
 std::vector<BaseReloc>
 BaseRelocChunk::listRelocSites(ChunkVectorT &chunks) const {
-  std::vector<BaseReloc> ret;
+  struct SectionRelocs {
+    explicit SectionRelocs(const AtomChunk *c) : chunk(c) {}
+    const AtomChunk *chunk;
+    std::vector<BaseReloc> sites;
+  };
+  std::vector<SectionRelocs> sections;
   for (auto &cp : chunks)
     if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp))
-      chunk->addBaseRelocations(ret);
+      sections.push_back(SectionRelocs(chunk));
+
+  uint64_t mask = _ctx.getPageSize() - 1;
+  auto byPage = [=](const BaseReloc &a, const BaseReloc &b) {
+    return (a.addr & ~mask) < (b.addr & ~mask);
+  };
+  parallel_for_each(sections.begin(), sections.end(), [&](SectionRelocs &s) {
+    s.chunk->addBaseRelocations(s.sites);
+    if (!std::is_sorted(s.sites.begin(), s.sites.end(), byPage))
+      std::stable_sort(s.sites.begin(), s.sites.end(), byPage);
+  });
+
+  size_t numSites = 0;
+  for (const SectionRelocs &s : sections)
+    numSites += s.sites.size();
+  std::vector<BaseReloc> ret;
+  ret.reserve(numSites);
+  for (const SectionRelocs &s : sections)
+    ret.insert(ret.end(), s.sites.begin(), s.sites.end());
   return ret;
 }
 
-// Create the content of a relocation block.
-std::vector<uint8_t>
-BaseRelocChunk::createBaseRelocBlock(uint64_t pageAddr,
-                                     const BaseReloc *begin,
-                                     const BaseReloc *end) const {
-  // Relocation blocks should be padded with IMAGE_REL_I386_ABSOLUTE to be
-  // aligned to a DWORD size boundary.
+// Write a relocation block. \p buffer must be large enough for the block
+// and zero-filled, so that the padding entry is IMAGE_REL_BASED_ABSOLUTE.
+void BaseRelocChunk::writeBaseRelocBlock(uint8_t *buffer, uint64_t pageAddr,
+                                         const BaseReloc *begin,
+                                         const BaseReloc *end) const {
   uint32_t size = llvm::RoundUpToAlignment(
       sizeof(ulittle32_t) * 2 + sizeof(ulittle16_t) * (end - begin),
       sizeof(ulittle32_t));
-  std::vector<uint8_t> contents(size);
-  uint8_t *ptr = &contents[0];
+  uint8_t *ptr = buffer;
 
   // The first four bytes is the page RVA.
   write32le(ptr, pageAddr);
@@ -1022,7 +1117,6 @@ BaseRelocChunk::createBaseRelocBlock(uint64_t pageAddr,
     write16le(ptr, (i->type << 12) | (i->addr & mask));
     ptr += sizeof(ulittle16_t);
   }
-  return contents;
 }
 
 } // end anonymous namespace
@@ -1031,7 +1125,8 @@ class PECOFFWriter : public Writer {
 public:
   explicit PECOFFWriter(const PECOFFLinkingContext &context)
       : _ctx(context), _numSections(0), _imageSizeInMemory(_ctx.getPageSize()),
-        _imageSizeOnDisk(0) {}
+        _imageSizeOnDisk(0), _timeDateStampOffset(0), _checkSumOffset(0),
+        _debugDirectoryOffset(0) {}
 
   template <class PEHeader> void build(const File &linkedFile);
   std::error_code writeFile(const File &linkedFile, StringRef path) override;
@@ -1042,6 +1137,8 @@ private:
   void reorderSEHTableEntries(uint8_t *bufferStart);
   void reorderSEHTableEntriesX86(uint8_t *bufferStart);
   void reorderSEHTableEntriesX64(uint8_t *bufferStart);
+  std::vector<pdb::OutputSection> getOutputSections() const;
+  void writeDebugDirectory(uint8_t *bufferStart, const pdb::PDBInfo &info);
 
   void addChunk(Chunk *chunk);
   void addSectionChunk(std::unique_ptr<SectionChunk> chunk,
@@ -1077,8 +1174,19 @@ private:
   // the output file with paddings between them.
   uint32_t _imageSizeOnDisk;
 
+  // The file offsets of the TimeDateStamp and CheckSum fields, which are
+  // filled after the image is written.
+  uint64_t _timeDateStampOffset;
+  uint64_t _checkSumOffset;
+
+  // The debug directory if /DEBUG is given, its file offset, and the
+  // absolute path of the PDB file that it refers to.
+  std::unique_ptr<DebugDirectoryAtom> _debugDirectory;
+  uint64_t _debugDirectoryOffset;
+  std::string _pdbFilePath;
+
   // The map from atom to its relative virtual address.
-  std::map<const Atom *, uint64_t> _atomRva;
+  AtomRvaMap _atomRva;
 };
 
 StringRef customSectionName(const DefinedAtom *atom) {
@@ -1108,23 +1216,89 @@ StringRef chooseSectionByContent(const DefinedAtom *atom) {
   llvm::report_fatal_error("Failed to choose section based on content");
 }
 
-typedef std::map<StringRef, std::vector<const DefinedAtom *> > AtomVectorMap;
+/// A list of output section names and their atoms.
+typedef std::vector<std::pair<StringRef, std::vector<const DefinedAtom *>>>
+    AtomVectorList;
 
-void groupAtoms(const PECOFFLinkingContext &ctx, const File &file,
-                AtomVectorMap &result) {
-  for (const DefinedAtom *atom : file.defined()) {
-    if (atom->sectionChoice() == DefinedAtom::sectionCustomRequired) {
-      StringRef section = customSectionName(atom);
-      result[ctx.getOutputSectionName(section)].push_back(atom);
-      continue;
+namespace {
+/// The atoms of a contiguous range of the linked file, grouped by output
+/// section name in the order the names first appear.
+struct AtomGroup {
+  typedef File::AtomVector<DefinedAtom>::const_iterator Iterator;
+  AtomGroup(Iterator b, Iterator e) : begin(b), end(e) {}
+  Iterator begin;
+  Iterator end;
+  llvm::StringMap<unsigned> index;
+  AtomVectorList sections;
+};
+} // end anonymous namespace
+
+static StringRef getInputSectionName(const DefinedAtom *atom) {
+  if (atom->sectionChoice() == DefinedAtom::sectionCustomRequired)
+    return customSectionName(atom);
+  if (atom->sectionChoice() == DefinedAtom::sectionBasedOnContent)
+    return chooseSectionByContent(atom);
+  llvm_unreachable("Unknown section choice");
+}
+
+static void groupAtomRange(const PECOFFLinkingContext &ctx, AtomGroup &group) {
+  // Atoms from the same input section are usually adjacent, so the output
+  // section name is computed only when the input section name changes.
+  StringRef lastName;
+  std::vector<const DefinedAtom *> *atoms = nullptr;
+  for (auto it = group.begin; it != group.end; ++it) {
+    const DefinedAtom *atom = *it;
+    StringRef name = getInputSectionName(atom);
+    if (!atoms || name != lastName) {
+      lastName = name;
+      StringRef section = ctx.getOutputSectionName(name);
+      auto ins = group.index.insert(
+          std::make_pair(section, unsigned(group.sections.size())));
+      if (ins.second)
+        group.sections.push_back(
+            std::make_pair(section, std::vector<const DefinedAtom *>()));
+      atoms = &group.sections[ins.first->second].second;
     }
-    if (atom->sectionChoice() == DefinedAtom::sectionBasedOnContent) {
-      StringRef section = chooseSectionByContent(atom);
-      result[ctx.getOutputSectionName(section)].push_back(atom);
-      continue;
+    atoms->push_back(atom);
+  }
+}
+
+/// Groups atoms by output section name. The result is sorted by section
+/// name, and atoms in each section are in the same order as in the file.
+/// Ranges of atoms are grouped in parallel and then merged in file order.
+void groupAtoms(const PECOFFLinkingContext &ctx, const File &file,
+                AtomVectorList &result) {
+  const File::AtomVector<DefinedAtom> &defined = file.defined();
+  const size_t rangeSize = 16384;
+  std::vector<AtomGroup> groups;
+  for (size_t i = 0, e = defined.size(); i < e; i += rangeSize)
+    groups.push_back(AtomGroup(defined.begin() + i,
+                               defined.begin() + std::min(i + rangeSize, e)));
+  parallel_for_each(groups.begin(), groups.end(), [&](AtomGroup &group) {
+    groupAtomRange(ctx, group);
+  });
+
+  llvm::StringMap<unsigned> index;
+  for (AtomGroup &group : groups) {
+    for (auto &section : group.sections) {
+      auto ins = index.insert(std::make_pair(section.first,
+                                             unsigned(result.size())));
+      if (ins.second) {
+        result.push_back(std::move(section));
+        continue;
+      }
+      std::vector<const DefinedAtom *> &atoms =
+          result[ins.first->second].second;
+      atoms.insert(atoms.end(), section.second.begin(), section.second.end());
     }
-    llvm_unreachable("Unknown section choice");
   }
+
+  // Only the distinct section names need to be sorted.
+  std::sort(result.begin(), result.end(),
+            [](const AtomVectorList::value_type &a,
+               const AtomVectorList::value_type &b) {
+    return a.first < b.first;
+  });
 }
 
 static const DefinedAtom *findTLSUsedSymbol(const PECOFFLinkingContext &ctx,
@@ -1139,9 +1313,26 @@ static const DefinedAtom *findTLSUsedSymbol(const PECOFFLinkingContext &ctx,
 // Create all chunks that consist of the output file.
 template <class PEHeader>
 void PECOFFWriter::build(const File &linkedFile) {
-  AtomVectorMap atoms;
+  AtomVectorList atoms;
   groupAtoms(_ctx, linkedFile, atoms);
 
+  // If /DEBUG is given, the debug directory is added to the end of .rdata,
+  // keeping the section list sorted by name.
+  if (_ctx.getDebug()) {
+    SmallString<128> path(_ctx.getPDBFilePath());
+    llvm::sys::fs::make_absolute(path);
+    _pdbFilePath = path.str();
+    _debugDirectory.reset(new DebugDirectoryAtom(linkedFile, _pdbFilePath));
+    StringRef name = _ctx.getOutputSectionName(".rdata");
+    auto it = std::lower_bound(atoms.begin(), atoms.end(), name,
+                               [](const AtomVectorList::value_type &a,
+                                  StringRef b) { return a.first < b; });
+    if (it == atoms.end() || it->first != name)
+      it = atoms.insert(
+          it, std::make_pair(name, std::vector<const DefinedAtom *>()));
+    it->second.push_back(_debugDirectory.get());
+  }
+
   // Create file chunks and add them to the list.
   auto *dosStub = new DOSStubChunk(_ctx);
   auto *peHeader = new PEHeaderChunk<PEHeader>(_ctx);
@@ -1155,7 +1346,7 @@ void PECOFFWriter::build(const File &linkedFile) {
   addChunk(stringTable);
 
   // Create sections and add the atoms to them.
-  for (auto i : atoms) {
+  for (auto &i : atoms) {
     StringRef sectionName = i.first;
     std::vector<const DefinedAtom *> &contents = i.second;
     std::unique_ptr<SectionChunk> section(
@@ -1164,7 +1355,14 @@ void PECOFFWriter::build(const File &linkedFile) {
       addSectionChunk(std::move(section), sectionTable, stringTable);
   }
 
-  // Build atom to its RVA map.
+  // Build atom to its RVA map. DenseMap grows once it is 3/4 full, so the
+  // buckets are reserved with that headroom to avoid rehashing while the map
+  // is being filled.
+  size_t numAtoms = 0;
+  for (std::unique_ptr<Chunk> &cp : _chunks)
+    if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp))
+      numAtoms += chunk->numAtoms();
+  _atomRva.resize(numAtoms * 4 / 3 + 1);
   for (std::unique_ptr<Chunk> &cp : _chunks)
     if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp))
       chunk->buildAtomRvaMap(_atomRva);
@@ -1184,6 +1382,17 @@ void PECOFFWriter::build(const File &linkedFile) {
 
   setImageSizeOnDisk();
 
+  if (_debugDirectory) {
+    dataDirectory->setField(DataDirectoryIndex::DEBUG,
+                            getAtomRva(_atomRva, _debugDirectory.get()),
+                            DEBUG_DIRECTORY_SIZE);
+    for (std::unique_ptr<Chunk> &cp : _chunks)
+      if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp))
+        for (const AtomLayout *layout : chunk->atomLayouts())
+          if (layout->_atom == _debugDirectory.get())
+            _debugDirectoryOffset = chunk->fileOffset() + layout->_fileOffset;
+  }
+
   if (stringTable->size()) {
     peHeader->setPointerToSymbolTable(stringTable->fileOffset());
     peHeader->setNumberOfSymbols(1);
@@ -1236,8 +1445,8 @@ void PECOFFWriter::build(const File &linkedFile) {
   }
 
   if (const DefinedAtom *atom = findTLSUsedSymbol(_ctx, linkedFile)) {
-    dataDirectory->setField(DataDirectoryIndex::TLS_TABLE, _atomRva[atom],
-                            0x18);
+    dataDirectory->setField(DataDirectoryIndex::TLS_TABLE,
+                            getAtomRva(_atomRva, atom), 0x18);
   }
 
   // Now that we know the size and file offset of sections. Set the file
@@ -1248,6 +1457,9 @@ void PECOFFWriter::build(const File &linkedFile) {
   peHeader->setNumberOfSections(_numSections);
   peHeader->setSizeOfImage(_imageSizeInMemory);
   peHeader->setSizeOfHeaders(sectionTable->fileOffset() + sectionTable->size());
+
+  _timeDateStampOffset = peHeader->timeDateStampOffset();
+  _checkSumOffset = peHeader->checkSumOffset();
 }
 
 std::error_code PECOFFWriter::writeFile(const File &linkedFile,
@@ -1266,14 +1478,49 @@ std::error_code PECOFFWriter::writeFile(const File &linkedFile,
   if (ec)
     return ec;
 
-  for (std::unique_ptr<Chunk> &chunk : _chunks)
-    chunk->write(buffer->getBufferStart() + chunk->fileOffset());
-  applyAllRelocations(buffer->getBufferStart());
-  reorderSEHTableEntries(buffer->getBufferStart());
+  // Chunks occupy disjoint ranges of the output file, so they can be written
+  // in parallel.
+  uint8_t *bufferStart = buffer->getBufferStart();
+  parallel_for_each(_chunks.begin(), _chunks.end(),
+                    [&](std::unique_ptr<Chunk> &chunk) {
+    chunk->write(bufferStart + chunk->fileOffset());
+  });
+  applyAllRelocations(bufferStart);
+  reorderSEHTableEntries(bufferStart);
   DEBUG(printAllAtomAddresses());
 
+  // The PDB file is created after layout, because symbol records and line
+  // tables refer to the addresses of atoms. The debug directory has the GUID
+  // of the PDB file.
+  std::vector<uint8_t> pdbContents;
+  if (_debugDirectory) {
+    pdb::PDBInfo info;
+    info.signature = _ctx.isReproducible() ? 0 : time(nullptr);
+    info.age = 1;
+    pdbContents = pdb::createPDB(_ctx.getDebugSections(), getOutputSections(),
+                                 _ctx.getMachineType(), info);
+    writeDebugDirectory(bufferStart, info);
+  }
+
+  // The timestamp and the checksum are computed from the rest of the image,
+  // so they are written last. The checksum covers the timestamp, which is
+  // also in the debug directory.
+  ArrayRef<uint8_t> image(bufferStart, totalSize);
+  if (_ctx.isReproducible())
+    write32le(bufferStart + _timeDateStampOffset, computeImageHash(image));
+  if (_debugDirectory)
+    write32le(bufferStart + _debugDirectoryOffset + 4,
+              read32le(bufferStart + _timeDateStampOffset));
+  if (_ctx.getChecksumEnabled())
+    write32le(bufferStart + _checkSumOffset, computePEChecksum(image));
+
   if (_ctx.isDll())
-    writeImportLibrary(_ctx);
+    if (std::error_code ec = writeImportLibrary(_ctx))
+      return ec;
+
+  if (_debugDirectory)
+    if (std::error_code ec = pdb::writePDB(_ctx.getPDBFilePath(), pdbContents))
+      return ec;
 
   return buffer->commit();
 }
@@ -1290,23 +1537,35 @@ void PECOFFWriter::applyAllRelocations(uint8_t *bufferStart) {
     if (SectionChunk *section = dyn_cast<SectionChunk>(&*cp))
       sectionRva.push_back(section->getVirtualAddress());
 
+  // Flatten the atoms of all chunks into one list, so that the work is
+  // evenly distributed even if one section is much larger than the others.
+  typedef std::pair<const AtomChunk *, const AtomLayout *> ChunkAtom;
+  std::vector<ChunkAtom> atoms;
+  atoms.reserve(_atomRva.size());
+  for (auto &cp : _chunks)
+    if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp))
+      for (const AtomLayout *layout : chunk->atomLayouts())
+        atoms.push_back(std::make_pair(chunk, layout));
+
   uint64_t base = _ctx.getBaseAddress();
-  for (auto &cp : _chunks) {
-    if (AtomChunk *chunk = dyn_cast<AtomChunk>(&*cp)) {
-      switch (_ctx.getMachineType()) {
-      default: llvm_unreachable("unsupported machine type");
-      case llvm::COFF::IMAGE_FILE_MACHINE_ARMNT:
-        chunk->applyRelocationsARM(bufferStart, _atomRva, sectionRva, base);
-        break;
-      case llvm::COFF::IMAGE_FILE_MACHINE_I386:
-        chunk->applyRelocationsX86(bufferStart, _atomRva, sectionRva, base);
-        break;
-      case llvm::COFF::IMAGE_FILE_MACHINE_AMD64:
-        chunk->applyRelocationsX64(bufferStart, _atomRva, sectionRva, base);
-        break;
-      }
+  llvm::COFF::MachineTypes machine = _ctx.getMachineType();
+  parallel_for_each(atoms.begin(), atoms.end(), [&](const ChunkAtom &a) {
+    switch (machine) {
+    default: llvm_unreachable("unsupported machine type");
+    case llvm::COFF::IMAGE_FILE_MACHINE_ARMNT:
+      a.first->applyRelocationsARM(bufferStart, a.second, _atomRva,
+                                   sectionRva, base);
+      break;
+    case llvm::COFF::IMAGE_FILE_MACHINE_I386:
+      a.first->applyRelocationsX86(bufferStart, a.second, _atomRva,
+                                   sectionRva, base);
+      break;
+    case llvm::COFF::IMAGE_FILE_MACHINE_AMD64:
+      a.first->applyRelocationsX64(bufferStart, a.second, _atomRva,
+                                   sectionRva, base);
+      break;
     }
-  }
+  });
 }
 
 /// Print atom VAs. Used only for debugging.
@@ -1336,7 +1595,7 @@ void PECOFFWriter::reorderSEHTableEntriesX86(uint8_t *bufferStart) {
         int numEntries = section->size() / sizeof(ulittle32_t);
         ulittle32_t *begin = reinterpret_cast<ulittle32_t *>(bufferStart + section->fileOffset());
         ulittle32_t *end = begin + numEntries;
-        std::sort(begin, end);
+        parallel_sort(begin, end);
       }
     }
   }
@@ -1353,14 +1612,56 @@ void PECOFFWriter::reorderSEHTableEntriesX64(uint8_t *bufferStart) {
       coff_runtime_function_x64 *begin =
           (coff_runtime_function_x64 *)(bufferStart + section->fileOffset());
       coff_runtime_function_x64 *end = begin + numEntries;
-      std::sort(begin, end, [](const coff_runtime_function_x64 &lhs,
-                               const coff_runtime_function_x64 &rhs) {
+      parallel_sort(begin, end, [](const coff_runtime_function_x64 &lhs,
+                                   const coff_runtime_function_x64 &rhs) {
         return lhs.BeginAddress < rhs.BeginAddress;
       });
     }
   }
 }
 
+/// Returns the output sections and their atoms in the order of the section
+/// table.
+std::vector<pdb::OutputSection> PECOFFWriter::getOutputSections() const {
+  std::vector<pdb::OutputSection> result;
+  for (auto &cp : _chunks) {
+    SectionChunk *chunk = dyn_cast<SectionChunk>(&*cp);
+    if (!chunk)
+      continue;
+    pdb::OutputSection section;
+    section.header = SectionHeaderTableChunk::createSectionHeader(chunk);
+    if (AtomChunk *atomChunk = dyn_cast<AtomChunk>(chunk))
+      for (const AtomLayout *layout : atomChunk->atomLayouts())
+        section.atoms.push_back(std::make_pair(
+            cast<DefinedAtom>(layout->_atom), layout->_virtualAddr));
+    result.push_back(std::move(section));
+  }
+  return result;
+}
+
+/// Writes the debug directory and the CodeView record, which refers to the
+/// PDB file. The time stamp is written with the one in the file header.
+void PECOFFWriter::writeDebugDirectory(uint8_t *bufferStart,
+                                       const pdb::PDBInfo &info) {
+  uint8_t *p = bufferStart + _debugDirectoryOffset;
+  uint32_t rva = getAtomRva(_atomRva, _debugDirectory.get());
+  write32le(p, 0);      // Characteristics
+  write32le(p + 4, 0);  // TimeDateStamp
+  write16le(p + 8, 0);  // MajorVersion
+  write16le(p + 10, 0); // MinorVersion
+  write32le(p + 12, DEBUG_TYPE_CODEVIEW);
+  write32le(p + 16, CODEVIEW_HEADER_SIZE + _pdbFilePath.size() + 1);
+  write32le(p + 20, rva + DEBUG_DIRECTORY_SIZE);
+  write32le(p + 24, _debugDirectoryOffset + DEBUG_DIRECTORY_SIZE);
+
+  // The PDB 7.0 format CodeView record.
+  uint8_t *record = p + DEBUG_DIRECTORY_SIZE;
+  memcpy(record, "RSDS", 4);
+  memcpy(record + 4, info.guid, sizeof(info.guid));
+  write32le(record + 20, info.age);
+  memcpy(record + 24, _pdbFilePath.data(), _pdbFilePath.size());
+}
+
 void PECOFFWriter::addChunk(Chunk *chunk) {
   _chunks.push_back(std::unique_ptr<Chunk>(chunk));
 }
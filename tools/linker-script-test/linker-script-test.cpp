@@ -14,20 +14,70 @@
 
 #include "lld/ReaderWriter/LinkerScript.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include <chrono>
 
 using namespace llvm;
 using namespace lld;
 using namespace script;
 
+static cl::opt<std::string> inputFile(cl::Positional,
+                                      cl::desc("<input file>"),
+                                      cl::init("-"));
+
+static cl::opt<unsigned>
+    lexRepeat("lex-repeat",
+              cl::desc("Only lex the input the given number of times, and "
+                       "print the number of tokens and the throughput"),
+              cl::init(0));
+
+/// Lexes the input lexRepeat times. The token count is deterministic, so it
+/// can be checked by tests; the throughput is informational.
+static int lexOnly(const MemoryBuffer &input) {
+  uint64_t numTokens = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < lexRepeat; ++i) {
+    Lexer l(MemoryBuffer::getMemBuffer(input.getBuffer(),
+                                       input.getBufferIdentifier(), false));
+    Token tok;
+    for (l.lex(tok); tok._kind != Token::eof; l.lex(tok)) {
+      if (tok._kind == Token::unknown) {
+        llvm::errs() << "unknown token: " << tok._range << "\n";
+        return 1;
+      }
+      ++numTokens;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double megabytes = double(input.getBufferSize()) * lexRepeat / (1 << 20);
+  llvm::outs() << "tokens: " << numTokens << "\n";
+  llvm::outs() << "throughput: "
+               << format("%.2f", megabytes / elapsed.count()) << " MB/s\n";
+  return 0;
+}
+
 int main(int argc, const char **argv) {
   llvm::sys::PrintStackTraceOnErrorSignal();
   llvm::PrettyStackTraceProgram X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "linker script parser tester\n");
+
+  if (lexRepeat) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> mb =
+        MemoryBuffer::getFileOrSTDIN(inputFile);
+    if (std::error_code ec = mb.getError()) {
+      llvm::errs() << ec.message() << "\n";
+      return 1;
+    }
+    return lexOnly(*mb.get());
+  }
 
   {
     ErrorOr<std::unique_ptr<MemoryBuffer>> mb =
-        MemoryBuffer::getFileOrSTDIN(argv[1]);
+        MemoryBuffer::getFileOrSTDIN(inputFile);
     if (std::error_code ec = mb.getError()) {
       llvm::errs() << ec.message() << "\n";
       return 1;
@@ -43,7 +93,7 @@ int main(int argc, const char **argv) {
   }
   {
     ErrorOr<std::unique_ptr<MemoryBuffer>> mb =
-        MemoryBuffer::getFileOrSTDIN(argv[1]);
+        MemoryBuffer::getFileOrSTDIN(inputFile);
     if (std::error_code ec = mb.getError()) {
       llvm::errs() << ec.message() << "\n";
       return 1;
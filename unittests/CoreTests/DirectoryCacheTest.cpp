@@ -0,0 +1,88 @@
+//===- lld/unittest/CoreTests/DirectoryCacheTest.cpp ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief DirectoryCache.h unit tests.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "lld/Core/DirectoryCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace lld;
+
+namespace {
+
+/// A temporary directory with a few empty files, removed at the end of the
+/// test.
+class TempDir {
+public:
+  explicit TempDir(const std::vector<std::string> &files) : _files(files) {
+    EXPECT_FALSE(llvm::sys::fs::createUniqueDirectory("dircache", _path));
+    for (const std::string &file : _files) {
+      std::error_code ec;
+      llvm::raw_fd_ostream os(path(file), ec, llvm::sys::fs::F_None);
+      EXPECT_FALSE(ec);
+    }
+  }
+
+  ~TempDir() {
+    for (const std::string &file : _files)
+      llvm::sys::fs::remove(path(file));
+    llvm::sys::fs::remove(_path);
+  }
+
+  std::string path() const { return _path.str(); }
+
+  std::string path(StringRef file) const {
+    SmallString<128> result = _path;
+    llvm::sys::path::append(result, file);
+    return result.str();
+  }
+
+private:
+  llvm::SmallString<128> _path;
+  std::vector<std::string> _files;
+};
+
+} // end anonymous namespace
+
+TEST(DirectoryCache, Exists) {
+  TempDir dir({"libfoo.a", "libbar.so"});
+  DirectoryCache cache;
+  EXPECT_TRUE(cache.exists(dir.path("libfoo.a")));
+  EXPECT_TRUE(cache.exists(dir.path("libbar.so")));
+  EXPECT_FALSE(cache.exists(dir.path("libbaz.a")));
+  EXPECT_FALSE(cache.exists(dir.path("missing/libfoo.a")));
+  EXPECT_TRUE(cache.exists(dir.path()));
+
+  // A name that differs only in case is in the listing, and the stat decides
+  // whether the file system treats it as the same file.
+  EXPECT_EQ(llvm::sys::fs::exists(dir.path("LIBFOO.A")),
+            cache.exists(dir.path("LIBFOO.A")));
+}
+
+TEST(DirectoryCache, ListDirectories) {
+  TempDir first({"libfoo.a"});
+  TempDir second({"libbar.a"});
+  DirectoryCache cache;
+  std::vector<std::string> dirs = {first.path(), second.path() + "/",
+                                   first.path("missing")};
+  cache.listDirectories(dirs);
+  cache.listDirectories(dirs);
+  EXPECT_TRUE(cache.exists(first.path("libfoo.a")));
+  EXPECT_FALSE(cache.exists(first.path("libbar.a")));
+  EXPECT_TRUE(cache.exists(second.path("libbar.a")));
+  EXPECT_FALSE(cache.exists(second.path("libfoo.a")));
+  EXPECT_FALSE(cache.exists(first.path("missing/libfoo.a")));
+}
@@ -0,0 +1,83 @@
+//===- lld/unittest/CoreTests/FilePrefetcherTest.cpp ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief FilePrefetcher.h unit tests.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "lld/Core/FilePrefetcher.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace lld;
+
+namespace {
+
+/// A temporary file that is removed at the end of the test.
+class TempFile {
+public:
+  explicit TempFile(StringRef contents) {
+    int fd;
+    EXPECT_FALSE(
+        llvm::sys::fs::createTemporaryFile("prefetch", "o", fd, _path));
+    llvm::raw_fd_ostream os(fd, /*shouldClose*/ true);
+    os << contents;
+  }
+
+  ~TempFile() { llvm::sys::fs::remove(_path); }
+
+  std::string path() const { return _path.str(); }
+
+private:
+  llvm::SmallString<128> _path;
+};
+
+} // end anonymous namespace
+
+TEST(FilePrefetcher, Take) {
+  TempFile archive("!<arch>\n");
+  TempFile script("SECTIONS {}\n");
+  std::string missing = script.path() + ".missing";
+  std::vector<std::string> paths = {archive.path(), script.path(), missing,
+                                    archive.path()};
+  FilePrefetcher prefetcher(paths);
+  EXPECT_EQ(3U, prefetcher.numFiles());
+
+  llvm::sys::fs::file_magic magic;
+  EXPECT_FALSE(prefetcher.identify(archive.path(), magic));
+  EXPECT_EQ(llvm::sys::fs::file_magic::archive, magic);
+  EXPECT_FALSE(prefetcher.identify(script.path(), magic));
+  EXPECT_EQ(llvm::sys::fs::file_magic::unknown, magic);
+  EXPECT_TRUE(prefetcher.identify(missing, magic));
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> mb = prefetcher.take(script.path());
+  ASSERT_TRUE(bool(mb));
+  EXPECT_EQ("SECTIONS {}\n", mb.get()->getBuffer());
+  EXPECT_FALSE(bool(prefetcher.take(missing)));
+
+  // A buffer can be taken once. Later requests read the file again.
+  mb = prefetcher.take(script.path());
+  ASSERT_TRUE(bool(mb));
+  EXPECT_EQ("SECTIONS {}\n", mb.get()->getBuffer());
+  EXPECT_LE(0.0, prefetcher.readSeconds());
+  EXPECT_LE(0.0, prefetcher.waitSeconds());
+}
+
+TEST(FilePrefetcher, NotPrefetched) {
+  TempFile file("abc");
+  std::vector<std::string> paths;
+  FilePrefetcher prefetcher(paths);
+  EXPECT_EQ(0U, prefetcher.numFiles());
+  ErrorOr<std::unique_ptr<MemoryBuffer>> mb = prefetcher.take(file.path());
+  ASSERT_TRUE(bool(mb));
+  EXPECT_EQ("abc", mb.get()->getBuffer());
+}
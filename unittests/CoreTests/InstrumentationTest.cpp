@@ -0,0 +1,180 @@
+//===- lld/unittest/InstrumentationTest.cpp -------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Instrumentation.h unit tests.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "lld/Core/Instrumentation.h"
+#include "lld/Core/Parallel.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
+#include <vector>
+
+using namespace lld;
+
+namespace {
+
+struct Event {
+  std::string name;
+  std::string phase;
+  unsigned tid;
+  double ts;
+  double dur;
+};
+
+// Parses the output of TimeTrace::write(). JSON is a subset of YAML, so we
+// use the YAML parser to check that the output is well formed.
+bool parseTrace(StringRef json, std::vector<Event> &events) {
+  llvm::SourceMgr sm;
+  llvm::yaml::Stream stream(json, sm);
+  auto *root = dyn_cast_or_null<llvm::yaml::MappingNode>(
+      stream.begin()->getRoot());
+  if (!root)
+    return false;
+  for (llvm::yaml::KeyValueNode &kv : *root) {
+    SmallString<32> keyStorage;
+    auto *key = dyn_cast<llvm::yaml::ScalarNode>(kv.getKey());
+    if (!key || key->getValue(keyStorage) != "traceEvents")
+      continue;
+    auto *seq = dyn_cast<llvm::yaml::SequenceNode>(kv.getValue());
+    if (!seq)
+      return false;
+    for (llvm::yaml::Node &node : *seq) {
+      auto *map = dyn_cast<llvm::yaml::MappingNode>(&node);
+      if (!map)
+        return false;
+      Event event = {"", "", 0, 0, 0};
+      for (llvm::yaml::KeyValueNode &field : *map) {
+        SmallString<32> nameStorage, valueStorage;
+        auto *name = dyn_cast<llvm::yaml::ScalarNode>(field.getKey());
+        auto *value = dyn_cast<llvm::yaml::ScalarNode>(field.getValue());
+        if (!name || !value)
+          return false;
+        StringRef n = name->getValue(nameStorage);
+        std::string v = value->getValue(valueStorage);
+        if (n == "name")
+          event.name = v;
+        else if (n == "ph")
+          event.phase = v;
+        else if (n == "tid")
+          event.tid = std::strtoul(v.c_str(), nullptr, 10);
+        else if (n == "ts")
+          event.ts = std::strtod(v.c_str(), nullptr);
+        else if (n == "dur")
+          event.dur = std::strtod(v.c_str(), nullptr);
+      }
+      events.push_back(event);
+    }
+  }
+  return !stream.failed();
+}
+
+std::vector<Event> writeTrace() {
+  std::string json;
+  llvm::raw_string_ostream os(json);
+  TimeTrace::write(os);
+  os.flush();
+  std::vector<Event> events;
+  EXPECT_TRUE(parseTrace(json, events)) << json;
+  return events;
+}
+
+const Event *findEvent(const std::vector<Event> &events, StringRef name) {
+  for (const Event &event : events)
+    if (event.name == name)
+      return &event;
+  return nullptr;
+}
+
+} // end anonymous namespace
+
+TEST(TimeTrace, Disabled) {
+  TimeTrace::clear();
+  {
+    ScopedTask task(getDefaultDomain(), "disabled");
+  }
+  EXPECT_TRUE(writeTrace().empty());
+}
+
+TEST(TimeTrace, Nesting) {
+  TimeTrace::clear();
+  TimeTrace::enable();
+  {
+    ScopedTask outer(getDefaultDomain(), "outer");
+    {
+      ScopedTask inner(getDefaultDomain(), "inner \"quoted\"");
+      Marker marker(getDefaultDomain(), "marker");
+    }
+  }
+  ScopedTask unfinished(getDefaultDomain(), "unfinished");
+  std::vector<Event> events = writeTrace();
+  unfinished.end();
+  TimeTrace::clear();
+
+  const Event *outer = findEvent(events, "outer");
+  const Event *inner = findEvent(events, "inner \"quoted\"");
+  const Event *marker = findEvent(events, "marker");
+  ASSERT_TRUE(outer && inner && marker);
+  EXPECT_EQ("X", outer->phase);
+  EXPECT_EQ("X", inner->phase);
+  EXPECT_EQ("i", marker->phase);
+  EXPECT_EQ(outer->tid, inner->tid);
+  EXPECT_LE(outer->ts, inner->ts);
+  EXPECT_LE(inner->ts + inner->dur, outer->ts + outer->dur);
+  EXPECT_LE(inner->ts, marker->ts);
+  EXPECT_LE(marker->ts, inner->ts + inner->dur);
+  // Tasks that have not ended are not written.
+  EXPECT_EQ(nullptr, findEvent(events, "unfinished"));
+}
+
+TEST(TimeTrace, ParallelTasks) {
+  TimeTrace::clear();
+  TimeTrace::enable();
+  std::vector<int> v(4000);
+  parallel_for_each(v.begin(), v.end(), [](int &i) { i = 1; });
+  {
+    TaskGroup tg;
+    for (int i = 0; i < 4; ++i)
+      tg.spawn([] { ScopedTask task(getDefaultDomain(), "spawned"); });
+  }
+  std::vector<Event> events = writeTrace();
+  TimeTrace::clear();
+
+  int chunks = 0, tasks = 0, spawned = 0;
+  for (const Event &event : events) {
+    if (event.name == "parallel_for_each")
+      ++chunks;
+    else if (event.name == "TaskGroup task")
+      ++tasks;
+    else if (event.name == "spawned")
+      ++spawned;
+  }
+  EXPECT_EQ(4, chunks);
+  EXPECT_EQ(4, spawned);
+  // Three of the chunks and the four spawned tasks run as TaskGroup tasks.
+  EXPECT_EQ(7, tasks);
+
+  // Each spawned task nests in a TaskGroup task on the same thread.
+  for (const Event &event : events) {
+    if (event.name != "spawned")
+      continue;
+    bool nested = false;
+    for (const Event &task : events)
+      if (task.name == "TaskGroup task" && task.tid == event.tid &&
+          task.ts <= event.ts && event.ts + event.dur <= task.ts + task.dur)
+        nested = true;
+    EXPECT_TRUE(nested);
+  }
+}
@@ -0,0 +1,125 @@
+//===- lld/unittest/CoreTests/PassManagerTest.cpp -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief PassManager.h unit tests.
+///
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "lld/Core/PassManager.h"
+#include "lld/Core/Simple.h"
+#include "llvm/ADT/STLExtras.h"
+#include <functional>
+
+using namespace lld;
+
+namespace {
+
+class TestPass : public Pass {
+public:
+  TestPass(const char *name, unsigned reads, unsigned writes,
+           std::function<void(SimpleFile &)> body)
+      : _name(name), _reads(reads), _writes(writes), _body(body) {}
+
+  void perform(std::unique_ptr<SimpleFile> &file) override { _body(*file); }
+  const char *name() const override { return _name; }
+  unsigned reads() const override { return _reads; }
+  unsigned writes() const override { return _writes; }
+
+private:
+  const char *_name;
+  unsigned _reads;
+  unsigned _writes;
+  std::function<void(SimpleFile &)> _body;
+};
+
+std::unique_ptr<Pass> makePass(const char *name, unsigned reads,
+                               unsigned writes,
+                               std::function<void(SimpleFile &)> body =
+                                   [](SimpleFile &) {}) {
+  return llvm::make_unique<TestPass>(name, reads, writes, body);
+}
+
+} // end anonymous namespace
+
+TEST(PassManager, CanRunConcurrently) {
+  std::unique_ptr<Pass> all =
+      makePass("all", Pass::AllResources, Pass::AllResources);
+  std::unique_ptr<Pass> append =
+      makePass("append", Pass::AtomGraph, Pass::NewAtoms);
+  std::unique_ptr<Pass> append2 = makePass("append2", 0, Pass::NewAtoms);
+  std::unique_ptr<Pass> state =
+      makePass("state", Pass::AtomGraph | Pass::ContextState,
+               Pass::ContextState);
+  std::unique_ptr<Pass> rewrite =
+      makePass("rewrite", Pass::AtomGraph, Pass::AtomGraph);
+
+  EXPECT_FALSE(PassManager::canRunConcurrently(*all, *append));
+  EXPECT_TRUE(PassManager::canRunConcurrently(*append, *state));
+  EXPECT_TRUE(PassManager::canRunConcurrently(*append, *append2));
+  EXPECT_FALSE(PassManager::canRunConcurrently(*state, *state));
+  EXPECT_FALSE(PassManager::canRunConcurrently(*rewrite, *append));
+  EXPECT_FALSE(PassManager::canRunConcurrently(*rewrite, *state));
+}
+
+TEST(PassManager, Timings) {
+  std::vector<int> order;
+  PassManager pm;
+  pm.add(makePass("a", Pass::AllResources, Pass::AllResources,
+                  [&](SimpleFile &) { order.push_back(1); }));
+  pm.add(makePass("b", Pass::AllResources, Pass::AllResources,
+                  [&](SimpleFile &) { order.push_back(2); }));
+  std::unique_ptr<SimpleFile> file(new SimpleFile("merged"));
+  EXPECT_FALSE(pm.runOnFile(file));
+
+  EXPECT_EQ((std::vector<int>{1, 2}), order);
+  ASSERT_EQ(2U, pm.timings().size());
+  EXPECT_STREQ("a", pm.timings()[0].name);
+  EXPECT_STREQ("b", pm.timings()[1].name);
+  EXPECT_LE(0.0, pm.timings()[0].seconds);
+}
+
+TEST(PassManager, Snapshot) {
+  std::unique_ptr<SimpleFile> file(new SimpleFile("merged"));
+  SimpleUndefinedAtom existing(*file, "existing");
+  SimpleUndefinedAtom first(*file, "first");
+  SimpleUndefinedAtom second(*file, "second");
+  file->addAtom(existing);
+
+  // Both passes see only the atoms that existed before the group started.
+  // A pass that only reads atoms is given the merged file itself.
+  size_t seenByFirst = 0, seenBySecond = 0;
+  SimpleFile *seenByReader = nullptr;
+  PassManager pm;
+  pm.add(makePass("first", Pass::AtomGraph, Pass::NewAtoms,
+                  [&](SimpleFile &f) {
+                    seenByFirst = f.undefined().size();
+                    f.addAtom(first);
+                  }));
+  pm.add(makePass("second", Pass::AtomGraph, Pass::NewAtoms,
+                  [&](SimpleFile &f) {
+                    seenBySecond = f.undefined().size();
+                    f.addAtom(second);
+                  }));
+  pm.add(makePass("reader", Pass::AtomGraph | Pass::ContextState,
+                  Pass::ContextState,
+                  [&](SimpleFile &f) { seenByReader = &f; }));
+  SimpleFile *merged = file.get();
+  EXPECT_FALSE(pm.runOnFile(file));
+
+  EXPECT_EQ(1U, seenByFirst);
+  EXPECT_EQ(1U, seenBySecond);
+  EXPECT_EQ(merged, seenByReader);
+  // The new atoms are appended in pass order.
+  ASSERT_EQ(3U, file->undefined().size());
+  EXPECT_EQ(&existing, file->undefined()[0]);
+  EXPECT_EQ(&first, file->undefined()[1]);
+  EXPECT_EQ(&second, file->undefined()[2]);
+}
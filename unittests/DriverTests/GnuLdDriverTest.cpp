@@ -15,6 +15,8 @@
 #include "DriverTest.h"
 #include "lld/ReaderWriter/ELFLinkingContext.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include <cstdint>
+#include <thread>
 
 using namespace llvm;
 using namespace lld;
@@ -282,3 +284,437 @@ TEST_F(LinkerScriptTest, ExprEval) {
   EXPECT_EQ(0, sa2->symbol().compare(StringRef(".")));
 }
 
+TEST(WildcardPatternTest, Match) {
+  EXPECT_TRUE(script::WildcardPattern(".text").match(".text"));
+  EXPECT_FALSE(script::WildcardPattern(".text").match(".text.foo"));
+  EXPECT_TRUE(script::WildcardPattern("*").match(""));
+  EXPECT_TRUE(script::WildcardPattern(".text*").match(".text"));
+  EXPECT_TRUE(script::WildcardPattern(".text.*").match(".text.foo"));
+  EXPECT_FALSE(script::WildcardPattern(".text.*").match(".data.foo"));
+  EXPECT_TRUE(script::WildcardPattern("*.o").match("foo.o"));
+  EXPECT_FALSE(script::WildcardPattern("*.o").match("foo.a"));
+  EXPECT_TRUE(script::WildcardPattern(".?ss").match(".bss"));
+  EXPECT_FALSE(script::WildcardPattern(".?ss").match(".ss"));
+  EXPECT_TRUE(script::WildcardPattern("*crtbegin?.o").match("/x/crtbeginS.o"));
+  EXPECT_TRUE(script::WildcardPattern("[._]data*").match("_data.rel"));
+  EXPECT_FALSE(script::WildcardPattern("[._]data*").match("-data"));
+  EXPECT_TRUE(script::WildcardPattern(".text.[a-c]*").match(".text.b1"));
+  EXPECT_FALSE(script::WildcardPattern(".text.[!a-c]*").match(".text.b1"));
+  EXPECT_TRUE(script::WildcardPattern("\\*.o").match("*.o"));
+  EXPECT_FALSE(script::WildcardPattern("\\*.o").match("a.o"));
+  EXPECT_TRUE(script::WildcardPattern("*.text.*.*").match("a.text.b.c"));
+  EXPECT_FALSE(script::WildcardPattern("*.text.*.*").match("a.text.b"));
+}
+
+TEST(WildcardPatternTest, NoBacktracking) {
+  // This pattern takes exponential time with a backtracking matcher.
+  std::string name(64, 'a');
+  EXPECT_FALSE(script::WildcardPattern("*a*a*a*a*a*a*a*a*b").match(name));
+}
+
+/// Returns the sort key of a section. Files are numbered by the first letter
+/// of their name, as if a.o, b.o, ... appeared in the input in that order.
+static script::Sema::SectionOrderKey
+getOrderKey(const script::Sema &sema, const script::Sema::SectionKey &key) {
+  return sema.getOrderKey(key, 0, key.memberPath[0] - 'a');
+}
+
+// A script with thousands of input section rules, like the ones used for
+// operating system kernels.
+TEST_F(LinkerScriptTest, ManyInputSectionRules) {
+  std::string script = "SECTIONS {\n"
+                       "  .text : { *(.text.hot .text.hot.*) }\n";
+  for (int i = 0; i < 2000; ++i)
+    script += "  .s" + std::to_string(i) + " : { *(.sec" + std::to_string(i) +
+              " .sec" + std::to_string(i) + ".*) }\n";
+  script += "  .data : { *(.data .ro[dx]ata*) }\n}\n";
+  parse(script);
+
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey hot = {"", "a.o", ".text.hot.x"};
+  script::Sema::SectionKey sec5 = {"", "a.o", ".sec5"};
+  script::Sema::SectionKey sec1234 = {"", "a.o", ".sec1234.y"};
+  script::Sema::SectionKey rodata = {"", "b.o", ".rodata1"};
+  script::Sema::SectionKey none = {"", "b.o", ".nomatch"};
+  EXPECT_EQ(".text", sema.getOutputSection(hot));
+  EXPECT_EQ(".s5", sema.getOutputSection(sec5));
+  EXPECT_EQ(".s1234", sema.getOutputSection(sec1234));
+  EXPECT_EQ(".data", sema.getOutputSection(rodata));
+  EXPECT_EQ("", sema.getOutputSection(none));
+  EXPECT_TRUE(getOrderKey(sema, hot) < getOrderKey(sema, sec5));
+  EXPECT_TRUE(getOrderKey(sema, sec5) < getOrderKey(sema, sec1234));
+  EXPECT_FALSE(getOrderKey(sema, rodata) < getOrderKey(sema, sec1234));
+  EXPECT_TRUE(getOrderKey(sema, rodata) < getOrderKey(sema, none));
+}
+
+TEST_F(LinkerScriptTest, SortKeyRank) {
+  parse("SECTIONS { .text : { *(.text.b SORT(.text.s*) .text.*) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey b = {"", "a.o", ".text.b"};
+  script::Sema::SectionKey s1 = {"", "a.o", ".text.s1"};
+  script::Sema::SectionKey s2 = {"", "b.o", ".text.s2"};
+  script::Sema::SectionKey x = {"", "a.o", ".text.x"};
+  EXPECT_TRUE(getOrderKey(sema, b) < getOrderKey(sema, s1));
+  EXPECT_TRUE(getOrderKey(sema, s1) < getOrderKey(sema, x));
+  EXPECT_FALSE(getOrderKey(sema, x) < getOrderKey(sema, b));
+  // The files are not sorted, so every section of a.o goes before the
+  // sections of b.o, whatever name they match.
+  EXPECT_TRUE(getOrderKey(sema, x) < getOrderKey(sema, s2));
+  EXPECT_FALSE(getOrderKey(sema, s2) < getOrderKey(sema, b));
+}
+
+TEST_F(LinkerScriptTest, SortKeyFileOrder) {
+  parse("SECTIONS { .text : { *(.a .b) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  // b.o appears in the input before a.o. Files keep their input order, and
+  // the rule orders the sections within each file.
+  script::Sema::SectionKey a1 = {"", "b.o", ".a"};
+  script::Sema::SectionKey b1 = {"", "b.o", ".b"};
+  script::Sema::SectionKey a2 = {"", "a.o", ".a"};
+  EXPECT_TRUE(sema.getOrderKey(a1, 0, 0) < sema.getOrderKey(b1, 0, 0));
+  EXPECT_TRUE(sema.getOrderKey(b1, 0, 0) < sema.getOrderKey(a2, 0, 1));
+  EXPECT_FALSE(sema.getOrderKey(a2, 0, 1) < sema.getOrderKey(b1, 0, 0));
+}
+
+// Checks that the sort keys put lhs before rhs.
+static void expectSortedBefore(const script::Sema &sema,
+                               const script::Sema::SectionKey &lhs,
+                               const script::Sema::SectionKey &rhs) {
+  EXPECT_TRUE(getOrderKey(sema, lhs) < getOrderKey(sema, rhs));
+  EXPECT_FALSE(getOrderKey(sema, rhs) < getOrderKey(sema, lhs));
+}
+
+TEST_F(LinkerScriptTest, SortByAlignment) {
+  parse("SECTIONS { .data : { *(SORT_BY_ALIGNMENT(.data.*)) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey a16 = {"", "a.o", ".data.a", 16};
+  script::Sema::SectionKey b8 = {"", "a.o", ".data.b", 8};
+  script::Sema::SectionKey c32 = {"", "a.o", ".data.c", 32};
+  expectSortedBefore(sema, c32, a16);
+  expectSortedBefore(sema, a16, b8);
+}
+
+TEST_F(LinkerScriptTest, SortByAlignmentAndName) {
+  parse("SECTIONS { .data : { *(SORT_BY_ALIGNMENT(SORT_BY_NAME(.data.*))) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey a8 = {"", "a.o", ".data.a", 8};
+  script::Sema::SectionKey b16 = {"", "a.o", ".data.b", 16};
+  script::Sema::SectionKey c16 = {"", "a.o", ".data.c", 16};
+  expectSortedBefore(sema, b16, c16);
+  expectSortedBefore(sema, c16, a8);
+}
+
+TEST_F(LinkerScriptTest, SortByNameAndAlignment) {
+  parse("SECTIONS { .data : { *(SORT_BY_NAME(SORT_BY_ALIGNMENT(.data.*))) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey a4 = {"", "a.o", ".data.a", 4};
+  script::Sema::SectionKey b4 = {"", "a.o", ".data.b", 4};
+  script::Sema::SectionKey b16 = {"", "a.o", ".data.b", 16};
+  expectSortedBefore(sema, a4, b16);
+  expectSortedBefore(sema, b16, b4);
+}
+
+TEST_F(LinkerScriptTest, SortByInitPriority) {
+  parse("SECTIONS {\n"
+        "  .init_array : { *(SORT_BY_INIT_PRIORITY(.init_array.*)) }\n"
+        "  .ctors : { *(SORT_BY_INIT_PRIORITY(.ctors.*)) }\n"
+        "}");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey i5 = {"", "a.o", ".init_array.5"};
+  script::Sema::SectionKey i100 = {"", "a.o", ".init_array.100"};
+  script::Sema::SectionKey i65535 = {"", "a.o", ".init_array.65535"};
+  script::Sema::SectionKey iNone = {"", "a.o", ".init_array.x"};
+  expectSortedBefore(sema, i5, i100);
+  expectSortedBefore(sema, i100, i65535);
+  // Sections without a priority go after priority 65535.
+  expectSortedBefore(sema, i65535, iNone);
+
+  // .ctors sections run in reverse order, so higher numbers go first.
+  script::Sema::SectionKey c5 = {"", "a.o", ".ctors.5"};
+  script::Sema::SectionKey c100 = {"", "a.o", ".ctors.100"};
+  expectSortedBefore(sema, c100, c5);
+}
+
+TEST_F(LinkerScriptTest, SortFilesByAlignmentAndName) {
+  // Files have no alignment, so only their names are compared.
+  parse("SECTIONS { .text : { "
+        "SORT_BY_ALIGNMENT(SORT_BY_NAME(*))(.text) } }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  script::Sema::SectionKey a = {"", "a.o", ".text", 4};
+  script::Sema::SectionKey b = {"", "b.o", ".text", 16};
+  // b.o appears first in the input, but a.o goes first by name.
+  EXPECT_TRUE(sema.getOrderKey(a, 0, 1) < sema.getOrderKey(b, 0, 0));
+  EXPECT_FALSE(sema.getOrderKey(b, 0, 0) < sema.getOrderKey(a, 0, 1));
+}
+
+// Sema is queried from multiple threads while the output sections are
+// created.
+TEST_F(LinkerScriptTest, ConcurrentQueries) {
+  std::string script = "SECTIONS {\n";
+  for (int i = 0; i < 100; ++i)
+    script += "  .s" + std::to_string(i) + " : { *(.sec" + std::to_string(i) +
+              ".*) }\n";
+  script += "  sym = .;\n}\n";
+  parse(script);
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+
+  std::vector<std::string> names;
+  for (int i = 0; i < 1000; ++i)
+    names.push_back(".sec" + std::to_string(i % 150) + ".x" +
+                    std::to_string(i));
+
+  std::vector<std::thread> threads;
+  std::vector<int> failures(8);
+  for (int t = 0; t < 8; ++t) {
+    threads.push_back(std::thread([&, t] {
+      for (int i = 0; i < 1000; ++i) {
+        int n = (i + t * 125) % 1000;
+        script::Sema::SectionKey key = {"", "a.o", names[n]};
+        std::string expected =
+            (n % 150 < 100) ? ".s" + std::to_string(n % 150) : "";
+        if (sema.getOutputSection(key) != expected)
+          ++failures[t];
+        if (sema.hasMapping(key) != !expected.empty())
+          ++failures[t];
+      }
+    }));
+  }
+  for (std::thread &t : threads)
+    t.join();
+  for (int f : failures)
+    EXPECT_EQ(0, f);
+  EXPECT_EQ(1U, sema.getScriptDefinedSymbols().count("sym"));
+}
+
+TEST_F(LinkerScriptTest, MemberNameWildcards) {
+  parse("SECTIONS {\n"
+        "  .a : { foo.o(.text) }\n"
+        "  .b : { *bar.o(*.cold) }\n"
+        "  .c : { lib*.o(.text.*) }\n"
+        "  .d : { *(.te?t) }\n"
+        "}\n");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  EXPECT_EQ(".a", sema.getOutputSection({"", "foo.o", ".text"}));
+  EXPECT_EQ(".b", sema.getOutputSection({"", "xbar.o", ".x.cold"}));
+  EXPECT_EQ("", sema.getOutputSection({"", "xbaz.o", ".x.cold"}));
+  EXPECT_EQ(".c", sema.getOutputSection({"", "libz.o", ".text.q"}));
+  EXPECT_EQ("", sema.getOutputSection({"", "foo.o", ".text.q"}));
+  EXPECT_EQ(".d", sema.getOutputSection({"", "q.o", ".text"}));
+  EXPECT_EQ(".d", sema.getOutputSection({"", "libz.o", ".teXt"}));
+}
+
+TEST_F(LinkerScriptTest, MemoryRegions) {
+  parse("MEMORY {\n"
+        "  rom (rx) : ORIGIN = 0x1000, LENGTH = 0x100\n"
+        "  ram (rwx) : ORIGIN = 0x8000, LENGTH = 1K\n"
+        "}\n"
+        "SECTIONS {\n"
+        "  .text : { *(.text) } >rom\n"
+        "  .data : { _sdata = .; *(.data) } >ram AT>rom\n"
+        "  .bss : { *(.bss) } >ram\n"
+        "  .comment : { *(.comment) }\n"
+        "}\n");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  EXPECT_FALSE(sema.perform());
+  EXPECT_TRUE(sema.hasMemoryRegions());
+
+  script::Sema::MemoryRegion *rom = sema.getMemoryRegion(".text");
+  script::Sema::MemoryRegion *ram = sema.getMemoryRegion(".data");
+  ASSERT_TRUE(rom && ram);
+  EXPECT_EQ("rom", rom->name);
+  EXPECT_EQ(0x1000U, rom->origin);
+  EXPECT_EQ(0x100U, rom->length);
+  EXPECT_EQ("ram", ram->name);
+  EXPECT_EQ(1024U, ram->length);
+  EXPECT_EQ(ram, sema.getMemoryRegion(".bss"));
+  EXPECT_EQ(rom, sema.getLMAMemoryRegion(".data"));
+  EXPECT_EQ(nullptr, sema.getLMAMemoryRegion(".text"));
+  EXPECT_EQ(nullptr, sema.getMemoryRegion(".comment"));
+
+  std::vector<const script::SymbolAssignment *> sas;
+  script::LinkerScript *ls = sema.getLinkerScripts()[0]->get();
+  for (const script::Command *cmd : *cast<script::Sections>(ls->_commands[1]))
+    if (auto *out = dyn_cast<script::OutputSectionDescription>(cmd))
+      for (const script::Command *c : *out)
+        if (auto *sa = dyn_cast<script::SymbolAssignment>(c))
+          sas.push_back(sa);
+  ASSERT_EQ(1U, sas.size());
+  EXPECT_EQ(".data", sema.getEnclosingOutputSection(sas[0]));
+
+  // Cursors only move forward, and the first section that does not fit is
+  // the one that gets reported.
+  rom->allocate(0x1080, ".text");
+  rom->allocate(0x1040, ".text");
+  EXPECT_EQ(0x1080U, rom->cursor);
+  EXPECT_EQ(0U, rom->overflow());
+  EXPECT_FALSE(sema.checkMemoryRegions());
+  rom->allocate(0x1110, ".data");
+  rom->allocate(0x1120, ".rodata");
+  EXPECT_EQ(0x20U, rom->overflow());
+  EXPECT_EQ(".data", rom->overflowSection);
+  EXPECT_EQ("section `.data' will not fit in region `rom'; "
+            "region `rom' overflowed by 32 bytes",
+            sema.checkMemoryRegions().message());
+
+  sema.resetMemoryRegions();
+  EXPECT_EQ(0x1000U, rom->cursor);
+  EXPECT_EQ(0U, rom->overflow());
+  EXPECT_TRUE(rom->overflowSection.empty());
+}
+
+TEST_F(LinkerScriptTest, UndeclaredMemoryRegion) {
+  parse("MEMORY { rom : ORIGIN = 0, LENGTH = 0x100 }\n"
+        "SECTIONS { .data : { *(.data) } >ram }\n");
+  EXPECT_TRUE(bool(_ctx->linkerScriptSema().perform()));
+}
+
+TEST_F(LinkerScriptTest, GetExprs) {
+  parse("SECTIONS {\n"
+        "  a = 1;\n"
+        "  .text : { b = 2; *(.text) c = 3; *(.text.*) }\n"
+        "  d = 4;\n"
+        "  .data : { *(.data) }\n"
+        "  .bss : { *(.bss) }\n"
+        "}\n");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+
+  ArrayRef<const script::SymbolAssignment *> exprs =
+      sema.getExprs({"", "foo.o", ".text"});
+  ASSERT_EQ(2U, exprs.size());
+  EXPECT_EQ("a", exprs[0]->symbol());
+  EXPECT_EQ("b", exprs[1]->symbol());
+  // Expressions are delivered only once.
+  EXPECT_TRUE(sema.getExprs({"", "bar.o", ".text"}).empty());
+
+  exprs = sema.getExprs({"", "foo.o", ".text.x"});
+  ASSERT_EQ(1U, exprs.size());
+  EXPECT_EQ("c", exprs[0]->symbol());
+
+  exprs = sema.getExprs({"", "foo.o", ".data"});
+  ASSERT_EQ(1U, exprs.size());
+  EXPECT_EQ("d", exprs[0]->symbol());
+
+  EXPECT_TRUE(sema.getExprs({"", "foo.o", ".bss"}).empty());
+  EXPECT_TRUE(sema.getExprs({"", "foo.o", ".comment"}).empty());
+}
+
+// Returns the symbol assignments in the first SECTIONS command.
+static std::vector<const script::SymbolAssignment *>
+getAssignments(ELFLinkingContext &ctx) {
+  script::LinkerScript *ls =
+      ctx.linkerScriptSema().getLinkerScripts()[0]->get();
+  auto *secs = cast<script::Sections>(*ls->_commands.begin());
+  std::vector<const script::SymbolAssignment *> ret;
+  for (const script::Command *cmd : *secs)
+    if (auto *sa = dyn_cast<script::SymbolAssignment>(cmd))
+      ret.push_back(sa);
+  return ret;
+}
+
+TEST_F(LinkerScriptTest, CompiledExprEval) {
+  parse("SECTIONS { a = 0x1000; b = a + 0x10;\n"
+        "c = b > a ? b - a : undefined;\n"
+        "d = (1 << 4) * -2; . = c + d + 0x100;\n"
+        "e = undefined + 1; f = foo(1); }");
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  std::vector<const script::SymbolAssignment *> sas = getAssignments(*_ctx);
+  ASSERT_EQ(7U, sas.size());
+
+  uint64_t pos = 0;
+  for (int i = 0; i < 5; ++i)
+    EXPECT_FALSE(sema.evalExpr(sas[i], pos));
+  EXPECT_EQ(0x1000U, sema.getLinkerScriptExprValue("a"));
+  EXPECT_EQ(0x1010U, sema.getLinkerScriptExprValue("b"));
+  EXPECT_EQ(0x10U, sema.getLinkerScriptExprValue("c"));
+  EXPECT_EQ(uint64_t(-32), sema.getLinkerScriptExprValue("d"));
+  EXPECT_EQ(0xF0U, pos);
+
+  EXPECT_EQ(std::error_code(LinkerScriptReaderError::unknown_symbol_in_expr),
+            sema.evalExpr(sas[5], pos));
+  EXPECT_EQ(
+      std::error_code(LinkerScriptReaderError::unrecognized_function_in_expr),
+      sema.evalExpr(sas[6], pos));
+}
+
+TEST_F(LinkerScriptTest, CompiledExprFolding) {
+  parse("SECTIONS { a = (1 << 4) * -2 + ~0; b = 1 ? 2 : x; c = a + 1;\n"
+        "d = 1 / 0 ? 1 : 2; }");
+  std::vector<const script::SymbolAssignment *> sas = getAssignments(*_ctx);
+  ASSERT_EQ(4U, sas.size());
+
+  script::CompiledExpr::SlotMapTy slots;
+  script::CompiledExpr::SlotTable table;
+  script::CompiledExpr a(sas[0]->expr(), slots);
+  EXPECT_TRUE(a.isConstant());
+  EXPECT_EQ(-33, *a.eval(table));
+
+  // The branch that is not taken is not compiled.
+  script::CompiledExpr b(sas[1]->expr(), slots);
+  EXPECT_TRUE(b.isConstant());
+  EXPECT_EQ(0U, slots.count("x"));
+
+  script::CompiledExpr c(sas[2]->expr(), slots);
+  EXPECT_FALSE(c.isConstant());
+  EXPECT_EQ(1U, slots.count("a"));
+
+  // Division by zero is not folded.
+  script::CompiledExpr d(sas[3]->expr(), slots);
+  EXPECT_FALSE(d.isConstant());
+}
+
+TEST_F(LinkerScriptTest, CompiledExprFoldingOverflow) {
+  parse("SECTIONS { a = 0x7fffffffffffffff + 1;\n"
+        "b = -0x7fffffffffffffff - 2; c = 0x4000000000000000 * 4;\n"
+        "d = -(-0x7fffffffffffffff - 1); }");
+  std::vector<const script::SymbolAssignment *> sas = getAssignments(*_ctx);
+  ASSERT_EQ(4U, sas.size());
+
+  // Overflowing arithmetic is folded and wraps around, the same as at run
+  // time.
+  const int64_t expected[] = {INT64_MIN, INT64_MAX, 0, INT64_MIN};
+  script::CompiledExpr::SlotMapTy slots;
+  script::CompiledExpr::SlotTable table;
+  script::Expression::SymbolTableTy symbolTable;
+  for (int i = 0; i < 4; ++i) {
+    script::CompiledExpr expr(sas[i]->expr(), slots);
+    EXPECT_TRUE(expr.isConstant());
+    EXPECT_EQ(expected[i], *expr.eval(table));
+    EXPECT_EQ(expected[i], *sas[i]->expr()->evalExpr(symbolTable));
+  }
+}
+
+// Scripts may contain thousands of assignments, and the expressions are
+// evaluated again each time the layout is recomputed.
+TEST_F(LinkerScriptTest, ManyAssignments) {
+  const int numAssignments = 5000;
+  std::string script = "SECTIONS {\n  s0 = . + 1;\n";
+  for (int i = 1; i < numAssignments; ++i)
+    script += "  s" + std::to_string(i) + " = s" + std::to_string(i - 1) +
+              " + (2 * 4 - 7);\n";
+  script += "}\n";
+  parse(script);
+
+  script::Sema &sema = _ctx->linkerScriptSema();
+  sema.perform();
+  std::vector<const script::SymbolAssignment *> sas = getAssignments(*_ctx);
+  ASSERT_EQ(size_t(numAssignments), sas.size());
+  std::string last = "s" + std::to_string(numAssignments - 1);
+  for (uint64_t base = 0; base < 10; ++base) {
+    uint64_t pos = base;
+    for (const script::SymbolAssignment *sa : sas)
+      ASSERT_FALSE(sema.evalExpr(sa, pos));
+    EXPECT_EQ(base + numAssignments, sema.getLinkerScriptExprValue(last));
+  }
+}
@@ -61,6 +61,8 @@ TEST_F(WinLinkParserTest, Basic) {
   EXPECT_TRUE(_ctx.getBaseRelocationEnabled());
   EXPECT_TRUE(_ctx.isTerminalServerAware());
   EXPECT_TRUE(_ctx.getDynamicBaseEnabled());
+  EXPECT_FALSE(_ctx.isReproducible());
+  EXPECT_FALSE(_ctx.getChecksumEnabled());
   EXPECT_TRUE(_ctx.getCreateManifest());
   EXPECT_EQ("", _ctx.getManifestDependency());
   EXPECT_FALSE(_ctx.getEmbedManifest());
@@ -593,6 +595,16 @@ TEST_F(WinLinkParserTest, NoDynamicBase) {
   EXPECT_FALSE(_ctx.getDynamicBaseEnabled());
 }
 
+TEST_F(WinLinkParserTest, Brepro) {
+  EXPECT_TRUE(parse("link.exe", "/brepro", "a.out", nullptr));
+  EXPECT_TRUE(_ctx.isReproducible());
+}
+
+TEST_F(WinLinkParserTest, Release) {
+  EXPECT_TRUE(parse("link.exe", "/release", "a.out", nullptr));
+  EXPECT_TRUE(_ctx.getChecksumEnabled());
+}
+
 //
 // Test for /failifmismatch
 //
@@ -0,0 +1,82 @@
+//===- lld/unittest/ELFTests/TargetLayoutTest.cpp -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "../../lib/ReaderWriter/ELF/TargetLayout.h"
+#include <algorithm>
+#include <vector>
+
+using namespace lld;
+using namespace lld::elf;
+
+namespace {
+
+// An element is a pair of a key and a unique id.
+typedef std::pair<int, int> Elem;
+
+int getKey(const Elem &e) { return e.first; }
+
+// The quadratic algorithm that TargetLayout::sortInputSections used before.
+void groupByKeySlow(std::vector<Elem> &v, size_t first) {
+  if (first == 0)
+    return;
+  for (auto p = v.begin() + first; p != v.end(); ++p) {
+    auto q = p;
+    --q;
+    while (q != v.begin() && q->first != p->first)
+      --q;
+    if (q->first != p->first)
+      continue;
+    ++q;
+    for (auto i = p; i != q;) {
+      auto next = i--;
+      std::iter_swap(i, next);
+    }
+  }
+}
+
+std::vector<Elem> makeElems(const std::vector<int> &keys) {
+  std::vector<Elem> ret;
+  for (size_t i = 0; i < keys.size(); ++i)
+    ret.push_back(Elem(keys[i], i));
+  return ret;
+}
+
+void check(const std::vector<int> &keys, size_t first) {
+  std::vector<Elem> expected = makeElems(keys);
+  groupByKeySlow(expected, first);
+  std::vector<Elem> actual = makeElems(keys);
+  groupByKey(actual, first, getKey);
+  EXPECT_EQ(expected, actual);
+}
+
+} // end anonymous namespace
+
+TEST(TargetLayoutTest, GroupByKey) {
+  check({}, 0);
+  check({1, 2, 3}, 0);
+  check({1, 2, 3}, 3);
+  check({1, 2, 1, 2}, 2);
+  check({1, 2, 3, 3, 2, 1}, 2);
+  check({1, 2, 1, 3, 4, 3, 2, 4, 1}, 3);
+  check({5, 5, 1, 2}, 1);
+}
+
+TEST(TargetLayoutTest, GroupByKeyMatchesQuadraticAlgorithm) {
+  unsigned seed = 1;
+  for (int n = 1; n < 60; ++n) {
+    std::vector<int> keys;
+    for (int i = 0; i < n; ++i) {
+      seed = seed * 1103515245 + 12345;
+      keys.push_back((seed >> 16) % 6);
+    }
+    for (size_t first = 0; first <= keys.size(); ++first)
+      check(keys, first);
+  }
+}
@@ -0,0 +1,48 @@
+//===- lld/unittest/PECOFFTests/ChecksumTest.cpp --------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "../../lib/ReaderWriter/PECOFF/Checksum.h"
+#include <vector>
+
+using namespace lld;
+using namespace lld::pecoff;
+
+namespace {
+
+std::vector<uint8_t> makeImage(size_t size) {
+  std::vector<uint8_t> ret(size);
+  for (size_t i = 0; i < size; ++i)
+    ret[i] = i * 7 + 3;
+  return ret;
+}
+
+} // end anonymous namespace
+
+TEST(ChecksumTest, PEChecksum) {
+  EXPECT_EQ(0x2218U, computePEChecksum(makeImage(4)));
+  EXPECT_EQ(0xc8feU, computePEChecksum(makeImage(1000)));
+  // An odd byte at the end is treated as a word whose upper half is zero.
+  EXPECT_EQ(0x2238U, computePEChecksum(makeImage(5)));
+  // 0xffff + 0xffff folds to 0xffff.
+  EXPECT_EQ(0x10003U, computePEChecksum(std::vector<uint8_t>(4, 0xff)));
+}
+
+TEST(ChecksumTest, PEChecksumLargeImage) {
+  // Large enough to be split into several slices.
+  EXPECT_EQ(0x30f40fU, computePEChecksum(makeImage((3 << 20) + 1)));
+}
+
+TEST(ChecksumTest, ImageHash) {
+  std::vector<uint8_t> image = makeImage(1000);
+  EXPECT_EQ(0xb358faeeU, computeImageHash(image));
+  image[500] ^= 1;
+  EXPECT_NE(0xb358faeeU, computeImageHash(image));
+  EXPECT_EQ(0xf152978bU, computeImageHash(makeImage((3 << 20) + 1)));
+}
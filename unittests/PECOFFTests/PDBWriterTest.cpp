@@ -0,0 +1,350 @@
+//===- lld/unittest/PECOFFTests/PDBWriterTest.cpp -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "../../lib/ReaderWriter/PECOFF/WriterPDB.h"
+#include "lld/Core/Simple.h"
+#include "llvm/Support/COFF.h"
+#include "llvm/Support/Endian.h"
+#include <cstring>
+#include <vector>
+
+using namespace lld;
+using namespace lld::pecoff;
+using namespace llvm::support::endian;
+
+typedef PECOFFLinkingContext::DebugSections DebugSections;
+
+namespace {
+
+// A .debug$T section with an empty LF_ARGLIST and an LF_PROCEDURE that
+// refers to it and returns the given simple type.
+std::vector<uint8_t> makeTypeSection(uint8_t returnType) {
+  static const uint8_t header[] = {0x04, 0x00, 0x00, 0x00};
+  static const uint8_t argList[] = {0x06, 0x00, 0x01, 0x12,
+                                    0x00, 0x00, 0x00, 0x00};
+  uint8_t proc[] = {0x0e, 0x00, 0x08, 0x10, returnType, 0x00,
+                    0x00, 0x00, 0x00, 0x00, 0x00,       0x00,
+                    0x00, 0x10, 0x00, 0x00};
+  std::vector<uint8_t> ret(header, header + sizeof(header));
+  ret.insert(ret.end(), argList, argList + sizeof(argList));
+  ret.insert(ret.end(), proc, proc + sizeof(proc));
+  return ret;
+}
+
+// A .debug$T section as makeTypeSection(0x74), followed by ID records: an
+// LF_STRING_ID, an LF_FUNC_ID for the procedure and an LF_BUILDINFO that
+// refers to the string.
+std::vector<uint8_t> makeIdSection() {
+  static const uint8_t ids[] = {
+      // LF_STRING_ID 0x1002 "a.c"
+      0x0a, 0x00, 0x05, 0x16, 0x00, 0x00, 0x00, 0x00, 'a', '.', 'c', 0x00,
+      // LF_FUNC_ID 0x1003, no parent scope, type 0x1001, "f"
+      0x0e, 0x00, 0x01, 0x16, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x00, 0x00,
+      'f', 0x00, 0xf2, 0xf1,
+      // LF_BUILDINFO 0x1004 with the argument 0x1002
+      0x0a, 0x00, 0x03, 0x16, 0x01, 0x00, 0x02, 0x10, 0x00, 0x00, 0xf2, 0xf1};
+  std::vector<uint8_t> ret = makeTypeSection(0x74);
+  ret.insert(ret.end(), ids, ids + sizeof(ids));
+  return ret;
+}
+
+// A .debug$T section whose procedure refers to the argument list that
+// follows it.
+std::vector<uint8_t> makeForwardReferenceSection() {
+  static const uint8_t data[] = {
+      0x04, 0x00, 0x00, 0x00,
+      // LF_PROCEDURE 0x1000 with the argument list 0x1001
+      0x0e, 0x00, 0x08, 0x10, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x01, 0x10, 0x00, 0x00,
+      // LF_ARGLIST 0x1001
+      0x06, 0x00, 0x01, 0x12, 0x00, 0x00, 0x00, 0x00};
+  return std::vector<uint8_t>(data, data + sizeof(data));
+}
+
+// A .debug$S section for the types of makeIdSection(). It has an
+// S_GPROC32_ID for the function ID 0x1003 at offset 4 of a symbol and its
+// end record, a file checksum for "a.c" and the string table.
+std::vector<uint8_t> makeSymbolSection() {
+  static const uint8_t data[] = {
+      0x04, 0x00, 0x00, 0x00,
+      // Symbols
+      0xf1, 0x00, 0x00, 0x00, 0x2d, 0x00, 0x00, 0x00,
+      // S_GPROC32_ID "f"
+      0x27, 0x00, 0x47, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x10, 0x00, 0x00, 0x00, 0x03, 0x10, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 'f',  0x00,
+      // S_PROC_ID_END
+      0x02, 0x00, 0x4f, 0x11,
+      0x00, 0x00, 0x00,
+      // File checksums
+      0xf4, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      // String table
+      0xf3, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00,
+      0x00, 'a',  '.',  'c',  0x00, 0x00, 0x00, 0x00};
+  return std::vector<uint8_t>(data, data + sizeof(data));
+}
+
+// A code atom of the given size.
+class TestAtom : public SimpleDefinedAtom {
+public:
+  TestAtom(const File &file, uint64_t size)
+      : SimpleDefinedAtom(file), _size(size) {}
+
+  uint64_t size() const override { return _size; }
+  ContentType contentType() const override { return typeCode; }
+  ContentPermissions permissions() const override { return permR_X; }
+  ArrayRef<uint8_t> rawContent() const override { return llvm::None; }
+
+private:
+  uint64_t _size;
+};
+
+// Reads the stream directory of an MSF file.
+struct MSFReader {
+  explicit MSFReader(const std::vector<uint8_t> &file) {
+    const uint8_t *p = file.data();
+    uint32_t blockMapAddr = read32le(p + pdb::superBlockBlockMapAddr);
+    uint32_t dirBlock = read32le(p + blockMapAddr * pdb::blockSize);
+    const uint8_t *dir = p + dirBlock * pdb::blockSize;
+    uint32_t numStreams = read32le(dir);
+    const uint8_t *blocks = dir + 4 + numStreams * 4;
+    for (uint32_t i = 0; i < numStreams; ++i) {
+      uint32_t size = read32le(dir + 4 + i * 4);
+      std::vector<uint8_t> stream;
+      for (uint32_t off = 0; off < size; off += pdb::blockSize) {
+        uint32_t len = std::min<uint32_t>(pdb::blockSize, size - off);
+        const uint8_t *b = p + read32le(blocks) * pdb::blockSize;
+        stream.insert(stream.end(), b, b + len);
+        blocks += 4;
+      }
+      streams.push_back(stream);
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> streams;
+};
+
+} // end anonymous namespace
+
+TEST(PDBWriterTest, MSFLayout) {
+  pdb::MSFBuilder msf;
+  msf.addStream(std::vector<uint8_t>(10, 'a'));
+  msf.addStream(std::vector<uint8_t>());
+  msf.addStream(std::vector<uint8_t>(pdb::blockSize * 3 + 1, 'b'));
+  std::vector<uint8_t> file = msf.build();
+
+  EXPECT_EQ(0U, file.size() % pdb::blockSize);
+  EXPECT_EQ(0, memcmp(file.data(), pdb::msfMagic, sizeof(pdb::msfMagic)));
+  EXPECT_EQ(file.size() / pdb::blockSize,
+            read32le(file.data() + pdb::superBlockNumBlocks));
+
+  MSFReader reader(file);
+  ASSERT_EQ(3U, reader.streams.size());
+  EXPECT_EQ(std::vector<uint8_t>(10, 'a'), reader.streams[0]);
+  EXPECT_TRUE(reader.streams[1].empty());
+  EXPECT_EQ(std::vector<uint8_t>(pdb::blockSize * 3 + 1, 'b'),
+            reader.streams[2]);
+}
+
+TEST(PDBWriterTest, MergeTypes) {
+  std::vector<uint8_t> t1 = makeTypeSection(0x74);
+  std::vector<uint8_t> t2 = makeTypeSection(0x74);
+  std::vector<uint8_t> t3 = makeTypeSection(0x75);
+  std::vector<DebugSections> modules(3);
+  modules[0].types.push_back(t1);
+  modules[1].types.push_back(t2);
+  modules[2].types.push_back(t3);
+
+  // The first two modules have the same types. The third one shares the
+  // argument list but not the procedure.
+  pdb::TypeTable table = pdb::mergeTypes(modules).types;
+  ASSERT_EQ(3U, table.offsets.size());
+  EXPECT_EQ(8U + 16U + 16U, table.records.size());
+  // The second procedure refers to the argument list of the first module.
+  EXPECT_EQ(0x1000U, read32le(table.records.data() + table.offsets[2] + 12));
+}
+
+TEST(PDBWriterTest, MergeIds) {
+  std::vector<uint8_t> t1 = makeIdSection();
+  std::vector<uint8_t> t2 = makeIdSection();
+  std::vector<DebugSections> modules(2);
+  modules[0].types.push_back(t1);
+  modules[1].types.push_back(t2);
+
+  // ID records go to their own table, and both tables are deduplicated.
+  pdb::MergedTypes merged = pdb::mergeTypes(modules);
+  ASSERT_EQ(2U, merged.types.offsets.size());
+  ASSERT_EQ(3U, merged.ids.offsets.size());
+  const uint8_t *ids = merged.ids.records.data();
+  // The function ID refers to the procedure in the type table.
+  EXPECT_EQ(0x1601, read16le(ids + merged.ids.offsets[1] + 2));
+  EXPECT_EQ(0U, read32le(ids + merged.ids.offsets[1] + 4));
+  EXPECT_EQ(0x1001U, read32le(ids + merged.ids.offsets[1] + 8));
+  // The build info refers to the string in the ID table.
+  EXPECT_EQ(0x1603, read16le(ids + merged.ids.offsets[2] + 2));
+  EXPECT_EQ(0x1000U, read32le(ids + merged.ids.offsets[2] + 6));
+}
+
+TEST(PDBWriterTest, RejectForwardReference) {
+  std::vector<uint8_t> t1 = makeForwardReferenceSection();
+  std::vector<uint8_t> t2 = makeTypeSection(0x74);
+  std::vector<DebugSections> modules(2);
+  modules[0].fileName = "a.obj";
+  modules[0].types.push_back(t1);
+  modules[1].fileName = "b.obj";
+  modules[1].types.push_back(t2);
+
+  // The first module is malformed and its types are ignored.
+  pdb::MergedTypes merged = pdb::mergeTypes(modules);
+  ASSERT_EQ(2U, merged.types.offsets.size());
+  EXPECT_EQ(0x1000U,
+            read32le(merged.types.records.data() + merged.types.offsets[1] +
+                     12));
+  EXPECT_TRUE(merged.modules[0].types.empty());
+  ASSERT_EQ(2U, merged.modules[1].types.size());
+  EXPECT_EQ(0x1001U, merged.modules[1].types[1]);
+}
+
+TEST(PDBWriterTest, CreatePDB) {
+  std::vector<uint8_t> t1 = makeTypeSection(0x74);
+  std::vector<uint8_t> t2 = makeTypeSection(0x74);
+  std::vector<DebugSections> modules(2);
+  modules[0].fileName = "a.obj";
+  modules[0].types.push_back(t1);
+  modules[1].fileName = "b.obj";
+  modules[1].types.push_back(t2);
+
+  pdb::PDBInfo info;
+  info.signature = 1234;
+  info.age = 1;
+  std::vector<uint8_t> file = pdb::createPDB(
+      modules, llvm::None, llvm::COFF::IMAGE_FILE_MACHINE_I386, info);
+  MSFReader reader(file);
+  // The fixed streams, a symbol stream for each module and the section
+  // headers.
+  ASSERT_EQ(11U, reader.streams.size());
+
+  // The info stream has the signature, the GUID and a named stream map with
+  // only "/names", followed by the VC140 feature code.
+  const std::vector<uint8_t> &stream = reader.streams[pdb::streamPDBInfo];
+  ASSERT_EQ(28U + 4 + 7 + 28 + 4, stream.size());
+  EXPECT_EQ(1234U, read32le(stream.data() + 4));
+  EXPECT_EQ(0, memcmp(stream.data() + 12, info.guid, 16));
+  EXPECT_EQ(7U, read32le(stream.data() + 28));
+  EXPECT_EQ(0, memcmp(stream.data() + 32, "/names", 7));
+  EXPECT_EQ((uint32_t)pdb::streamNames, read32le(stream.data() + 63));
+  EXPECT_EQ(20140508U, read32le(stream.data() + 67));
+
+  // The string table has only the empty string.
+  const std::vector<uint8_t> &names = reader.streams[pdb::streamNames];
+  ASSERT_EQ(25U, names.size());
+  EXPECT_EQ(0xeffeeffeU, read32le(names.data()));
+  EXPECT_EQ(0U, read32le(names.data() + 21));
+
+  // TypeIndexBegin and TypeIndexEnd in the TPI header.
+  const std::vector<uint8_t> &tpi = reader.streams[pdb::streamTPI];
+  ASSERT_LE(56U, tpi.size());
+  EXPECT_EQ(0x1000U, read32le(tpi.data() + 8));
+  EXPECT_EQ(0x1002U, read32le(tpi.data() + 12));
+  EXPECT_EQ(56U + 8U + 16U, tpi.size());
+
+  // One hash value per type record, and one index offset pair.
+  EXPECT_EQ(2U * 4 + 8, reader.streams[pdb::streamTPIHash].size());
+
+  // There are no ID records, but the IPI stream has a header.
+  const std::vector<uint8_t> &ipi = reader.streams[pdb::streamIPI];
+  ASSERT_EQ(56U, ipi.size());
+  EXPECT_EQ(0x1000U, read32le(ipi.data() + 12));
+  EXPECT_EQ((uint16_t)pdb::streamIPIHash, read16le(ipi.data() + 20));
+
+  // The machine type in the DBI header.
+  const std::vector<uint8_t> &dbi = reader.streams[pdb::streamDBI];
+  ASSERT_LE(64U, dbi.size());
+  EXPECT_EQ(llvm::COFF::IMAGE_FILE_MACHINE_I386, read16le(dbi.data() + 58));
+}
+
+TEST(PDBWriterTest, ModuleSymbols) {
+  SimpleFile obj("a.obj");
+  TestAtom atom(obj, 0x20);
+  std::vector<uint8_t> types = makeIdSection();
+  std::vector<uint8_t> symbols = makeSymbolSection();
+  std::vector<DebugSections> modules(1);
+  modules[0].file = &obj;
+  modules[0].fileName = "a.obj";
+  modules[0].types.push_back(types);
+  PECOFFLinkingContext::DebugSymbols sym;
+  sym.data = symbols;
+  PECOFFLinkingContext::DebugRelocation secrel = {
+      44, llvm::COFF::IMAGE_REL_I386_SECREL, &atom};
+  PECOFFLinkingContext::DebugRelocation section = {
+      48, llvm::COFF::IMAGE_REL_I386_SECTION, &atom};
+  sym.relocations.push_back(secrel);
+  sym.relocations.push_back(section);
+  modules[0].symbols.push_back(sym);
+
+  // The atom is at 0x10 in the first section, so the procedure is at 0x14.
+  std::vector<pdb::OutputSection> sections(1);
+  memset(&sections[0].header, 0, sizeof(sections[0].header));
+  sections[0].header.VirtualAddress = 0x1000;
+  sections[0].header.VirtualSize = 0x30;
+  sections[0].header.Characteristics = llvm::COFF::IMAGE_SCN_CNT_CODE;
+  sections[0].atoms.push_back(std::make_pair(&atom, 0x1010));
+
+  pdb::PDBInfo info;
+  info.signature = 0;
+  info.age = 1;
+  std::vector<uint8_t> file = pdb::createPDB(
+      modules, sections, llvm::COFF::IMAGE_FILE_MACHINE_I386, info);
+  MSFReader reader(file);
+  ASSERT_EQ(10U, reader.streams.size());
+
+  // The symbol stream has the signature, the procedure, its end record and
+  // the file checksums.
+  const std::vector<uint8_t> &mod = reader.streams[pdb::streamFirstModule];
+  ASSERT_EQ(4U + 44 + 4 + 16 + 4, mod.size());
+  EXPECT_EQ(4U, read32le(mod.data()));
+  // The record is padded, converted to S_GPROC32, and refers to the
+  // function type. The end field is the offset of the end record.
+  const uint8_t *proc = mod.data() + 4;
+  EXPECT_EQ(42, read16le(proc));
+  EXPECT_EQ(0x1110, read16le(proc + 2));
+  EXPECT_EQ(48U, read32le(proc + 8));
+  EXPECT_EQ(0x1001U, read32le(proc + 28));
+  EXPECT_EQ(0x14U, read32le(proc + 32));
+  EXPECT_EQ(1, read16le(proc + 36));
+  EXPECT_EQ(0x0006, read16le(mod.data() + 50));
+  // The file checksum refers to the name in the /names stream.
+  EXPECT_EQ(0xf4U, read32le(mod.data() + 52));
+  const std::vector<uint8_t> &names = reader.streams[pdb::streamNames];
+  uint32_t nameOff = read32le(mod.data() + 60);
+  EXPECT_EQ(0, memcmp(names.data() + 12 + nameOff, "a.c", 4));
+
+  // The module info has the sizes of the symbols and the line information,
+  // and the atom is its section contribution.
+  const std::vector<uint8_t> &dbi = reader.streams[pdb::streamDBI];
+  ASSERT_LE(64U + 64 + 4 + 28, dbi.size());
+  const uint8_t *modInfo = dbi.data() + 64;
+  EXPECT_EQ(1, read16le(modInfo + 4));
+  EXPECT_EQ(0x10U, read32le(modInfo + 8));
+  EXPECT_EQ(0x20U, read32le(modInfo + 12));
+  EXPECT_EQ((uint16_t)pdb::streamFirstModule, read16le(modInfo + 34));
+  EXPECT_EQ(52U, read32le(modInfo + 36));
+  EXPECT_EQ(16U, read32le(modInfo + 44));
+  EXPECT_EQ(1, read16le(modInfo + 48));
+  uint32_t modInfoSize = read32le(dbi.data() + 24);
+  const uint8_t *contribs = dbi.data() + 64 + modInfoSize;
+  EXPECT_EQ(32U, read32le(dbi.data() + 28));
+  EXPECT_EQ(1, read16le(contribs + 4));
+  EXPECT_EQ(0x10U, read32le(contribs + 8));
+  EXPECT_EQ(0x20U, read32le(contribs + 12));
+  EXPECT_EQ(0, read16le(contribs + 24));
+}